@@ -0,0 +1,10 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// CRC32C (Castagnoli, reflected polynomial 0x82F63B78), continuing from the
+// CRC of the data before this block; pass 0 to start.
+// crc32c("123456789", 9, 0) == 0xE3069283. Matches fabric::crc32c in the
+// TLM, which has the table-driven and accelerated kernels.
+uint32_t crc32c(const void* data, size_t length, uint32_t crc);
@@ -10,6 +10,34 @@
 #define ERROR_MASK_REG     0x1000000C
 #define SELF_TEST_REG      0x10000010
 
+// DMA descriptor rings. Head and tail registers are free-running counts of
+// descriptors; a ring's size is a power of two and index = count & (size - 1).
+#define DMA_RX_RING_REG    0x10000020  // receive descriptor ring address
+#define DMA_RX_SIZE_REG    0x10000024  // receive descriptors in the ring
+#define DMA_RX_HEAD_REG    0x10000028  // descriptors filled by the hardware (read-only)
+#define DMA_RX_TAIL_REG    0x1000002C  // descriptors handed to the hardware
+#define DMA_TX_RING_REG    0x10000030  // transmit descriptor ring address
+#define DMA_TX_SIZE_REG    0x10000034  // transmit descriptors in the ring
+#define DMA_TX_HEAD_REG    0x10000038  // descriptors sent by the hardware (read-only)
+#define DMA_TX_TAIL_REG    0x1000003C  // descriptors queued for sending
+
+#define DMA_RX_RING_HI_REG 0x10000050  // upper half of the ring addresses on 64-bit hosts
+#define DMA_TX_RING_HI_REG 0x10000054
+
+// Interrupt controller
+#define IRQ_STATUS_REG     0x10000040  // pending enabled interrupts, write 1 to clear
+#define IRQ_ENABLE_REG     0x10000044
+#define IRQ_COALESCE_REG   0x10000048  // receive interrupt after COUNT packets or USECS
+
+// Timer. IRQ_TIMER is raised when the count reaches the compare value; a
+// compare value already passed raises it at once.
+#define TIMER_COUNT_REG    0x10000058  // free-running microseconds (read-only)
+#define TIMER_COMPARE_REG  0x1000005C
+
+// Scheduler tick, and the longest the tick may be stopped for
+#define TIMER_TICK_USECS       1000
+#define TIMER_MAX_SLEEP_TICKS  (0x7FFFFFFF / TIMER_TICK_USECS)
+
 // Link status bits
 #define LINK_UP            (1 << 0)
 #define LINK_ACTIVE        (1 << 1)
@@ -23,23 +51,38 @@
 #define LINK_LOOPBACK      (1 << 3)
 
 // Error status bits
-#define ERROR_CRC          (1 << 0)
-#define ERROR_TIMEOUT      (1 << 1)
-#define ERROR_OVERFLOW     (1 << 2)
-#define ERROR_UNDERFLOW    (1 << 3)
+#define ERR_CRC            (1 << 0)
+#define ERR_TIMEOUT        (1 << 1)
+#define ERR_OVERFLOW       (1 << 2)  // a packet arrived with no receive descriptor free
+#define ERR_UNDERFLOW      (1 << 3)
+
+// Interrupt bits
+#define IRQ_TIMER          (1 << 0)
+#define IRQ_LINK_RX        (1 << 1)
+
+// Interrupt coalescing fields
+#define IRQ_COALESCE_COUNT(n)  ((uint32_t)(n) & 0xFFFF)
+#define IRQ_COALESCE_USECS(n)  ((uint32_t)(n) << 16)
+
+// DMA descriptor status bits, written by the hardware
+#define DMA_DESC_DONE      (1u << 31)
+#define DMA_DESC_ERROR     (1u << 0)   // the link flagged an error on this packet
 
 // Function declarations
 void firmware_init(void);
 void link_init(void);
 void error_handler(void);
 void self_test(void);
-void process_packet(void);
+void handle_irq(void);
+void timer_init(void);
 
 // Assembly function declarations
 void enable_interrupts(void);
 void disable_interrupts(void);
 void save_context(void);
 void restore_context(void);
+void wait_for_interrupt(void);
+void enable_cycle_counter(void);
 
 // RTOS task declarations
 void link_monitor_task(void);
@@ -48,6 +91,25 @@ void self_test_task(void);
 void packet_processor_task(void);
 
 // Utility functions
+#ifdef FIRMWARE_HOST
+// Host builds send register accesses to whatever bus is attached: a test
+// model, or a TLM initiator socket in co-simulation
+typedef struct {
+    void* context;
+    void (*write)(void* context, uint32_t addr, uint32_t value);
+    uint32_t (*read)(void* context, uint32_t addr);
+} reg_bus_t;
+
+extern reg_bus_t g_reg_bus;
+
+static inline void write_reg(uint32_t addr, uint32_t value) {
+    g_reg_bus.write(g_reg_bus.context, addr, value);
+}
+
+static inline uint32_t read_reg(uint32_t addr) {
+    return g_reg_bus.read(g_reg_bus.context, addr);
+}
+#else
 static inline void write_reg(uint32_t addr, uint32_t value) {
     volatile uint32_t* reg = (volatile uint32_t*)addr;
     *reg = value;
@@ -57,6 +119,7 @@ static inline uint32_t read_reg(uint32_t addr) {
     volatile uint32_t* reg = (volatile uint32_t*)addr;
     return *reg;
 }
+#endif
 
 // Error handling
 typedef enum {
@@ -75,6 +138,20 @@ typedef struct {
     uint32_t crc;
 } packet_t;
 
+// Packet buffers, from a fixed pool: constant-time and free of heap
+// fragmentation, including on the link recovery path
+#define PACKET_POOL_SIZE  8
+
+packet_t* packet_alloc(void);
+void packet_free(packet_t* packet);
+
+// Packet integrity
+void packet_seal(packet_t* packet);
+bool packet_check(const packet_t* packet);
+
+// Handles a received packet in its DMA buffer
+void process_packet(const packet_t* packet, uint32_t status);
+
 // Link statistics
 typedef struct {
     uint32_t packets_sent;
@@ -82,6 +159,8 @@ typedef struct {
     uint32_t errors_detected;
     uint32_t crc_errors;
     uint32_t timeout_errors;
+    uint32_t rx_interrupts;
+    uint32_t rx_overruns;  // packets dropped with the receive ring full
 } link_stats_t;
 
 // Global variables
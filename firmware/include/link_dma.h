@@ -0,0 +1,57 @@
+#pragma once
+
+#include "firmware.h"
+
+// Ring sizes, powers of two
+#define LINK_DMA_RX_DESCRIPTORS  64
+#define LINK_DMA_TX_DESCRIPTORS  16
+
+// A receive interrupt is raised once this many packets are waiting, or
+// once the oldest has waited this long
+#define LINK_DMA_COALESCE_PACKETS  16
+#define LINK_DMA_COALESCE_USECS    100
+
+// Packets handled per call to link_dma_receive
+#define LINK_DMA_BUDGET  32
+
+// Bus addresses are 32 bits on the target; host builds keep whole pointers
+#ifdef FIRMWARE_HOST
+typedef uintptr_t dma_addr_t;
+#else
+typedef uint32_t dma_addr_t;
+#endif
+
+// DMA descriptor, shared with the hardware. Each descriptor keeps the same
+// packet buffer for good; the hardware sets DMA_DESC_DONE once it has
+// filled or sent the buffer, and the driver clears it when handing the
+// descriptor back.
+typedef struct {
+    dma_addr_t buffer;
+    uint32_t status;
+} dma_descriptor_t;
+
+// Descriptor rings, visible to the hardware
+extern dma_descriptor_t g_rx_ring[LINK_DMA_RX_DESCRIPTORS];
+extern dma_descriptor_t g_tx_ring[LINK_DMA_TX_DESCRIPTORS];
+
+// Sets up both rings, gives every receive descriptor to the hardware and
+// programs interrupt coalescing. The receive interrupt stays masked until
+// the first link_dma_rx_wait.
+bool link_dma_init(void);
+
+// Receive interrupt: masks further receive interrupts and wakes the task
+// waiting in link_dma_rx_wait
+void link_dma_rx_irq(void);
+
+// Unmasks the receive interrupt and sleeps until it fires. Packets that
+// completed while it was masked raise it again straight away.
+void link_dma_rx_wait(void);
+
+// Hands up to budget filled descriptors to process_packet in place, then
+// returns them to the hardware with a single tail write. Returns the
+// number handled; a full budget means more may be waiting.
+uint32_t link_dma_receive(uint32_t budget);
+
+// Copies a packet into the next transmit buffer and queues it. Returns
+// false while every transmit descriptor is still in flight.
+bool link_dma_transmit(const packet_t* packet);
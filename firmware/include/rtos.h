@@ -3,6 +3,23 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+// Scheduler configuration
+#define RTOS_MAX_PRIORITIES    32  // priorities 0-31, higher runs first
+#define RTOS_TIME_SLICE_TICKS  1   // ticks a task runs before a ready task of its priority; 0 disables
+#define RTOS_TICKLESS_IDLE     1   // idle stops the tick until the first delayed task is due; 0 wakes every tick
+#define RTOS_IDLE_STACK_SIZE   128 // words
+
+// Static memory pools, sized at build time. The RTOS has no heap: every
+// task stack, mutex, semaphore and queue comes from these.
+#define RTOS_STACK_BLOCKS      8    // task stacks
+#define RTOS_STACK_BLOCK_SIZE  512  // words; the largest stack a task can have
+#define RTOS_OBJECT_BLOCKS     16   // mutexes, semaphores and queues together
+#define RTOS_QUEUE_BLOCKS      4    // queue storage
+#define RTOS_QUEUE_BLOCK_SIZE  1024 // bytes; a queue needs (queue_size + 1) word-rounded items
+
+// Timeout for blocking calls that never gives up
+#define RTOS_WAIT_FOREVER      0xFFFFFFFF
+
 // Task handle type
 typedef void* task_handle_t;
 
@@ -23,7 +40,7 @@ typedef enum {
 } task_state_t;
 
 // Task control block
-typedef struct {
+typedef struct task_control_block {
     char name[16];
     void (*entry_point)(void);
     uint32_t stack_size;
@@ -31,7 +48,18 @@ typedef struct {
     task_state_t state;
     uint32_t stack_pointer;
     uint32_t* stack;
-    uint32_t sleep_ticks;
+    uint32_t sleep_ticks;  // while delayed: ticks after the task ahead of it in the timer queue
+    uint32_t slice_ticks;  // while running: ticks left in its time slice
+
+    // Links in the task's ready list or in the timer queue
+    struct task_control_block* next;
+    struct task_control_block* prev;
+    bool delayed;  // in the timer queue
+
+    // While blocked on a queue, mutex or semaphore
+    struct wait_list* wait_list;
+    struct task_control_block* wait_next;
+    bool wait_result;  // true once the object wakes the task, false on timeout
 } task_control_block_t;
 
 // RTOS functions
@@ -41,11 +69,18 @@ void suspend_task(task_handle_t task);
 void resume_task(task_handle_t task);
 void rtos_delay(uint32_t ticks);
 
+// Most words of its stack a task has used so far, found from the fill
+// pattern the stack was painted with; NULL for the calling task
+uint32_t task_stack_high_water(task_handle_t task);
+
 // Scheduler functions
 void scheduler_init(void);
 void scheduler_start(void);
 void scheduler_tick(void);
 
+// Blocking calls wait up to timeout ticks, RTOS_WAIT_FOREVER for no
+// limit. Interrupt handlers may only call them with a timeout of 0.
+
 // Mutex functions
 typedef void* mutex_handle_t;
 mutex_handle_t create_mutex(void);
@@ -67,6 +102,67 @@ void delete_queue(queue_handle_t queue);
 bool send_to_queue(queue_handle_t queue, const void* item, uint32_t timeout);
 bool receive_from_queue(queue_handle_t queue, void* item, uint32_t timeout);
 
+// Queues have a single producer and a single consumer, either of which may
+// be an interrupt handler; items move without masking interrupts. The slot
+// functions lend out the queue's own storage so large items such as
+// packet_t are filled and read in place: the producer fills a loaned slot
+// and commits it, the consumer reads a received slot and releases it.
+void* loan_queue_slot(queue_handle_t queue, uint32_t timeout);
+void commit_queue_slot(queue_handle_t queue);
+const void* receive_queue_slot(queue_handle_t queue, uint32_t timeout);
+void release_queue_slot(queue_handle_t queue);
+uint32_t queue_count(queue_handle_t queue);
+
+// Fixed-size block pools over storage sized at build time. Allocation
+// and free take constant time and may be called from interrupt handlers.
+// Free blocks hold a pointer in their first word, so storage must be
+// pointer-aligned and block_size a multiple of the pointer size, at least
+// sizeof(void*).
+typedef struct {
+    void* free;                // first free block, linked through each free block's first word
+    uint32_t block_size;       // bytes
+    uint32_t blocks;
+    uint32_t free_blocks;
+    uint32_t min_free_blocks;  // fewest ever free
+} pool_t;
+
+void pool_init(pool_t* pool, void* storage, uint32_t block_size, uint32_t blocks);
+void* pool_alloc(pool_t* pool);
+void pool_free(pool_t* pool, void* block);
+
+// Port functions, in firmware_asm.S: mask IRQs and return the previous
+// CPSR, and put the saved CPSR back
+uint32_t irq_save(void);
+void irq_restore(uint32_t state);
+
+// Saves the running context into from and resumes to, with IRQs masked.
+// from is NULL when the running context is to be dropped: the startup
+// code, or a task deleting itself.
+void port_switch(task_control_block_t* from, task_control_block_t* to);
+
+// Free-running CPU cycle counter
+uint32_t port_cycle_count(void);
+
+// Provided by the board, which owns the tick timer. Sleeps until an
+// interrupt or for at most ticks ticks, with the tick stopped, and returns
+// the whole ticks that passed; the caller announces them. Called and
+// returns with IRQs masked, the waking interrupt still pending.
+uint32_t port_idle_sleep(uint32_t ticks);
+
+// Called by the port around interrupt handlers. Switches the handler asks
+// for are made when the outermost handler exits.
+void rtos_isr_enter(void);
+void rtos_isr_exit(void);
+
+// Scheduler counters
+typedef struct {
+    uint32_t context_switches;
+    uint32_t idle_sleeps;
+    uint64_t idle_cycles;  // spent asleep in the idle task
+} rtos_stats_t;
+
+void rtos_get_stats(rtos_stats_t* stats);
+
 // System functions
 void rtos_init(void);
 void rtos_start(void);
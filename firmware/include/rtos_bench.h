@@ -0,0 +1,20 @@
+#pragma once
+
+#include "rtos.h"
+
+// RTOS benchmark results, in CPU cycles
+typedef struct {
+    uint32_t switches;            // switches timed
+    uint32_t switch_cycles_min;   // from a semaphore give to the woken task running
+    uint32_t switch_cycles_mean;
+    uint32_t switch_cycles_max;
+    uint32_t window_cycles;       // the caller's idle window
+    uint32_t sleep_cycles;        // of which the idle task slept
+    uint32_t idle_permille;       // sleep_cycles per thousand window cycles
+} rtos_bench_result_t;
+
+// Times switches to a task woken by a semaphore, then delays the calling
+// task for idle_ticks and measures how much of that time the CPU slept.
+// Call from a task below the top priority. Returns false if the
+// benchmark's semaphore or task could not be created.
+bool rtos_bench_run(uint32_t switches, uint32_t idle_ticks, rtos_bench_result_t* result);
@@ -0,0 +1,22 @@
+#include "crc32c.h"
+
+// One nibble per lookup keeps the table at 64 bytes of flash. The packets
+// the firmware checks are small, so the sliced tables the simulator uses
+// would cost more memory than they save time.
+static const uint32_t crc_nibble_table[16] = {
+    0x00000000, 0x105EC76F, 0x20BD8EDE, 0x30E349B1,
+    0x417B1DBC, 0x5125DAD3, 0x61C69362, 0x7198540D,
+    0x82F63B78, 0x92A8FC17, 0xA24BB5A6, 0xB21572C9,
+    0xC38D26C4, 0xD3D3E1AB, 0xE330A81A, 0xF36E6F75
+};
+
+uint32_t crc32c(const void* data, size_t length, uint32_t crc) {
+    const uint8_t* p = (const uint8_t*)data;
+    crc = ~crc;
+    while (length--) {
+        crc ^= *p++;
+        crc = (crc >> 4) ^ crc_nibble_table[crc & 0x0F];
+        crc = (crc >> 4) ^ crc_nibble_table[crc & 0x0F];
+    }
+    return ~crc;
+}
@@ -1,17 +1,31 @@
 #include "firmware.h"
+#include "crc32c.h"
+#include "link_dma.h"
 #include "rtos.h"
+#include <stddef.h>
 
 // Global variables
 link_stats_t g_link_stats = {0};
 bool g_link_initialized = false;
 error_code_t g_last_error = ERROR_NONE;
 
+#ifdef FIRMWARE_HOST
+reg_bus_t g_reg_bus;
+#endif
+
 // RTOS task handles
 static task_handle_t g_link_monitor_task;
 static task_handle_t g_error_handler_task;
 static task_handle_t g_self_test_task;
 static task_handle_t g_packet_processor_task;
 
+// Timer count the next scheduler tick is due at
+static uint32_t g_next_tick;
+
+// Packet buffer pool, aligned for the free list's pointers
+static packet_t g_packet_storage[PACKET_POOL_SIZE] __attribute__((aligned(8)));
+static pool_t g_packet_pool;
+
 void firmware_init(void) {
     // Initialize hardware
     disable_interrupts();
@@ -21,8 +35,11 @@ void firmware_init(void) {
     write_reg(ERROR_MASK_REG, 0);
     write_reg(ERROR_STATUS_REG, 0);
     
+    pool_init(&g_packet_pool, g_packet_storage, sizeof(packet_t), PACKET_POOL_SIZE);
+    
     // Initialize link
     link_init();
+    link_dma_init();
     
     // Create RTOS tasks
     g_link_monitor_task = create_task(link_monitor_task, "LinkMonitor", 512, 3);
@@ -30,6 +47,12 @@ void firmware_init(void) {
     g_self_test_task = create_task(self_test_task, "SelfTest", 512, 1);
     g_packet_processor_task = create_task(packet_processor_task, "PacketProc", 512, 4);
     
+#ifndef FIRMWARE_HOST
+    enable_cycle_counter();
+#endif
+    
+    timer_init();
+    
     // Enable interrupts
     enable_interrupts();
 }
@@ -52,7 +75,7 @@ void link_init(void) {
     }
     
     // Enable error detection
-    write_reg(ERROR_MASK_REG, ERROR_CRC | ERROR_TIMEOUT | ERROR_OVERFLOW | ERROR_UNDERFLOW);
+    write_reg(ERROR_MASK_REG, ERR_CRC | ERR_TIMEOUT | ERR_OVERFLOW | ERR_UNDERFLOW);
     
     g_link_initialized = true;
 }
@@ -60,18 +83,19 @@ void link_init(void) {
 void error_handler(void) {
     uint32_t error_status = read_reg(ERROR_STATUS_REG);
     
-    if (error_status & ERROR_CRC) {
+    if (error_status & ERR_CRC) {
         g_last_error = ERROR_CRC_FAIL;
         g_link_stats.crc_errors++;
     }
-    else if (error_status & ERROR_TIMEOUT) {
+    else if (error_status & ERR_TIMEOUT) {
         g_last_error = ERROR_TIMEOUT;
         g_link_stats.timeout_errors++;
     }
-    else if (error_status & ERROR_OVERFLOW) {
+    else if (error_status & ERR_OVERFLOW) {
         g_last_error = ERROR_OVERFLOW;
+        g_link_stats.rx_overruns++;
     }
-    else if (error_status & ERROR_UNDERFLOW) {
+    else if (error_status & ERR_UNDERFLOW) {
         g_last_error = ERROR_UNDERFLOW;
     }
     
@@ -91,36 +115,107 @@ void self_test(void) {
     write_reg(LINK_CONTROL_REG, LINK_TEST_MODE | LINK_LOOPBACK);
     
     // Send test pattern
-    packet_t test_packet = {0};
-    test_packet.header = 0xAA55AA55;
-    for (int i = 0; i < sizeof(test_packet.payload); i++) {
-        test_packet.payload[i] = i & 0xFF;
+    packet_t* test_packet = packet_alloc();
+    if (test_packet) {
+        test_packet->header = 0xAA55AA55;
+        for (int i = 0; i < sizeof(test_packet->payload); i++) {
+            test_packet->payload[i] = i & 0xFF;
+        }
+        
+        packet_seal(test_packet);
+        
+        // Send packet; it loops back into the receive ring
+        link_dma_transmit(test_packet);
+        packet_free(test_packet);
     }
     
-    // Calculate CRC (simplified)
-    test_packet.crc = 0x12345678;
-    
-    // Send packet
-    process_packet();
-    
     // Disable test mode
     write_reg(LINK_CONTROL_REG, LINK_ENABLE);
 }
 
-void process_packet(void) {
-    if (!g_link_initialized) {
-        return;
+packet_t* packet_alloc(void) {
+    return (packet_t*)pool_alloc(&g_packet_pool);
+}
+
+void packet_free(packet_t* packet) {
+    pool_free(&g_packet_pool, packet);
+}
+
+// The CRC covers the header and payload
+void packet_seal(packet_t* packet) {
+    packet->crc = crc32c(packet, offsetof(packet_t, crc), 0);
+}
+
+bool packet_check(const packet_t* packet) {
+    return crc32c(packet, offsetof(packet_t, crc), 0) == packet->crc;
+}
+
+void process_packet(const packet_t* packet, uint32_t status) {
+    g_link_stats.packets_received++;
+    
+    // Check for errors
+    if (status & DMA_DESC_ERROR) {
+        error_handler();
+    }
+    else if (!packet_check(packet)) {
+        g_last_error = ERROR_CRC_FAIL;
+        g_link_stats.crc_errors++;
+        g_link_stats.errors_detected++;
+    }
+}
+
+// Starts the scheduler tick, one tick from now
+void timer_init(void) {
+    g_next_tick = read_reg(TIMER_COUNT_REG) + TIMER_TICK_USECS;
+    write_reg(TIMER_COMPARE_REG, g_next_tick);
+    write_reg(IRQ_ENABLE_REG, read_reg(IRQ_ENABLE_REG) | IRQ_TIMER);
+}
+
+// Arms the timer for the tick after this one; a tick that is already late
+// fires straight away, so missed ticks are caught up one at a time
+static void timer_tick(void) {
+    g_next_tick += TIMER_TICK_USECS;
+    write_reg(TIMER_COMPARE_REG, g_next_tick);
+    scheduler_tick();
+}
+
+// Tickless idle: the timer is set for the tick the first delayed task is
+// due on rather than the next one, and the ticks that pass while asleep
+// are returned instead of raised one by one
+uint32_t port_idle_sleep(uint32_t ticks) {
+    if (ticks > TIMER_MAX_SLEEP_TICKS) {
+        ticks = TIMER_MAX_SLEEP_TICKS;
+    }
+    if (ticks > 1) {
+        write_reg(TIMER_COMPARE_REG, g_next_tick + (ticks - 1) * TIMER_TICK_USECS);
     }
     
-    // Check for packet availability
-    if (read_reg(LINK_STATUS_REG) & LINK_ACTIVE) {
-        // Process packet
-        g_link_stats.packets_received++;
-        
-        // Check for errors
-        if (read_reg(LINK_STATUS_REG) & LINK_ERROR) {
-            error_handler();
-        }
+    wait_for_interrupt();
+    
+    // Whole ticks passed, counting the one g_next_tick was due for
+    int32_t late = (int32_t)(read_reg(TIMER_COUNT_REG) - g_next_tick);
+    uint32_t elapsed = late < 0 ? 0 : (uint32_t)late / TIMER_TICK_USECS + 1;
+    g_next_tick += elapsed * TIMER_TICK_USECS;
+    
+    // The caller announces them, so a pending timer interrupt must not;
+    // the tick restarts from the next one due
+    if (elapsed) {
+        write_reg(IRQ_STATUS_REG, IRQ_TIMER);
+    }
+    write_reg(TIMER_COMPARE_REG, g_next_tick);
+    return elapsed;
+}
+
+// IRQ dispatch, called from irq_handler
+void handle_irq(void) {
+    uint32_t status = read_reg(IRQ_STATUS_REG);
+    write_reg(IRQ_STATUS_REG, status);
+    
+    if (status & IRQ_TIMER) {
+        timer_tick();
+    }
+    if (status & IRQ_LINK_RX) {
+        link_dma_rx_irq();
     }
 }
 
@@ -133,11 +228,6 @@ void link_monitor_task(void) {
             link_init();
         }
         
-        // Update statistics
-        if (read_reg(LINK_STATUS_REG) & LINK_ACTIVE) {
-            g_link_stats.packets_sent++;
-        }
-        
         // Sleep for 100ms
         rtos_delay(100);
     }
@@ -165,10 +255,12 @@ void self_test_task(void) {
 
 void packet_processor_task(void) {
     while (1) {
-        // Process packets
-        process_packet();
+        // Sleep until the coalesced receive interrupt
+        link_dma_rx_wait();
         
-        // Sleep for 10ms
-        rtos_delay(10);
+        // Drain the ring in batches until a batch comes up short
+        while (link_dma_receive(LINK_DMA_BUDGET) == LINK_DMA_BUDGET) {
+            // More may be waiting
+        }
     }
 } 
\ No newline at end of file
@@ -0,0 +1,127 @@
+#include "link_dma.h"
+#include "rtos.h"
+
+// Descriptor rings and their packet buffers
+dma_descriptor_t g_rx_ring[LINK_DMA_RX_DESCRIPTORS];
+dma_descriptor_t g_tx_ring[LINK_DMA_TX_DESCRIPTORS];
+static packet_t rx_buffers[LINK_DMA_RX_DESCRIPTORS];
+static packet_t tx_buffers[LINK_DMA_TX_DESCRIPTORS];
+
+// Free-running descriptor counts, as in the head and tail registers
+static uint32_t rx_next = 0;  // next descriptor to handle
+static uint32_t tx_head = 0;  // last value read from DMA_TX_HEAD_REG
+static uint32_t tx_tail = 0;  // next descriptor to queue
+
+// Given by the receive interrupt; binary, so interrupts raised before the
+// task gets to run fold into one wakeup
+static semaphore_handle_t rx_ready;
+
+static void irq_unmask(uint32_t bits) {
+    uint32_t state = irq_save();
+    write_reg(IRQ_ENABLE_REG, read_reg(IRQ_ENABLE_REG) | bits);
+    irq_restore(state);
+}
+
+static void irq_mask(uint32_t bits) {
+    uint32_t state = irq_save();
+    write_reg(IRQ_ENABLE_REG, read_reg(IRQ_ENABLE_REG) & ~bits);
+    irq_restore(state);
+}
+
+bool link_dma_init(void) {
+    if (!rx_ready) {
+        rx_ready = create_semaphore(0, 1);
+        if (!rx_ready) {
+            return false;
+        }
+    }
+
+    irq_mask(IRQ_LINK_RX);
+
+    for (uint32_t i = 0; i < LINK_DMA_RX_DESCRIPTORS; i++) {
+        g_rx_ring[i].buffer = (dma_addr_t)(uintptr_t)&rx_buffers[i];
+        g_rx_ring[i].status = 0;
+    }
+    for (uint32_t i = 0; i < LINK_DMA_TX_DESCRIPTORS; i++) {
+        g_tx_ring[i].buffer = (dma_addr_t)(uintptr_t)&tx_buffers[i];
+        g_tx_ring[i].status = 0;
+    }
+    rx_next = 0;
+    tx_head = 0;
+    tx_tail = 0;
+
+    // Setting a ring's size restarts its head and tail at 0
+    write_reg(DMA_RX_RING_REG, (uint32_t)(uintptr_t)g_rx_ring);
+    write_reg(DMA_RX_SIZE_REG, LINK_DMA_RX_DESCRIPTORS);
+    write_reg(DMA_TX_RING_REG, (uint32_t)(uintptr_t)g_tx_ring);
+    write_reg(DMA_TX_SIZE_REG, LINK_DMA_TX_DESCRIPTORS);
+#ifdef FIRMWARE_HOST
+    write_reg(DMA_RX_RING_HI_REG, (uint32_t)((uint64_t)(uintptr_t)g_rx_ring >> 32));
+    write_reg(DMA_TX_RING_HI_REG, (uint32_t)((uint64_t)(uintptr_t)g_tx_ring >> 32));
+#endif
+    write_reg(IRQ_COALESCE_REG, IRQ_COALESCE_COUNT(LINK_DMA_COALESCE_PACKETS) |
+                                IRQ_COALESCE_USECS(LINK_DMA_COALESCE_USECS));
+
+    // Every receive buffer starts out with the hardware
+    write_reg(DMA_RX_TAIL_REG, LINK_DMA_RX_DESCRIPTORS);
+    return true;
+}
+
+void link_dma_rx_irq(void) {
+    g_link_stats.rx_interrupts++;
+    irq_mask(IRQ_LINK_RX);
+    give_semaphore(rx_ready);
+}
+
+void link_dma_rx_wait(void) {
+    irq_unmask(IRQ_LINK_RX);
+    take_semaphore(rx_ready, RTOS_WAIT_FOREVER);
+}
+
+uint32_t link_dma_receive(uint32_t budget) {
+    uint32_t handled = 0;
+
+    // The done bits in memory say how far the hardware got, so the drain
+    // costs no register reads
+    while (handled < budget) {
+        dma_descriptor_t* desc = &g_rx_ring[rx_next & (LINK_DMA_RX_DESCRIPTORS - 1)];
+        uint32_t status = desc->status;
+        if (!(status & DMA_DESC_DONE)) {
+            break;
+        }
+
+        // The buffer is read only after the done bit
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        process_packet((const packet_t*)desc->buffer, status);
+        desc->status = 0;
+        rx_next++;
+        handled++;
+    }
+
+    if (handled) {
+        // Descriptors go back with their status cleared
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        write_reg(DMA_RX_TAIL_REG, rx_next + LINK_DMA_RX_DESCRIPTORS);
+    }
+    return handled;
+}
+
+bool link_dma_transmit(const packet_t* packet) {
+    // Sent descriptors are reclaimed only when the ring looks full
+    if (tx_tail - tx_head == LINK_DMA_TX_DESCRIPTORS) {
+        tx_head = read_reg(DMA_TX_HEAD_REG);
+        if (tx_tail - tx_head == LINK_DMA_TX_DESCRIPTORS) {
+            return false;
+        }
+    }
+
+    dma_descriptor_t* desc = &g_tx_ring[tx_tail & (LINK_DMA_TX_DESCRIPTORS - 1)];
+    *(packet_t*)desc->buffer = *packet;
+    desc->status = 0;
+    tx_tail++;
+
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    write_reg(DMA_TX_TAIL_REG, tx_tail);
+    g_link_stats.packets_sent++;
+    return true;
+}
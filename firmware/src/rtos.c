@@ -1,53 +1,352 @@
 #include "rtos.h"
+#include <stddef.h>
 #include <string.h>
 
 // Maximum number of tasks
 #define MAX_TASKS 16
 
-// Task control blocks
+// Task control blocks. Slots are reused but never moved, so a handle stays
+// valid until its own task is deleted.
 static task_control_block_t task_list[MAX_TASKS];
-static uint32_t num_tasks = 0;
+static uint32_t task_slots = 0;  // bit i set while task_list[i] holds a task
 static task_control_block_t* current_task = NULL;
+static task_control_block_t* cpu_task = NULL;  // whose context the CPU holds
+static uint32_t isr_nesting = 0;
 static uint32_t tick_count = 0;
+static bool scheduler_running = false;
+static rtos_stats_t stats;
+
+// The idle task holds the CPU while current_task is NULL. It is never in
+// a ready list.
+static task_control_block_t idle_task;
+static uint32_t idle_stack[RTOS_IDLE_STACK_SIZE] __attribute__((aligned(8)));
+
+// Ready tasks, in a circular list per priority whose head runs next. The
+// running task stays at the head of its list. Bit p of ready_priorities is
+// set while ready_lists[p] is not empty, so the highest ready priority is
+// one count of leading zeros away.
+static task_control_block_t* ready_lists[RTOS_MAX_PRIORITIES];
+static uint32_t ready_priorities = 0;
+
+// Delayed tasks in wake-up order. Each sleep_ticks counts from the task
+// ahead of it, so a tick only decrements the head.
+static task_control_block_t* timer_queue = NULL;
+
+// Tasks blocked on an object, highest priority first and in arrival order
+// within a priority
+typedef struct wait_list {
+    task_control_block_t* head;
+} wait_list_t;
+
+typedef struct {
+    task_control_block_t* owner;
+    wait_list_t waiters;
+} mutex_t;
+
+typedef struct {
+    uint32_t count;
+    uint32_t max_count;
+    wait_list_t waiters;
+} semaphore_t;
+
+// Single-producer single-consumer ring. head is written by the producer
+// only and tail by the consumer only, so neither side needs a lock; one
+// slot always stays empty to tell a full ring from an empty one.
+typedef struct {
+    uint8_t* storage;
+    uint32_t item_size;
+    uint32_t slot_size;  // item_size rounded up to whole words
+    uint32_t slots;
+    uint32_t head;  // next slot to fill
+    uint32_t tail;  // next slot to drain
+    wait_list_t receivers;
+    wait_list_t senders;
+} queue_t;
+
+// Memory pools. Tasks, objects and queues draw their memory from these
+// and nothing else, so creating and deleting them costs the same every
+// time and never fragments.
+typedef union {
+    mutex_t mutex;
+    semaphore_t semaphore;
+    queue_t queue;
+} object_t;
+
+// Stacks are 8-byte aligned as the ARM procedure call standard wants, and
+// so is queue storage, which also holds the free list's pointers
+static uint32_t stack_storage[RTOS_STACK_BLOCKS][RTOS_STACK_BLOCK_SIZE] __attribute__((aligned(8)));
+static object_t object_storage[RTOS_OBJECT_BLOCKS];
+static uint32_t queue_storage[RTOS_QUEUE_BLOCKS][RTOS_QUEUE_BLOCK_SIZE / 4] __attribute__((aligned(8)));
+static pool_t stack_pool;
+static pool_t object_pool;
+static pool_t queue_pool;
+
+// Stacks are painted with this byte so their high-water mark can be found
+#define STACK_FILL_BYTE  0xA5
+#define STACK_FILL_WORD  0xA5A5A5A5u
+
+#ifndef FIRMWARE_HOST
+// First return of port_switch into a new task, in firmware_asm.S
+void port_task_start(void);
+
+_Static_assert(offsetof(task_control_block_t, stack_pointer) == 32,
+               "port_switch stores the stack pointer at offset 32");
+#endif
 
 // Task stack initialization
 static void init_task_stack(task_control_block_t* task) {
-    // Initialize stack with pattern
-    for (uint32_t i = 0; i < task->stack_size; i++) {
-        task->stack[i] = 0xDEADBEEF;
+    // Paint with a byte pattern, so memset can do it in block stores
+    memset(task->stack, STACK_FILL_BYTE, task->stack_size * sizeof(uint32_t));
+    
+#ifdef FIRMWARE_HOST
+    // Host ports run tasks on stacks of their own
+    task->stack_pointer = 0;
+#else
+    // The frame port_switch restores, 8-byte aligned. It returns into
+    // port_task_start, which unmasks IRQs and calls the entry point in R4.
+    uint32_t* sp = (uint32_t*)((uintptr_t)&task->stack[task->stack_size] & ~(uintptr_t)7);
+    *(--sp) = (uint32_t)(uintptr_t)port_task_start;  // LR
+    *(--sp) = 0x00000000;  // R12, padding
+    *(--sp) = 0x00000000;  // R11
+    *(--sp) = 0x00000000;  // R10
+    *(--sp) = 0x00000000;  // R9
+    *(--sp) = 0x00000000;  // R8
+    *(--sp) = 0x00000000;  // R7
+    *(--sp) = 0x00000000;  // R6
+    *(--sp) = (uint32_t)(uintptr_t)task;  // R5
+    *(--sp) = (uint32_t)(uintptr_t)task->entry_point;  // R4
+    
+    task->stack_pointer = (uint32_t)(uintptr_t)sp;
+#endif
+}
+
+// Ready lists
+static void ready_insert(task_control_block_t* task) {
+    uint32_t priority = task->priority;
+    task_control_block_t* head = ready_lists[priority];
+    
+    // Joins at the tail, behind every task already waiting at its priority
+    if (head) {
+        task->next = head;
+        task->prev = head->prev;
+        head->prev->next = task;
+        head->prev = task;
+    } else {
+        task->next = task;
+        task->prev = task;
+        ready_lists[priority] = task;
+        ready_priorities |= 1u << priority;
     }
+    task->state = TASK_READY;
+}
+
+static void ready_remove(task_control_block_t* task) {
+    uint32_t priority = task->priority;
     
-    // Set up initial stack frame
-    uint32_t* sp = &task->stack[task->stack_size - 1];
+    if (task->next == task) {
+        ready_lists[priority] = NULL;
+        ready_priorities &= ~(1u << priority);
+    } else {
+        task->prev->next = task->next;
+        task->next->prev = task->prev;
+        if (ready_lists[priority] == task) {
+            ready_lists[priority] = task->next;
+        }
+    }
+}
+
+// Timer queue
+static void timer_insert(task_control_block_t* task, uint32_t ticks) {
+    task_control_block_t* prev = NULL;
+    task_control_block_t* next = timer_queue;
     
-    // Simulate context saved by hardware
-    *(--sp) = 0x00000000;  // R0
-    *(--sp) = 0x00000000;  // R1
-    *(--sp) = 0x00000000;  // R2
-    *(--sp) = 0x00000000;  // R3
-    *(--sp) = 0x00000000;  // R4
-    *(--sp) = 0x00000000;  // R5
-    *(--sp) = 0x00000000;  // R6
-    *(--sp) = 0x00000000;  // R7
-    *(--sp) = 0x00000000;  // R8
-    *(--sp) = 0x00000000;  // R9
-    *(--sp) = 0x00000000;  // R10
-    *(--sp) = 0x00000000;  // R11
-    *(--sp) = 0x00000000;  // R12
-    *(--sp) = 0x00000000;  // LR
-    *(--sp) = 0x00000000;  // PC
-    *(--sp) = 0x00000013;  // CPSR (SVC mode)
+    // Tasks waking on the same tick wake in the order they were delayed
+    while (next && next->sleep_ticks <= ticks) {
+        ticks -= next->sleep_ticks;
+        prev = next;
+        next = next->next;
+    }
     
-    task->stack_pointer = (uint32_t)sp;
+    task->sleep_ticks = ticks;
+    task->delayed = true;
+    task->prev = prev;
+    task->next = next;
+    if (next) {
+        next->sleep_ticks -= ticks;
+        next->prev = task;
+    }
+    if (prev) {
+        prev->next = task;
+    } else {
+        timer_queue = task;
+    }
+}
+
+static void timer_remove(task_control_block_t* task) {
+    task->delayed = false;
+    if (task->next) {
+        task->next->sleep_ticks += task->sleep_ticks;
+        task->next->prev = task->prev;
+    }
+    if (task->prev) {
+        task->prev->next = task->next;
+    } else {
+        timer_queue = task->next;
+    }
+}
+
+// Wait lists
+static void wait_insert(wait_list_t* list, task_control_block_t* task) {
+    task_control_block_t** link = &list->head;
+    while (*link && (*link)->priority >= task->priority) {
+        link = &(*link)->wait_next;
+    }
+    task->wait_next = *link;
+    task->wait_list = list;
+    *link = task;
+}
+
+static void wait_remove(task_control_block_t* task) {
+    task_control_block_t** link = &task->wait_list->head;
+    while (*link != task) {
+        link = &(*link)->wait_next;
+    }
+    *link = task->wait_next;
+    task->wait_list = NULL;
+}
+
+// Takes a task off whichever lists hold it
+static void unlink_task(task_control_block_t* task) {
+    if (task->state == TASK_READY || task->state == TASK_RUNNING) {
+        ready_remove(task);
+    } else if (task->state == TASK_BLOCKED) {
+        if (task->delayed) {
+            timer_remove(task);
+        }
+        if (task->wait_list) {
+            wait_remove(task);
+        }
+    }
+}
+
+// Hands the CPU to current_task, or the idle task without one, if another
+// context holds it
+static void switch_context(void) {
+    task_control_block_t* to = current_task ? current_task : &idle_task;
+    if (cpu_task != to) {
+        task_control_block_t* from = cpu_task;
+        cpu_task = to;
+        stats.context_switches++;
+        port_switch(from, to);
+    }
+}
+
+// Switches to the head of the highest-priority ready list; inside an
+// interrupt handler the switch waits for rtos_isr_exit
+static void reschedule(void) {
+    if (!scheduler_running) {
+        return;
+    }
+    
+    task_control_block_t* next_task = NULL;
+    if (ready_priorities) {
+        next_task = ready_lists[31 - __builtin_clz(ready_priorities)];
+    }
+    if (next_task != current_task) {
+        if (current_task && current_task->state == TASK_RUNNING) {
+            current_task->state = TASK_READY;
+        }
+        current_task = next_task;
+        if (current_task) {
+            current_task->state = TASK_RUNNING;
+            current_task->slice_ticks = RTOS_TIME_SLICE_TICKS;
+        }
+    }
+    
+    if (!isr_nesting) {
+        switch_context();
+    }
+}
+
+// Blocks the current task on list for up to timeout ticks. Called with
+// interrupts masked; the task runs again once woken or timed out and then
+// finds the outcome in wait_result.
+static void block_current(wait_list_t* list, uint32_t timeout) {
+    task_control_block_t* task = current_task;
+    ready_remove(task);
+    task->state = TASK_BLOCKED;
+    task->wait_result = false;
+    wait_insert(list, task);
+    if (timeout != RTOS_WAIT_FOREVER) {
+        timer_insert(task, timeout);
+    }
+    reschedule();
+}
+
+// Readies the first waiter on list, straight away rather than on the next
+// tick, and returns it. Called with interrupts masked.
+static task_control_block_t* wake_first(wait_list_t* list) {
+    task_control_block_t* task = list->head;
+    if (!task) {
+        return NULL;
+    }
+    
+    list->head = task->wait_next;
+    task->wait_list = NULL;
+    task->wait_result = true;
+    if (task->delayed) {
+        timer_remove(task);
+    }
+    ready_insert(task);
+    reschedule();
+    return task;
+}
+
+static void wake(wait_list_t* list) {
+    uint32_t state = irq_save();
+    wake_first(list);
+    irq_restore(state);
+}
+
+// Releases every waiter with a failed wait, for objects being deleted
+static void abort_waits(wait_list_t* list) {
+    uint32_t state = irq_save();
+    while (list->head) {
+        task_control_block_t* task = list->head;
+        list->head = task->wait_next;
+        task->wait_list = NULL;
+        if (task->delayed) {
+            timer_remove(task);
+        }
+        ready_insert(task);
+    }
+    reschedule();
+    irq_restore(state);
 }
 
 // Task creation
 task_handle_t create_task(void (*entry_point)(void), const char* name, uint32_t stack_size, task_priority_t priority) {
-    if (num_tasks >= MAX_TASKS) {
+    if ((uint32_t)priority >= RTOS_MAX_PRIORITIES || stack_size > RTOS_STACK_BLOCK_SIZE) {
+        return NULL;
+    }
+    
+    uint32_t* stack = (uint32_t*)pool_alloc(&stack_pool);
+    if (!stack) {
+        return NULL;
+    }
+    
+    uint32_t state = irq_save();
+    uint32_t free_slots = ~task_slots & ((1u << MAX_TASKS) - 1);
+    if (!free_slots) {
+        irq_restore(state);
+        pool_free(&stack_pool, stack);
         return NULL;
     }
+    uint32_t slot = __builtin_ctz(free_slots);
+    task_slots |= 1u << slot;
+    irq_restore(state);
     
-    task_control_block_t* task = &task_list[num_tasks++];
+    task_control_block_t* task = &task_list[slot];
     
     // Initialize task control block
     strncpy(task->name, name, sizeof(task->name) - 1);
@@ -55,132 +354,513 @@ task_handle_t create_task(void (*entry_point)(void), const char* name, uint32_t
     task->entry_point = entry_point;
     task->stack_size = stack_size;
     task->priority = priority;
-    task->state = TASK_READY;
     task->sleep_ticks = 0;
-    
-    // Allocate stack
-    task->stack = (uint32_t*)malloc(stack_size * sizeof(uint32_t));
-    if (!task->stack) {
-        num_tasks--;
-        return NULL;
-    }
+    task->slice_ticks = 0;
+    task->delayed = false;
+    task->wait_list = NULL;
+    task->wait_next = NULL;
+    task->wait_result = false;
+    task->stack = stack;
     
     // Initialize stack
     init_task_stack(task);
     
+    state = irq_save();
+    ready_insert(task);
+    reschedule();
+    irq_restore(state);
+    
     return task;
 }
 
 // Task deletion
 void delete_task(task_handle_t task) {
     task_control_block_t* tcb = (task_control_block_t*)task;
+    if (!tcb) {
+        return;
+    }
     
-    // Free stack
-    free(tcb->stack);
+    uint32_t state = irq_save();
+    unlink_task(tcb);
+    tcb->state = TASK_SUSPENDED;
+    task_slots &= ~(1u << (tcb - task_list));
+    if (current_task == tcb) {
+        current_task = NULL;
+    }
+    if (cpu_task == tcb) {
+        cpu_task = NULL;
+    }
     
-    // Remove from task list
-    for (uint32_t i = 0; i < num_tasks; i++) {
-        if (&task_list[i] == tcb) {
-            // Shift remaining tasks
-            for (uint32_t j = i; j < num_tasks - 1; j++) {
-                task_list[j] = task_list[j + 1];
-            }
-            num_tasks--;
-            break;
-        }
+    // Freed before the switch, since a task deleting itself never gets
+    // back; with IRQs masked nothing can take the block while it still
+    // runs on it
+    pool_free(&stack_pool, tcb->stack);
+    tcb->stack = NULL;
+    reschedule();
+    irq_restore(state);
+}
+
+uint32_t task_stack_high_water(task_handle_t task) {
+    task_control_block_t* tcb = task ? (task_control_block_t*)task : current_task;
+    if (!tcb || !tcb->stack) {
+        return 0;
+    }
+    
+    // Stacks grow down, so the untouched words are at the bottom
+    uint32_t untouched = 0;
+    while (untouched < tcb->stack_size && tcb->stack[untouched] == STACK_FILL_WORD) {
+        untouched++;
     }
+    return tcb->stack_size - untouched;
 }
 
 // Task suspension
 void suspend_task(task_handle_t task) {
     task_control_block_t* tcb = (task_control_block_t*)task;
-    tcb->state = TASK_SUSPENDED;
+    
+    uint32_t state = irq_save();
+    if (tcb->state != TASK_SUSPENDED) {
+        unlink_task(tcb);
+        tcb->state = TASK_SUSPENDED;
+        reschedule();
+    }
+    irq_restore(state);
 }
 
 // Task resumption
 void resume_task(task_handle_t task) {
     task_control_block_t* tcb = (task_control_block_t*)task;
+    
+    uint32_t state = irq_save();
     if (tcb->state == TASK_SUSPENDED) {
-        tcb->state = TASK_READY;
+        ready_insert(tcb);
+        reschedule();
     }
+    irq_restore(state);
 }
 
 // Task delay
 void rtos_delay(uint32_t ticks) {
-    if (current_task) {
-        current_task->sleep_ticks = ticks;
-        current_task->state = TASK_BLOCKED;
+    if (!current_task || ticks == 0) {
+        return;
     }
+    
+    uint32_t state = irq_save();
+    task_control_block_t* task = current_task;
+    ready_remove(task);
+    task->state = TASK_BLOCKED;
+    timer_insert(task, ticks);
+    reschedule();
+    irq_restore(state);
 }
 
 // Scheduler initialization
 void scheduler_init(void) {
-    num_tasks = 0;
+    for (uint32_t i = 0; i < RTOS_MAX_PRIORITIES; i++) {
+        ready_lists[i] = NULL;
+    }
+    ready_priorities = 0;
+    timer_queue = NULL;
+    task_slots = 0;
     current_task = NULL;
+    cpu_task = NULL;
+    isr_nesting = 0;
     tick_count = 0;
+    scheduler_running = false;
+    memset(&stats, 0, sizeof(stats));
+    
+    strcpy(idle_task.name, "Idle");
+    idle_task.entry_point = rtos_idle_task;
+    idle_task.stack = idle_stack;
+    idle_task.stack_size = RTOS_IDLE_STACK_SIZE;
+    idle_task.priority = 0;
+    idle_task.state = TASK_READY;
+    init_task_stack(&idle_task);
 }
 
-// Scheduler tick
-void scheduler_tick(void) {
-    tick_count++;
+// Scheduler start
+void scheduler_start(void) {
+    uint32_t state = irq_save();
+    scheduler_running = true;
+    reschedule();
+    irq_restore(state);
+}
+
+// Moves time on by ticks, waking delayed tasks whose time has come
+static void advance_ticks(uint32_t ticks) {
+    tick_count += ticks;
     
-    // Update task states
-    for (uint32_t i = 0; i < num_tasks; i++) {
-        task_control_block_t* task = &task_list[i];
-        
-        if (task->state == TASK_BLOCKED) {
-            if (task->sleep_ticks > 0) {
-                task->sleep_ticks--;
-                if (task->sleep_ticks == 0) {
-                    task->state = TASK_READY;
-                }
-            }
+    while (timer_queue && timer_queue->sleep_ticks <= ticks) {
+        task_control_block_t* task = timer_queue;
+        ticks -= task->sleep_ticks;
+        timer_queue = task->next;
+        if (timer_queue) {
+            timer_queue->prev = NULL;
         }
+        task->delayed = false;
+        if (task->wait_list) {
+            wait_remove(task);
+        }
+        ready_insert(task);
     }
+    if (timer_queue) {
+        timer_queue->sleep_ticks -= ticks;
+    }
+}
+
+// Scheduler tick, from the timer interrupt. Only the head of the timer
+// queue is touched and the next task is found without scanning, so the
+// tick costs the same whatever the number of tasks; only tasks waking on
+// this tick add to it.
+void scheduler_tick(void) {
+    advance_ticks(1);
     
-    // Find highest priority ready task
-    task_control_block_t* next_task = NULL;
-    task_priority_t highest_priority = 0;
-    
-    for (uint32_t i = 0; i < num_tasks; i++) {
-        task_control_block_t* task = &task_list[i];
-        
-        if (task->state == TASK_READY && task->priority > highest_priority) {
-            next_task = task;
-            highest_priority = task->priority;
-        }
+#if RTOS_TIME_SLICE_TICKS > 0
+    // Round robin: at the end of its slice the running task moves behind
+    // the other ready tasks of its priority
+    if (current_task && current_task->state == TASK_RUNNING && --current_task->slice_ticks == 0) {
+        current_task->slice_ticks = RTOS_TIME_SLICE_TICKS;
+        ready_lists[current_task->priority] = current_task->next;
     }
+#endif
     
     // Perform context switch if needed
-    if (next_task && next_task != current_task) {
-        if (current_task) {
-            current_task->state = TASK_READY;
-        }
-        current_task = next_task;
-        current_task->state = TASK_RUNNING;
-        
-        // Context switch would happen here
-        // In a real implementation, this would save the current context
-        // and restore the new task's context
+    reschedule();
+}
+
+// Interrupt nesting, maintained by the port with interrupts masked
+void rtos_isr_enter(void) {
+    isr_nesting++;
+}
+
+// Before rtos_start there is no task to switch to; the interrupted boot
+// code carries on and starts the scheduler itself
+void rtos_isr_exit(void) {
+    if (--isr_nesting == 0 && scheduler_running) {
+        switch_context();
     }
 }
 
 // RTOS initialization
 void rtos_init(void) {
     scheduler_init();
+    pool_init(&stack_pool, stack_storage, sizeof(stack_storage[0]), RTOS_STACK_BLOCKS);
+    pool_init(&object_pool, object_storage, sizeof(object_storage[0]), RTOS_OBJECT_BLOCKS);
+    pool_init(&queue_pool, queue_storage, sizeof(queue_storage[0]), RTOS_QUEUE_BLOCKS);
 }
 
 // RTOS start
 void rtos_start(void) {
-    // Start the first task
-    if (num_tasks > 0) {
-        current_task = &task_list[0];
-        current_task->state = TASK_RUNNING;
-        
-        // Start the task
-        // In a real implementation, this would set up the initial context
-        // and start the first task
+    // Start the highest-priority ready task
+    scheduler_start();
+}
+
+// Mutexes hand ownership straight to the first waiter
+mutex_handle_t create_mutex(void) {
+    mutex_t* mutex = (mutex_t*)pool_alloc(&object_pool);
+    if (!mutex) {
+        return NULL;
+    }
+    
+    mutex->owner = NULL;
+    mutex->waiters.head = NULL;
+    return mutex;
+}
+
+void delete_mutex(mutex_handle_t mutex) {
+    mutex_t* m = (mutex_t*)mutex;
+    abort_waits(&m->waiters);
+    pool_free(&object_pool, m);
+}
+
+bool take_mutex(mutex_handle_t mutex, uint32_t timeout) {
+    mutex_t* m = (mutex_t*)mutex;
+    task_control_block_t* task = current_task;
+    if (!task) {
+        return false;
+    }
+    
+    uint32_t state = irq_save();
+    if (!m->owner) {
+        m->owner = task;
+        irq_restore(state);
+        return true;
+    }
+    if (timeout == 0 || m->owner == task) {
+        irq_restore(state);
+        return false;
+    }
+    block_current(&m->waiters, timeout);
+    irq_restore(state);
+    
+    return task->wait_result;
+}
+
+void give_mutex(mutex_handle_t mutex) {
+    mutex_t* m = (mutex_t*)mutex;
+    
+    uint32_t state = irq_save();
+    if (m->owner == current_task) {
+        m->owner = wake_first(&m->waiters);
+    }
+    irq_restore(state);
+}
+
+// Semaphores hand a given count straight to the first waiter
+semaphore_handle_t create_semaphore(uint32_t initial_count, uint32_t max_count) {
+    if (max_count == 0 || initial_count > max_count) {
+        return NULL;
+    }
+    
+    semaphore_t* semaphore = (semaphore_t*)pool_alloc(&object_pool);
+    if (!semaphore) {
+        return NULL;
+    }
+    
+    semaphore->count = initial_count;
+    semaphore->max_count = max_count;
+    semaphore->waiters.head = NULL;
+    return semaphore;
+}
+
+void delete_semaphore(semaphore_handle_t semaphore) {
+    semaphore_t* s = (semaphore_t*)semaphore;
+    abort_waits(&s->waiters);
+    pool_free(&object_pool, s);
+}
+
+bool take_semaphore(semaphore_handle_t semaphore, uint32_t timeout) {
+    semaphore_t* s = (semaphore_t*)semaphore;
+    task_control_block_t* task = current_task;
+    
+    uint32_t state = irq_save();
+    if (s->count > 0) {
+        s->count--;
+        irq_restore(state);
+        return true;
+    }
+    if (timeout == 0 || !task) {
+        irq_restore(state);
+        return false;
+    }
+    block_current(&s->waiters, timeout);
+    irq_restore(state);
+    
+    return task->wait_result;
+}
+
+void give_semaphore(semaphore_handle_t semaphore) {
+    semaphore_t* s = (semaphore_t*)semaphore;
+    
+    uint32_t state = irq_save();
+    if (!wake_first(&s->waiters) && s->count < s->max_count) {
+        s->count++;
+    }
+    irq_restore(state);
+}
+
+// Queues
+static uint32_t queue_next(const queue_t* q, uint32_t index) {
+    return index + 1 == q->slots ? 0 : index + 1;
+}
+
+// The slot the producer fills next, NULL while the ring is full
+static void* queue_free_slot(queue_t* q) {
+    uint32_t head = q->head;
+    if (queue_next(q, head) == __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE)) {
+        return NULL;
+    }
+    return q->storage + head * q->slot_size;
+}
+
+// The slot the consumer drains next, NULL while the ring is empty
+static const void* queue_filled_slot(queue_t* q) {
+    uint32_t tail = q->tail;
+    if (tail == __atomic_load_n(&q->head, __ATOMIC_ACQUIRE)) {
+        return NULL;
+    }
+    return q->storage + tail * q->slot_size;
+}
+
+queue_handle_t create_queue(uint32_t item_size, uint32_t queue_size) {
+    // Items stay word aligned so a loaned slot can hold any structure
+    uint32_t slot_size = (item_size + 3) & ~3u;
+    if (item_size == 0 || queue_size == 0 ||
+        (uint64_t)slot_size * (queue_size + 1) > RTOS_QUEUE_BLOCK_SIZE) {
+        return NULL;
     }
+    
+    queue_t* q = (queue_t*)pool_alloc(&object_pool);
+    if (!q) {
+        return NULL;
+    }
+    
+    q->item_size = item_size;
+    q->slot_size = slot_size;
+    q->slots = queue_size + 1;
+    q->storage = (uint8_t*)pool_alloc(&queue_pool);
+    if (!q->storage) {
+        pool_free(&object_pool, q);
+        return NULL;
+    }
+    
+    q->head = 0;
+    q->tail = 0;
+    q->receivers.head = NULL;
+    q->senders.head = NULL;
+    return q;
+}
+
+void delete_queue(queue_handle_t queue) {
+    queue_t* q = (queue_t*)queue;
+    abort_waits(&q->receivers);
+    abort_waits(&q->senders);
+    pool_free(&queue_pool, q->storage);
+    pool_free(&object_pool, q);
+}
+
+void* loan_queue_slot(queue_handle_t queue, uint32_t timeout) {
+    queue_t* q = (queue_t*)queue;
+    task_control_block_t* task = current_task;
+    
+    void* slot = queue_free_slot(q);
+    if (slot || timeout == 0 || !task) {
+        return slot;
+    }
+    
+    // Check again with interrupts masked so a release in between cannot
+    // be missed
+    uint32_t state = irq_save();
+    slot = queue_free_slot(q);
+    if (!slot) {
+        block_current(&q->senders, timeout);
+    }
+    irq_restore(state);
+    
+    // Only this producer fills the ring, so the slot freed for it is still
+    // free
+    if (!slot && task->wait_result) {
+        slot = queue_free_slot(q);
+    }
+    return slot;
+}
+
+void commit_queue_slot(queue_handle_t queue) {
+    queue_t* q = (queue_t*)queue;
+    
+    // The release store orders the item's contents before the new head
+    __atomic_store_n(&q->head, queue_next(q, q->head), __ATOMIC_RELEASE);
+    if (q->receivers.head) {
+        wake(&q->receivers);
+    }
+}
+
+const void* receive_queue_slot(queue_handle_t queue, uint32_t timeout) {
+    queue_t* q = (queue_t*)queue;
+    task_control_block_t* task = current_task;
+    
+    const void* slot = queue_filled_slot(q);
+    if (slot || timeout == 0 || !task) {
+        return slot;
+    }
+    
+    uint32_t state = irq_save();
+    slot = queue_filled_slot(q);
+    if (!slot) {
+        block_current(&q->receivers, timeout);
+    }
+    irq_restore(state);
+    
+    if (!slot && task->wait_result) {
+        slot = queue_filled_slot(q);
+    }
+    return slot;
+}
+
+void release_queue_slot(queue_handle_t queue) {
+    queue_t* q = (queue_t*)queue;
+    
+    __atomic_store_n(&q->tail, queue_next(q, q->tail), __ATOMIC_RELEASE);
+    if (q->senders.head) {
+        wake(&q->senders);
+    }
+}
+
+bool send_to_queue(queue_handle_t queue, const void* item, uint32_t timeout) {
+    queue_t* q = (queue_t*)queue;
+    
+    void* slot = loan_queue_slot(queue, timeout);
+    if (!slot) {
+        return false;
+    }
+    
+    memcpy(slot, item, q->item_size);
+    commit_queue_slot(queue);
+    return true;
+}
+
+bool receive_from_queue(queue_handle_t queue, void* item, uint32_t timeout) {
+    queue_t* q = (queue_t*)queue;
+    
+    const void* slot = receive_queue_slot(queue, timeout);
+    if (!slot) {
+        return false;
+    }
+    
+    memcpy(item, slot, q->item_size);
+    release_queue_slot(queue);
+    return true;
+}
+
+uint32_t queue_count(queue_handle_t queue) {
+    queue_t* q = (queue_t*)queue;
+    uint32_t head = __atomic_load_n(&q->head, __ATOMIC_ACQUIRE);
+    uint32_t tail = __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE);
+    return head >= tail ? head - tail : head + q->slots - tail;
+}
+
+// Memory pools. Free blocks are linked through their first word, so a
+// pool needs no memory beyond its blocks.
+void pool_init(pool_t* pool, void* storage, uint32_t block_size, uint32_t blocks) {
+    uint8_t* block = (uint8_t*)storage;
+    
+    pool->free = blocks ? storage : NULL;
+    for (uint32_t i = 0; i + 1 < blocks; i++) {
+        *(void**)block = block + block_size;
+        block += block_size;
+    }
+    if (blocks) {
+        *(void**)block = NULL;
+    }
+    pool->block_size = block_size;
+    pool->blocks = blocks;
+    pool->free_blocks = blocks;
+    pool->min_free_blocks = blocks;
+}
+
+void* pool_alloc(pool_t* pool) {
+    uint32_t state = irq_save();
+    void* block = pool->free;
+    if (block) {
+        pool->free = *(void**)block;
+        if (--pool->free_blocks < pool->min_free_blocks) {
+            pool->min_free_blocks = pool->free_blocks;
+        }
+    }
+    irq_restore(state);
+    return block;
+}
+
+void pool_free(pool_t* pool, void* block) {
+    if (!block) {
+        return;
+    }
+    
+    uint32_t state = irq_save();
+    *(void**)block = pool->free;
+    pool->free = block;
+    pool->free_blocks++;
+    irq_restore(state);
 }
 
 // Get tick count
@@ -188,10 +868,35 @@ uint32_t rtos_get_tick_count(void) {
     return tick_count;
 }
 
-// Idle task
+void rtos_get_stats(rtos_stats_t* out) {
+    uint32_t state = irq_save();
+    *out = stats;
+    irq_restore(state);
+}
+
+// Idle task, holding the CPU while no other task is ready. It sleeps until
+// the first delayed task is due, with the tick stopped, or until an
+// interrupt readies a task; the ticks slept are announced in one step.
 void rtos_idle_task(void) {
     while (1) {
-        // Enter low-power mode
-        // In a real implementation, this would put the CPU in a low-power state
+        uint32_t state = irq_save();
+        if (!ready_priorities) {
+#if RTOS_TICKLESS_IDLE
+            uint32_t ticks = timer_queue ? timer_queue->sleep_ticks : RTOS_WAIT_FOREVER;
+#else
+            uint32_t ticks = 1;
+#endif
+            uint32_t start = port_cycle_count();
+            uint32_t slept = port_idle_sleep(ticks);
+            stats.idle_cycles += port_cycle_count() - start;
+            stats.idle_sleeps++;
+            if (slept) {
+                advance_ticks(slept);
+                reschedule();
+            }
+        }
+        
+        // Takes the interrupt that woke the CPU
+        irq_restore(state);
     }
 } 
\ No newline at end of file
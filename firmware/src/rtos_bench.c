@@ -0,0 +1,67 @@
+#include "rtos_bench.h"
+
+// Wakes the partner task; given with the cycle count in given_at
+static semaphore_handle_t bench_wake;
+static volatile uint32_t given_at;
+static volatile uint32_t latency;
+
+// Runs at the top priority, so a give switches to it straight away
+static void bench_partner_task(void) {
+    while (1) {
+        take_semaphore(bench_wake, RTOS_WAIT_FOREVER);
+        latency = port_cycle_count() - given_at;
+    }
+}
+
+bool rtos_bench_run(uint32_t switches, uint32_t idle_ticks, rtos_bench_result_t* result) {
+    bench_wake = create_semaphore(0, 1);
+    if (!bench_wake) {
+        return false;
+    }
+    
+    // Runs until it first blocks on bench_wake
+    task_handle_t partner = create_task(bench_partner_task, "Bench", 256,
+                                        (task_priority_t)(RTOS_MAX_PRIORITIES - 1));
+    if (!partner) {
+        delete_semaphore(bench_wake);
+        return false;
+    }
+    
+    uint64_t total = 0;
+    result->switches = switches;
+    result->switch_cycles_min = switches ? UINT32_MAX : 0;
+    result->switch_cycles_max = 0;
+    for (uint32_t i = 0; i < switches; i++) {
+        given_at = port_cycle_count();
+        give_semaphore(bench_wake);
+        
+        // The partner has run and is waiting again
+        uint32_t cycles = latency;
+        total += cycles;
+        if (cycles < result->switch_cycles_min) {
+            result->switch_cycles_min = cycles;
+        }
+        if (cycles > result->switch_cycles_max) {
+            result->switch_cycles_max = cycles;
+        }
+    }
+    result->switch_cycles_mean = switches ? (uint32_t)(total / switches) : 0;
+    
+    delete_task(partner);
+    delete_semaphore(bench_wake);
+    
+    // Idle residency while this task sleeps and the rest of the firmware
+    // carries on
+    rtos_stats_t before;
+    rtos_stats_t after;
+    rtos_get_stats(&before);
+    uint32_t start = port_cycle_count();
+    rtos_delay(idle_ticks);
+    result->window_cycles = port_cycle_count() - start;
+    rtos_get_stats(&after);
+    
+    result->sleep_cycles = (uint32_t)(after.idle_cycles - before.idle_cycles);
+    result->idle_permille = result->window_cycles
+        ? (uint32_t)((uint64_t)result->sleep_cycles * 1000 / result->window_cycles) : 0;
+    return true;
+}
@@ -0,0 +1,355 @@
+// Host test of the firmware's DMA receive and transmit paths.
+//
+// Models the link, DMA ring and interrupt registers on the register bus:
+// arriving packets are written into the receive descriptors the
+// firmware handed over, the receive interrupt is coalesced by count and
+// timeout, and transmitted packets are sent or looped back. Interrupts are
+// delivered by calling handle_irq as soon as one is pending, enabled and
+// not masked by irq_save, the way irq_handler would.
+//
+// Build with FIRMWARE_HOST defined; exits non-zero on a failed check.
+
+#include "firmware.h"
+#include "link_dma.h"
+#include "rtos.h"
+#include <stdio.h>
+#include <string.h>
+
+#define REG_BASE   0x10000000
+#define REG_COUNT  32
+#define REG(addr)  regs[((addr) - REG_BASE) / 4]
+
+static int failures = 0;
+
+#define CHECK(cond)                                                              \
+    do {                                                                         \
+        if (!(cond)) {                                                           \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            failures++;                                                          \
+        }                                                                        \
+    } while (0)
+
+// Register and device state
+static uint32_t regs[REG_COUNT];
+static uint32_t irq_raw = 0;         // pending interrupts, enabled or not
+static bool irq_masked = false;      // CPU I bit
+static bool in_handler = false;
+static uint32_t rx_head = 0;         // receive descriptors filled
+static uint32_t tx_head = 0;         // transmit descriptors sent
+static bool tx_stalled = false;      // holds transmit descriptors in flight
+static uint32_t tx_sent = 0;         // packets sent out of the link
+static uint32_t coalesce_pending = 0;
+static uint64_t coalesce_start = 0;
+static uint64_t now_usecs = 0;
+
+// Takes every pending, enabled interrupt, one handler call at a time
+static void deliver_irqs(void) {
+    while (!irq_masked && !in_handler && (irq_raw & REG(IRQ_ENABLE_REG))) {
+        in_handler = true;
+        irq_masked = true;
+        rtos_isr_enter();
+        handle_irq();
+        rtos_isr_exit();
+        irq_masked = false;
+        in_handler = false;
+    }
+}
+
+static void raise_irq(uint32_t bits) {
+    irq_raw |= bits;
+    deliver_irqs();
+}
+
+static void raise_rx(void) {
+    coalesce_pending = 0;
+    raise_irq(IRQ_LINK_RX);
+}
+
+// A packet arrives from the link; false if it was dropped
+static bool model_receive(const packet_t* packet, uint32_t flags) {
+    if (rx_head == REG(DMA_RX_TAIL_REG)) {
+        REG(ERROR_STATUS_REG) |= ERR_OVERFLOW;
+        return false;
+    }
+
+    dma_descriptor_t* desc = &g_rx_ring[rx_head & (REG(DMA_RX_SIZE_REG) - 1)];
+    *(packet_t*)desc->buffer = *packet;
+    desc->status = DMA_DESC_DONE | flags;
+    rx_head++;
+
+    if (coalesce_pending++ == 0) {
+        coalesce_start = now_usecs;
+    }
+    if (coalesce_pending >= (REG(IRQ_COALESCE_REG) & 0xFFFF)) {
+        raise_rx();
+    }
+    return true;
+}
+
+static void model_advance(uint64_t usecs) {
+    now_usecs += usecs;
+    if (coalesce_pending && now_usecs - coalesce_start >= (REG(IRQ_COALESCE_REG) >> 16)) {
+        raise_rx();
+    }
+}
+
+static void model_transmit(void) {
+    while (!tx_stalled && tx_head != REG(DMA_TX_TAIL_REG)) {
+        dma_descriptor_t* desc = &g_tx_ring[tx_head & (REG(DMA_TX_SIZE_REG) - 1)];
+        packet_t packet = *(const packet_t*)desc->buffer;
+        desc->status = DMA_DESC_DONE;
+        tx_head++;
+        if (REG(LINK_CONTROL_REG) & LINK_LOOPBACK) {
+            model_receive(&packet, 0);
+        } else {
+            tx_sent++;
+        }
+    }
+}
+
+static void model_write(void* context, uint32_t addr, uint32_t value) {
+    (void)context;
+    switch (addr) {
+        case LINK_CONTROL_REG:
+            REG(addr) = value;
+            if (value & LINK_RESET) {
+                REG(LINK_STATUS_REG) &= ~LINK_UP;
+            }
+            if (value & LINK_ENABLE) {
+                REG(LINK_STATUS_REG) |= LINK_UP;
+            }
+            break;
+        case ERROR_STATUS_REG:
+        case IRQ_STATUS_REG:
+            // Write 1 to clear
+            if (addr == IRQ_STATUS_REG) {
+                irq_raw &= ~value;
+            } else {
+                REG(addr) &= ~value;
+            }
+            break;
+        case DMA_RX_SIZE_REG:
+            REG(addr) = value;
+            REG(DMA_RX_TAIL_REG) = 0;
+            rx_head = 0;
+            coalesce_pending = 0;
+            break;
+        case DMA_TX_SIZE_REG:
+            REG(addr) = value;
+            REG(DMA_TX_TAIL_REG) = 0;
+            tx_head = 0;
+            break;
+        case DMA_TX_TAIL_REG:
+            REG(addr) = value;
+            model_transmit();
+            break;
+        case IRQ_ENABLE_REG:
+            REG(addr) = value;
+            deliver_irqs();
+            break;
+        default:
+            REG(addr) = value;
+            break;
+    }
+}
+
+static uint32_t model_read(void* context, uint32_t addr) {
+    (void)context;
+    switch (addr) {
+        case DMA_RX_HEAD_REG: return rx_head;
+        case DMA_TX_HEAD_REG: return tx_head;
+        case IRQ_STATUS_REG: return irq_raw & REG(IRQ_ENABLE_REG);
+        default: return REG(addr);
+    }
+}
+
+// CPU port
+void enable_interrupts(void) {
+    irq_masked = false;
+    deliver_irqs();
+}
+
+void disable_interrupts(void) {
+    irq_masked = true;
+}
+
+uint32_t irq_save(void) {
+    uint32_t state = irq_masked;
+    irq_masked = true;
+    return state;
+}
+
+void irq_restore(uint32_t state) {
+    irq_masked = state != 0;
+    deliver_irqs();
+}
+
+// The scheduler is never started, so there is nothing to switch and the
+// idle task never sleeps
+void port_switch(task_control_block_t* from, task_control_block_t* to) {
+    (void)from;
+    (void)to;
+}
+
+void wait_for_interrupt(void) {
+}
+
+uint32_t port_cycle_count(void) {
+    return 0;
+}
+
+static packet_t make_packet(uint32_t sequence) {
+    packet_t packet;
+    memset(&packet, 0, sizeof(packet));
+    packet.header = sequence;
+    for (uint32_t i = 0; i < sizeof(packet.payload); i++) {
+        packet.payload[i] = (uint8_t)(sequence * 7 + i);
+    }
+    packet_seal(&packet);
+    return packet;
+}
+
+static void arrive(uint32_t count) {
+    static uint32_t sequence = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        packet_t packet = make_packet(sequence++);
+        model_receive(&packet, 0);
+    }
+}
+
+static void test_coalescing(void) {
+    uint32_t received = g_link_stats.packets_received;
+    uint32_t interrupts = g_link_stats.rx_interrupts;
+
+    // By count: nothing until the threshold
+    link_dma_rx_wait();
+    arrive(LINK_DMA_COALESCE_PACKETS - 1);
+    CHECK(g_link_stats.rx_interrupts == interrupts);
+    arrive(1);
+    CHECK(g_link_stats.rx_interrupts == interrupts + 1);
+    CHECK(!(REG(IRQ_ENABLE_REG) & IRQ_LINK_RX));
+    CHECK(link_dma_receive(LINK_DMA_BUDGET) == LINK_DMA_COALESCE_PACKETS);
+    CHECK(g_link_stats.packets_received == received + LINK_DMA_COALESCE_PACKETS);
+    CHECK(REG(DMA_RX_TAIL_REG) == rx_head + LINK_DMA_RX_DESCRIPTORS);
+
+    // By timeout: a few packets wait at most the coalescing delay
+    link_dma_rx_wait();
+    arrive(3);
+    model_advance(LINK_DMA_COALESCE_USECS - 1);
+    CHECK(g_link_stats.rx_interrupts == interrupts + 1);
+    model_advance(1);
+    CHECK(g_link_stats.rx_interrupts == interrupts + 2);
+    CHECK(link_dma_receive(LINK_DMA_BUDGET) == 3);
+    CHECK(link_dma_receive(LINK_DMA_BUDGET) == 0);
+}
+
+static void test_batch_drain(void) {
+    uint32_t received = g_link_stats.packets_received;
+    uint32_t interrupts = g_link_stats.rx_interrupts;
+
+    // Packets keep arriving while the task drains with the interrupt masked
+    link_dma_rx_wait();
+    arrive(LINK_DMA_COALESCE_PACKETS);
+    CHECK(g_link_stats.rx_interrupts == interrupts + 1);
+    arrive(LINK_DMA_BUDGET + 8);
+    CHECK(g_link_stats.rx_interrupts == interrupts + 1);
+    CHECK(link_dma_receive(LINK_DMA_BUDGET) == LINK_DMA_BUDGET);
+    CHECK(link_dma_receive(LINK_DMA_BUDGET) == LINK_DMA_COALESCE_PACKETS + 8);
+    CHECK(link_dma_receive(LINK_DMA_BUDGET) == 0);
+    CHECK(g_link_stats.packets_received == received + LINK_DMA_COALESCE_PACKETS + LINK_DMA_BUDGET + 8);
+
+    // Many laps of the ring, in coalesced batches
+    received = g_link_stats.packets_received;
+    interrupts = g_link_stats.rx_interrupts;
+    const uint32_t batches = 200;
+    for (uint32_t i = 0; i < batches; i++) {
+        link_dma_rx_wait();
+        arrive(LINK_DMA_COALESCE_PACKETS);
+        while (link_dma_receive(LINK_DMA_BUDGET) == LINK_DMA_BUDGET) {
+        }
+    }
+    CHECK(g_link_stats.packets_received == received + batches * LINK_DMA_COALESCE_PACKETS);
+    CHECK(g_link_stats.rx_interrupts - interrupts <= batches + 1);
+    CHECK(g_link_stats.crc_errors == 0);
+    printf("%u packets in %u receive interrupts\n", g_link_stats.packets_received - received,
+           g_link_stats.rx_interrupts - interrupts);
+}
+
+static void test_errors(void) {
+    // A full ring drops the packet and flags an overflow
+    uint32_t errors = g_link_stats.errors_detected;
+    arrive(LINK_DMA_RX_DESCRIPTORS + 1);
+    CHECK(REG(ERROR_STATUS_REG) & ERR_OVERFLOW);
+    error_handler();
+    CHECK(g_link_stats.rx_overruns == 1);
+    CHECK(REG(ERROR_STATUS_REG) == 0);
+    while (link_dma_receive(LINK_DMA_BUDGET) == LINK_DMA_BUDGET) {
+    }
+
+    // A corrupted payload fails its CRC; a flagged descriptor runs the
+    // error handler
+    uint32_t crc_errors = g_link_stats.crc_errors;
+    errors = g_link_stats.errors_detected;
+    packet_t packet = make_packet(12345);
+    packet.payload[5] ^= 0x10;
+    model_receive(&packet, 0);
+    packet = make_packet(12346);
+    model_receive(&packet, DMA_DESC_ERROR);
+    CHECK(link_dma_receive(LINK_DMA_BUDGET) == 2);
+    CHECK(g_link_stats.crc_errors == crc_errors + 1);
+    CHECK(g_link_stats.errors_detected == errors + 2);
+}
+
+static void test_transmit(void) {
+    // The self-test packet loops back into the receive ring intact
+    uint32_t received = g_link_stats.packets_received;
+    uint32_t crc_errors = g_link_stats.crc_errors;
+    self_test();
+    CHECK(link_dma_receive(LINK_DMA_BUDGET) == 1);
+    CHECK(g_link_stats.packets_received == received + 1);
+    CHECK(g_link_stats.crc_errors == crc_errors);
+
+    // A stalled link fills the transmit ring, which frees up once it sends
+    packet_t packet = make_packet(7);
+    uint32_t sent = tx_sent;
+    tx_stalled = true;
+    for (uint32_t i = 0; i < LINK_DMA_TX_DESCRIPTORS; i++) {
+        CHECK(link_dma_transmit(&packet));
+    }
+    CHECK(!link_dma_transmit(&packet));
+    tx_stalled = false;
+    model_transmit();
+    CHECK(tx_sent == sent + LINK_DMA_TX_DESCRIPTORS);
+    CHECK(link_dma_transmit(&packet));
+    CHECK(tx_sent == sent + LINK_DMA_TX_DESCRIPTORS + 1);
+}
+
+static void test_timer(void) {
+    uint32_t ticks = rtos_get_tick_count();
+    REG(IRQ_ENABLE_REG) |= IRQ_TIMER;
+    raise_irq(IRQ_TIMER);
+    raise_irq(IRQ_TIMER);
+    CHECK(rtos_get_tick_count() == ticks + 2);
+}
+
+int main(void) {
+    g_reg_bus.write = model_write;
+    g_reg_bus.read = model_read;
+    rtos_init();
+    firmware_init();
+    CHECK(g_link_initialized);
+    CHECK(REG(DMA_RX_TAIL_REG) == LINK_DMA_RX_DESCRIPTORS);
+
+    test_coalescing();
+    test_batch_drain();
+    test_errors();
+    test_transmit();
+    test_timer();
+
+    if (failures) {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    printf("dma ring test passed\n");
+    return 0;
+}
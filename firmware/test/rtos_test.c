@@ -0,0 +1,860 @@
+// Host test of the RTOS on a ucontext port.
+//
+// Every task runs on a ucontext of its own and port_switch swaps between
+// them, as the ARM port swaps stacks. Interrupts are delivered the way
+// irq_handler delivers them: as soon as one is pending, enabled and not
+// masked by irq_save, through rtos_isr_enter, handle_irq and
+// rtos_isr_exit, so a switch the handler asks for happens on the way out
+// and the interrupted task resumes there later. A new task starts in
+// task_start, which stands in for port_task_start.
+//
+// The registers are a model of the interrupt controller and the timer.
+// Time passes only when the idle task waits for an interrupt or a test
+// task spins with advance_time, so tick counts and wake-up times are
+// exact. Each test starts the scheduler from main; a task calls finish to
+// hand control back. The last one runs rtos_bench_run and checks its
+// switch timings and idle residency against the model's exact time.
+//
+// Build with FIRMWARE_HOST defined; exits non-zero on a failed check.
+
+#define _GNU_SOURCE
+#include "firmware.h"
+#include "rtos.h"
+#include "rtos_bench.h"
+#include <stdio.h>
+#include <string.h>
+#include <ucontext.h>
+
+#define REG_BASE   0x10000000
+#define REG_COUNT  32
+#define REG(addr)  regs[((addr) - REG_BASE) / 4]
+
+// Raised by tests to run test_isr from the interrupt handler
+#define IRQ_TEST   (1u << 7)
+
+#define MAX_CONTEXTS        24
+#define CONTEXT_STACK_SIZE  (64 * 1024)
+
+static int failures = 0;
+
+#define CHECK(cond)                                                              \
+    do {                                                                         \
+        if (!(cond)) {                                                           \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            failures++;                                                          \
+        }                                                                        \
+    } while (0)
+
+// Register and device state
+static uint32_t regs[REG_COUNT];
+static uint32_t irq_raw = 0;         // pending interrupts, enabled or not
+static bool irq_masked = false;      // CPU I bit
+static uint64_t now_usecs = 0;
+static uint64_t external_at = 0;     // raises IRQ_TEST at this time; 0 for never
+static void (*test_isr)(void) = NULL;
+
+// Contexts, numbered from 1 in their TCB's stack_pointer; main's is boot
+typedef struct {
+    ucontext_t context;
+    task_control_block_t* task;
+} context_t;
+
+static context_t contexts[MAX_CONTEXTS];
+static char context_stacks[MAX_CONTEXTS][CONTEXT_STACK_SIZE];
+static uint32_t contexts_used = 0;
+static context_t* running = NULL;    // NULL for main
+static ucontext_t boot_context;
+
+// Order tasks and handlers ran in, one character each
+static char order[64];
+static uint32_t order_length = 0;
+
+static void note(char c) {
+    if (order_length + 1 < sizeof(order)) {
+        order[order_length++] = c;
+        order[order_length] = '\0';
+    }
+}
+
+// Takes every pending, enabled interrupt, one handler call at a time
+static void deliver_irqs(void) {
+    while (!irq_masked && (irq_raw & REG(IRQ_ENABLE_REG))) {
+        irq_masked = true;
+        uint32_t test = irq_raw & IRQ_TEST;
+        rtos_isr_enter();
+        handle_irq();
+        if (test && test_isr) {
+            test_isr();
+        }
+
+        // May switch away; the rest runs once this task is resumed
+        rtos_isr_exit();
+        irq_masked = false;
+    }
+}
+
+// Raises IRQ_TIMER once the count reaches the compare value
+static void timer_update(void) {
+    if ((int32_t)(REG(TIMER_COMPARE_REG) - (uint32_t)now_usecs) <= 0) {
+        irq_raw |= IRQ_TIMER;
+    }
+    if (external_at && now_usecs >= external_at) {
+        external_at = 0;
+        irq_raw |= IRQ_TEST;
+    }
+}
+
+static void model_write(void* context, uint32_t addr, uint32_t value) {
+    (void)context;
+    switch (addr) {
+        case IRQ_STATUS_REG:
+            irq_raw &= ~value;
+            break;
+        case IRQ_ENABLE_REG:
+            REG(addr) = value;
+            deliver_irqs();
+            break;
+        case TIMER_COMPARE_REG:
+            REG(addr) = value;
+            timer_update();
+            break;
+        default:
+            REG(addr) = value;
+            break;
+    }
+}
+
+static uint32_t model_read(void* context, uint32_t addr) {
+    (void)context;
+    switch (addr) {
+        case IRQ_STATUS_REG: return irq_raw & REG(IRQ_ENABLE_REG);
+        case TIMER_COUNT_REG: return (uint32_t)now_usecs;
+        default: return REG(addr);
+    }
+}
+
+// A running task spinning for usecs; interrupts due meanwhile are taken
+static void advance_time(uint64_t usecs) {
+    now_usecs += usecs;
+    timer_update();
+    deliver_irqs();
+}
+
+// Runs isr from the interrupt handler straight away
+static void raise_test_irq(void (*isr)(void)) {
+    test_isr = isr;
+    irq_raw |= IRQ_TEST;
+    deliver_irqs();
+}
+
+// CPU port
+void enable_interrupts(void) {
+    irq_masked = false;
+    deliver_irqs();
+}
+
+void disable_interrupts(void) {
+    irq_masked = true;
+}
+
+uint32_t irq_save(void) {
+    uint32_t state = irq_masked;
+    irq_masked = true;
+    return state;
+}
+
+void irq_restore(uint32_t state) {
+    irq_masked = state != 0;
+    deliver_irqs();
+}
+
+// Sleeps until the next timer compare or external interrupt, as WFI
+// does: a pending interrupt wakes it whether masked or not
+void wait_for_interrupt(void) {
+    if (irq_raw & REG(IRQ_ENABLE_REG)) {
+        return;
+    }
+    uint64_t wake = now_usecs + (uint32_t)(REG(TIMER_COMPARE_REG) - (uint32_t)now_usecs);
+    if (external_at && external_at < wake) {
+        wake = external_at;
+    }
+    now_usecs = wake;
+    timer_update();
+}
+
+uint32_t port_cycle_count(void) {
+    return (uint32_t)now_usecs;
+}
+
+// Where a new task starts; like port_task_start it unmasks interrupts,
+// and suspends the task for good if it returns
+static void task_start(void) {
+    task_control_block_t* task = running->task;
+    irq_restore(0);
+    task->entry_point();
+    while (1) {
+        suspend_task(task);
+    }
+}
+
+static context_t* context_of(task_control_block_t* task) {
+    uint32_t id = task->stack_pointer;
+    if (id >= 1 && id <= contexts_used && contexts[id - 1].task == task) {
+        return &contexts[id - 1];
+    }
+    if (contexts_used == MAX_CONTEXTS) {
+        fprintf(stderr, "out of contexts\n");
+        return NULL;
+    }
+
+    context_t* context = &contexts[contexts_used++];
+    context->task = task;
+    task->stack_pointer = contexts_used;
+    getcontext(&context->context);
+    context->context.uc_stack.ss_sp = context_stacks[contexts_used - 1];
+    context->context.uc_stack.ss_size = CONTEXT_STACK_SIZE;
+    context->context.uc_link = NULL;
+    makecontext(&context->context, task_start, 0);
+    return context;
+}
+
+// A dropped context, from NULL, is saved anyway: for main it is where
+// finish returns to
+void port_switch(task_control_block_t* from, task_control_block_t* to) {
+    (void)from;
+    context_t* self = running;
+    context_t* next = context_of(to);
+    running = next;
+    swapcontext(self ? &self->context : &boot_context, &next->context);
+}
+
+// Ends the running test, back in main
+static void finish(void) {
+    context_t* self = running;
+    running = NULL;
+    swapcontext(&self->context, &boot_context);
+}
+
+// Fresh RTOS, registers and contexts, with the tick started at time 0
+static void reset(void) {
+    memset(regs, 0, sizeof(regs));
+    irq_raw = 0;
+    irq_masked = true;
+    now_usecs = 0;
+    external_at = 0;
+    test_isr = NULL;
+    contexts_used = 0;
+    running = NULL;
+    order_length = 0;
+    order[0] = '\0';
+
+    rtos_init();
+    REG(IRQ_ENABLE_REG) = IRQ_TEST;
+    timer_init();
+}
+
+// Starts the scheduler; returns once a task calls finish
+static void run(void) {
+    rtos_start();
+    irq_masked = true;
+}
+
+// A switch asked for inside an interrupt handler happens when it exits,
+// and the interrupted task carries on from there once resumed
+static semaphore_handle_t preempt_ready;
+
+static void preempt_isr(void) {
+    give_semaphore(preempt_ready);
+    note('i');
+}
+
+static void preempt_high_task(void) {
+    while (1) {
+        take_semaphore(preempt_ready, RTOS_WAIT_FOREVER);
+        note('H');
+    }
+}
+
+static void preempt_low_task(void) {
+    note('L');
+    raise_test_irq(preempt_isr);
+    note('l');
+    finish();
+}
+
+static void test_preempt_on_isr_exit(void) {
+    reset();
+    preempt_ready = create_semaphore(0, 1);
+    create_task(preempt_high_task, "High", 256, 3);
+    create_task(preempt_low_task, "Low", 256, 2);
+    run();
+    CHECK(strcmp(order, "LiHl") == 0);
+}
+
+// An interrupt taken before the scheduler starts switches nothing; the
+// boot code goes on to start it
+static void boot_isr(void) {
+    note('i');
+}
+
+static void boot_task(void) {
+    note('T');
+    finish();
+}
+
+static void test_irq_before_start(void) {
+    reset();
+    create_task(boot_task, "Boot", 256, 2);
+    irq_masked = false;
+    raise_test_irq(boot_isr);
+    note('b');
+    run();
+    CHECK(strcmp(order, "ibT") == 0);
+}
+
+// The idle task sleeps once for a whole delay and announces its ticks in
+// one step; an earlier interrupt cuts the sleep short to the whole ticks
+// that passed, and the tick carries on from the next one due
+static semaphore_handle_t tickless_wake;
+
+static void tickless_isr(void) {
+    give_semaphore(tickless_wake);
+}
+
+static void tickless_task(void) {
+    rtos_stats_t before;
+    rtos_stats_t after;
+    rtos_get_stats(&before);
+    uint32_t start = rtos_get_tick_count();
+    rtos_delay(10);
+    rtos_get_stats(&after);
+    CHECK(rtos_get_tick_count() - start == 10);
+    CHECK(now_usecs == 10 * TIMER_TICK_USECS);
+    CHECK(after.idle_sleeps - before.idle_sleeps == 1);
+    CHECK(after.idle_cycles - before.idle_cycles == 10 * TIMER_TICK_USECS);
+
+    start = rtos_get_tick_count();
+    uint64_t start_usecs = now_usecs;
+    uint64_t wake_usecs = start_usecs + 3 * TIMER_TICK_USECS + TIMER_TICK_USECS / 2;
+    test_isr = tickless_isr;
+    external_at = wake_usecs;
+    CHECK(take_semaphore(tickless_wake, 10));
+    CHECK(rtos_get_tick_count() - start == 3);
+    CHECK(now_usecs == wake_usecs);
+
+    rtos_delay(1);
+    CHECK(rtos_get_tick_count() - start == 4);
+    CHECK(now_usecs == start_usecs + 4 * TIMER_TICK_USECS);
+    finish();
+}
+
+static void test_tickless_idle(void) {
+    reset();
+    tickless_wake = create_semaphore(0, 1);
+    create_task(tickless_task, "Tickless", 256, 2);
+    run();
+}
+
+// Delays longer than the timer can sleep through are slept in pieces
+static void clamp_task(void) {
+    rtos_stats_t before;
+    rtos_stats_t after;
+    rtos_get_stats(&before);
+    uint32_t start = rtos_get_tick_count();
+    rtos_delay(TIMER_MAX_SLEEP_TICKS + 5);
+    rtos_get_stats(&after);
+    CHECK(rtos_get_tick_count() - start == TIMER_MAX_SLEEP_TICKS + 5);
+    CHECK(now_usecs == (uint64_t)(TIMER_MAX_SLEEP_TICKS + 5) * TIMER_TICK_USECS);
+    CHECK(after.idle_sleeps - before.idle_sleeps == 2);
+    finish();
+}
+
+static void test_idle_sleep_clamp(void) {
+    reset();
+
+    // With nothing due the tick stops for as long as the timer allows
+    CHECK(port_idle_sleep(RTOS_WAIT_FOREVER) == TIMER_MAX_SLEEP_TICKS);
+    CHECK(now_usecs == (uint64_t)TIMER_MAX_SLEEP_TICKS * TIMER_TICK_USECS);
+    CHECK(!(irq_raw & IRQ_TIMER));
+    CHECK(REG(TIMER_COMPARE_REG) == (uint32_t)now_usecs + TIMER_TICK_USECS);
+
+    reset();
+    create_task(clamp_task, "Clamp", 256, 2);
+    run();
+}
+
+// A task returning from its entry point is suspended and stays so
+static task_handle_t returning;
+
+static void returning_task(void) {
+    note('r');
+}
+
+static void return_control_task(void) {
+    returning = create_task(returning_task, "Returns", 256, 4);
+    CHECK(((task_control_block_t*)returning)->state == TASK_SUSPENDED);
+    resume_task(returning);
+    CHECK(((task_control_block_t*)returning)->state == TASK_SUSPENDED);
+    note('c');
+    finish();
+}
+
+static void test_task_return(void) {
+    reset();
+    create_task(return_control_task, "Control", 256, 3);
+    run();
+    CHECK(strcmp(order, "rc") == 0);
+}
+
+// Ready tasks of one priority take turns, a time slice each
+static void round_robin_task(void) {
+    char name = running->task->name[0];
+    while (1) {
+        note(name);
+        advance_time(TIMER_TICK_USECS);
+    }
+}
+
+static void round_robin_control_task(void) {
+    rtos_delay(10);
+    CHECK(strcmp(order, "ABABABABAB") == 0);
+    finish();
+}
+
+static void test_round_robin(void) {
+    reset();
+    create_task(round_robin_control_task, "Control", 256, 3);
+    create_task(round_robin_task, "A", 256, 2);
+    create_task(round_robin_task, "B", 256, 2);
+    run();
+}
+
+// The timer queue keeps each delay relative to the task ahead of it; a
+// task deleted while delayed hands its ticks on to the one behind it
+static uint32_t woken_at[4];
+
+static void delta_wait(uint32_t index, uint32_t ticks) {
+    rtos_delay(ticks);
+    woken_at[index] = rtos_get_tick_count();
+    note('a' + index);
+}
+
+static void delta_a_task(void) { delta_wait(0, 5); }
+static void delta_b_task(void) { delta_wait(1, 3); }
+static void delta_c_task(void) { delta_wait(2, 8); }
+static void delta_d_task(void) { delta_wait(3, 3); }
+
+static void delta_control_task(void) {
+    task_control_block_t* a = create_task(delta_a_task, "A", 256, 2);
+    task_control_block_t* b = create_task(delta_b_task, "B", 256, 2);
+    task_control_block_t* c = create_task(delta_c_task, "C", 256, 2);
+    task_control_block_t* d = create_task(delta_d_task, "D", 256, 2);
+
+    // Queued at tick 0 as B 3, D 0, A 2, C 3
+    rtos_delay(1);
+    CHECK(b->delayed && b->sleep_ticks == 2);
+    CHECK(b->next == d && d->sleep_ticks == 0);
+    CHECK(d->next == a && a->sleep_ticks == 2);
+    CHECK(a->next == c && c->sleep_ticks == 3);
+
+    delete_task(a);
+    CHECK(!a->delayed);
+    CHECK(d->next == c && c->sleep_ticks == 5);
+
+    rtos_delay(10);
+    CHECK(strcmp(order, "bdc") == 0);
+    CHECK(woken_at[1] == 3 && woken_at[3] == 3 && woken_at[2] == 8);
+    finish();
+}
+
+static void test_delta_queue(void) {
+    reset();
+    memset(woken_at, 0, sizeof(woken_at));
+    create_task(delta_control_task, "Control", 256, 3);
+    run();
+}
+
+// A tick only counts down the head of the timer queue, however many
+// tasks are delayed, and switches nothing while none is due
+#define SPREAD_TASKS 6
+
+static task_control_block_t* spread[SPREAD_TASKS];
+static uint32_t spread_started = 0;
+
+static void spread_task(void) {
+    rtos_delay(100 + spread_started++);
+}
+
+static void spread_control_task(void) {
+    for (uint32_t i = 0; i < SPREAD_TASKS; i++) {
+        spread[i] = create_task(spread_task, "Spread", 256, 2);
+    }
+    rtos_delay(1);
+
+    rtos_stats_t before;
+    rtos_stats_t after;
+    rtos_get_stats(&before);
+    uint32_t head = spread[0]->sleep_ticks;
+    for (uint32_t tick = 1; tick <= 20; tick++) {
+        advance_time(TIMER_TICK_USECS);
+        CHECK(spread[0]->sleep_ticks == head - tick);
+        for (uint32_t i = 1; i < SPREAD_TASKS; i++) {
+            CHECK(spread[i]->sleep_ticks == 1);
+        }
+    }
+    rtos_get_stats(&after);
+    CHECK(head == 99);
+    CHECK(rtos_get_tick_count() == 21);
+    CHECK(after.context_switches == before.context_switches);
+    finish();
+}
+
+static void test_tick_touches_head_only(void) {
+    reset();
+    spread_started = 0;
+    create_task(spread_control_task, "Control", 256, 3);
+    run();
+}
+
+// An interrupt handler fills the queue without blocking and hands the
+// first item straight to the task waiting on it; the task drains the rest
+// and then finds the queue empty
+static queue_handle_t items;
+static bool isr_sent[5];
+static uint32_t received[5];
+static uint32_t received_count = 0;
+
+static void queue_isr(void) {
+    for (uint32_t i = 0; i < 5; i++) {
+        uint32_t item = i + 1;
+        isr_sent[i] = send_to_queue(items, &item, 0);
+    }
+    note('i');
+}
+
+static void queue_consumer_task(void) {
+    uint32_t item;
+    while (receive_from_queue(items, &item, received_count ? 0 : RTOS_WAIT_FOREVER)) {
+        received[received_count++] = item;
+    }
+    note('C');
+    CHECK(rtos_get_tick_count() == 0);
+
+    CHECK(!receive_from_queue(items, &item, 3));
+    CHECK(rtos_get_tick_count() == 3);
+    note('T');
+}
+
+static void queue_control_task(void) {
+    raise_test_irq(queue_isr);
+    note('c');
+    rtos_delay(10);
+
+    CHECK(strcmp(order, "iCcT") == 0);
+    CHECK(isr_sent[0] && isr_sent[1] && isr_sent[2] && isr_sent[3] && !isr_sent[4]);
+    CHECK(received_count == 4);
+    for (uint32_t i = 0; i < received_count; i++) {
+        CHECK(received[i] == i + 1);
+    }
+    finish();
+}
+
+static void test_queue_from_isr(void) {
+    reset();
+    received_count = 0;
+    items = create_queue(sizeof(uint32_t), 4);
+    create_task(queue_consumer_task, "Consumer", 256, 3);
+    create_task(queue_control_task, "Control", 256, 2);
+    run();
+}
+
+// Slots are filled and read in place, and count until released
+typedef struct {
+    uint32_t sequence;
+    uint32_t value;
+} slot_item_t;
+
+static queue_handle_t slots;
+static const void* slot_seen;
+
+static void slot_consumer_task(void) {
+    const slot_item_t* item = receive_queue_slot(slots, RTOS_WAIT_FOREVER);
+    slot_seen = item;
+    CHECK(item && item->sequence == 1 && item->value == 0xCAFE);
+    CHECK(queue_count(slots) == 1);
+    release_queue_slot(slots);
+    note('R');
+}
+
+static void slot_producer_task(void) {
+    // The consumer waits on the empty queue and takes the first commit
+    create_task(slot_consumer_task, "Consumer", 256, 3);
+    slot_item_t* first = loan_queue_slot(slots, 0);
+    CHECK(first != NULL);
+    first->sequence = 1;
+    first->value = 0xCAFE;
+    commit_queue_slot(slots);
+    CHECK(strcmp(order, "R") == 0);
+    CHECK(slot_seen == first);
+    CHECK(queue_count(slots) == 0);
+
+    // Two slots fill the queue; nothing is taken until released
+    for (uint32_t i = 0; i < 2; i++) {
+        slot_item_t* item = loan_queue_slot(slots, 0);
+        CHECK(item != NULL);
+        if (item) {
+            item->sequence = 2 + i;
+            commit_queue_slot(slots);
+        }
+    }
+    CHECK(queue_count(slots) == 2);
+    CHECK(loan_queue_slot(slots, 0) == NULL);
+
+    const slot_item_t* item = receive_queue_slot(slots, 0);
+    CHECK(item && item->sequence == 2);
+    CHECK(receive_queue_slot(slots, 0) == item);
+    CHECK(queue_count(slots) == 2);
+    release_queue_slot(slots);
+    CHECK(queue_count(slots) == 1);
+
+    item = receive_queue_slot(slots, 0);
+    CHECK(item && item->sequence == 3);
+    release_queue_slot(slots);
+    CHECK(queue_count(slots) == 0);
+    CHECK(receive_queue_slot(slots, 0) == NULL);
+    finish();
+}
+
+static void test_queue_slots(void) {
+    reset();
+    slot_seen = NULL;
+    slots = create_queue(sizeof(slot_item_t), 2);
+    create_task(slot_producer_task, "Producer", 256, 2);
+    run();
+}
+
+// A mutex take times out after exactly its timeout; a give hands the
+// mutex to the waiter, and a give by a task not holding it does nothing
+static mutex_handle_t lock;
+
+static void mutex_waiter_task(void) {
+    CHECK(!take_mutex(lock, 4));
+    CHECK(rtos_get_tick_count() == 4);
+    note('t');
+
+    CHECK(take_mutex(lock, RTOS_WAIT_FOREVER));
+    CHECK(rtos_get_tick_count() == 6);
+    note('W');
+    rtos_delay(2);
+    give_mutex(lock);
+}
+
+static void mutex_control_task(void) {
+    CHECK(take_mutex(lock, 0));
+    create_task(mutex_waiter_task, "Waiter", 256, 3);
+    rtos_delay(6);
+    give_mutex(lock);
+
+    // The waiter holds it now
+    give_mutex(lock);
+    CHECK(!take_mutex(lock, 0));
+    CHECK(take_mutex(lock, RTOS_WAIT_FOREVER));
+    CHECK(rtos_get_tick_count() == 8);
+    note('C');
+
+    CHECK(strcmp(order, "tWC") == 0);
+    finish();
+}
+
+static void test_mutex(void) {
+    reset();
+    lock = create_mutex();
+    create_task(mutex_control_task, "Control", 256, 2);
+    run();
+}
+
+// Semaphore takes time out, gives stop at the maximum count, and a give
+// from an interrupt handler wakes a waiting task on the handler's exit
+static semaphore_handle_t count;
+
+static void semaphore_isr(void) {
+    give_semaphore(count);
+    note('i');
+}
+
+static void semaphore_taker_task(void) {
+    CHECK(take_semaphore(count, RTOS_WAIT_FOREVER));
+    note('S');
+}
+
+static void semaphore_control_task(void) {
+    CHECK(!take_semaphore(count, 0));
+    CHECK(!take_semaphore(count, 3));
+    CHECK(rtos_get_tick_count() == 3);
+
+    for (uint32_t i = 0; i < 3; i++) {
+        give_semaphore(count);
+    }
+    CHECK(take_semaphore(count, 0));
+    CHECK(take_semaphore(count, 0));
+    CHECK(!take_semaphore(count, 0));
+
+    create_task(semaphore_taker_task, "Taker", 256, 3);
+    raise_test_irq(semaphore_isr);
+    CHECK(strcmp(order, "iS") == 0);
+    CHECK(!take_semaphore(count, 0));
+    finish();
+}
+
+static void test_semaphore(void) {
+    reset();
+    count = create_semaphore(0, 2);
+    create_task(semaphore_control_task, "Control", 256, 2);
+    run();
+}
+
+// Pools hand out each block once, take freed blocks back first and
+// remember their lowest free count
+static void test_pool(void) {
+    static uint64_t storage[4][2];
+    pool_t pool;
+    void* blocks[4];
+
+    pool_init(&pool, storage, sizeof(storage[0]), 4);
+    for (uint32_t i = 0; i < 4; i++) {
+        blocks[i] = pool_alloc(&pool);
+        CHECK(blocks[i] != NULL);
+        CHECK((uint8_t*)blocks[i] >= (uint8_t*)storage &&
+              (uint8_t*)blocks[i] < (uint8_t*)storage + sizeof(storage));
+        for (uint32_t j = 0; j < i; j++) {
+            CHECK(blocks[i] != blocks[j]);
+        }
+    }
+    CHECK(pool_alloc(&pool) == NULL);
+    CHECK(pool.free_blocks == 0 && pool.min_free_blocks == 0);
+
+    pool_free(&pool, blocks[2]);
+    pool_free(&pool, blocks[0]);
+    CHECK(pool.free_blocks == 2 && pool.min_free_blocks == 0);
+    CHECK(pool_alloc(&pool) == blocks[0]);
+    CHECK(pool_alloc(&pool) == blocks[2]);
+    CHECK(pool_alloc(&pool) == NULL);
+    pool_free(&pool, NULL);
+    CHECK(pool.free_blocks == 0);
+}
+
+// Tasks, objects and queue storage come from the RTOS's own pools, each
+// refusing what does not fit and reusing what is deleted
+static void test_rtos_pools(void) {
+    task_handle_t tasks[RTOS_STACK_BLOCKS];
+    semaphore_handle_t semaphores[RTOS_OBJECT_BLOCKS];
+    queue_handle_t queues[RTOS_QUEUE_BLOCKS];
+
+    reset();
+    CHECK(create_task(returning_task, "Big", RTOS_STACK_BLOCK_SIZE + 1, 1) == NULL);
+    for (uint32_t i = 0; i < RTOS_STACK_BLOCKS; i++) {
+        tasks[i] = create_task(returning_task, "Task", RTOS_STACK_BLOCK_SIZE, 1);
+        CHECK(tasks[i] != NULL);
+    }
+    CHECK(create_task(returning_task, "Task", 64, 1) == NULL);
+    delete_task(tasks[3]);
+    tasks[3] = create_task(returning_task, "Task", 64, 1);
+    CHECK(tasks[3] != NULL);
+
+    // A queue needs queue_size + 1 slots in one block
+    reset();
+    CHECK(create_queue(72, 14) == NULL);
+    for (uint32_t i = 0; i < RTOS_QUEUE_BLOCKS; i++) {
+        queues[i] = create_queue(72, 13);
+        CHECK(queues[i] != NULL);
+    }
+    CHECK(create_queue(4, 1) == NULL);
+    delete_queue(queues[0]);
+    queues[0] = create_queue(4, 1);
+    CHECK(queues[0] != NULL);
+
+    // Queues share the object pool with mutexes and semaphores
+    for (uint32_t i = 0; i < RTOS_OBJECT_BLOCKS - RTOS_QUEUE_BLOCKS; i++) {
+        semaphores[i] = create_semaphore(0, 1);
+        CHECK(semaphores[i] != NULL);
+    }
+    CHECK(create_semaphore(0, 1) == NULL);
+    CHECK(create_mutex() == NULL);
+    delete_semaphore(semaphores[0]);
+    CHECK(create_mutex() != NULL);
+}
+
+// The high-water mark is the depth of the deepest word written, found
+// from the painted stack
+static void test_stack_high_water(void) {
+    reset();
+    task_control_block_t* task = create_task(returning_task, "Task", 256, 1);
+    CHECK(task_stack_high_water(task) == 0);
+    task->stack[256 - 10] = 0;
+    CHECK(task_stack_high_water(task) == 10);
+    task->stack[256 - 100] = 0xA5A5A5A4;  // one bit off the paint
+    CHECK(task_stack_high_water(task) == 100);
+    task->stack[0] = 0;
+    CHECK(task_stack_high_water(task) == 256);
+
+    // Nothing is running yet, and a deleted task has no stack
+    CHECK(task_stack_high_water(NULL) == 0);
+    delete_task(task);
+    CHECK(task_stack_high_water(task) == 0);
+}
+
+// The benchmark's switches each run its partner task and back; switches
+// take no time on this port, and the idle window is slept through whole
+static void bench_task(void) {
+    rtos_stats_t before;
+    rtos_stats_t after;
+    rtos_bench_result_t result;
+    rtos_get_stats(&before);
+    CHECK(rtos_bench_run(32, 10, &result));
+    rtos_get_stats(&after);
+
+    CHECK(result.switches == 32);
+    CHECK(after.context_switches - before.context_switches >= 2 * 32);
+    CHECK(result.switch_cycles_min <= result.switch_cycles_mean);
+    CHECK(result.switch_cycles_mean <= result.switch_cycles_max);
+    CHECK(result.switch_cycles_max == 0);
+    CHECK(result.window_cycles == 10 * TIMER_TICK_USECS);
+    CHECK(result.sleep_cycles == result.window_cycles);
+    CHECK(result.idle_permille == 1000);
+    finish();
+}
+
+static void test_rtos_bench(void) {
+    reset();
+    create_task(bench_task, "Bench", 256, 2);
+    run();
+}
+
+int main(void) {
+    g_reg_bus.write = model_write;
+    g_reg_bus.read = model_read;
+
+    test_preempt_on_isr_exit();
+    test_irq_before_start();
+    test_tickless_idle();
+    test_idle_sleep_clamp();
+    test_task_return();
+    test_round_robin();
+    test_delta_queue();
+    test_tick_touches_head_only();
+    test_queue_from_isr();
+    test_queue_slots();
+    test_mutex();
+    test_semaphore();
+    test_pool();
+    test_rtos_pools();
+    test_stack_high_water();
+    test_rtos_bench();
+
+    if (failures) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("rtos test passed\n");
+    return 0;
+}
@@ -0,0 +1,123 @@
+// CRC32C kernel benchmark.
+//
+// Checksums buffers of several sizes with every CRC kernel the CPU
+// supports and reports throughput and time per call. The 64-byte case is
+// what the fabric pays per packet at injection and again at ejection.
+//
+// Every supported kernel is first checked against the CRC32C check value
+// and against slice-by-8 over every length up to several PCLMUL strides
+// and a few long odd ones, at every alignment within 16 bytes, and with the
+// input split so a CRC is continued mid-buffer. A mismatch fails the run
+// before anything is timed.
+//
+// Usage: crc_throughput [megabytes_per_point]
+// Exits non-zero if any kernel disagrees with slice-by-8.
+
+#include "crc32c.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include <systemc>
+
+using namespace fabric;
+
+namespace {
+
+// Returns the number of mismatches against slice-by-8
+int verify(CrcKernel kernel) {
+    int mismatches = 0;
+    auto report = [&](const char* what, size_t offset, size_t length, uint32_t got, uint32_t want) {
+        if (got == want) return;
+        if (mismatches++ < 10) {
+            std::cerr << crc_kernel_name(kernel) << ": " << what << " at offset " << offset
+                      << ", length " << length << ": 0x" << std::hex << got << ", expected 0x"
+                      << want << std::dec << std::endl;
+        }
+    };
+
+    const char check[] = "123456789";
+    report("check value", 0, 9, crc32c(kernel, check, 9), 0xE3069283);
+
+    // Every length through several PCLMUL strides, then a few long odd ones
+    std::vector<size_t> lengths;
+    for (size_t length = 0; length <= 64 * 8 + 17; length++) lengths.push_back(length);
+    lengths.insert(lengths.end(), {4095, 4097, 65521});
+    std::vector<uint8_t> data(lengths.back() + 16);
+    uint64_t state = 0x9E3779B97F4A7C15ull;
+    for (uint8_t& byte : data) {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        byte = static_cast<uint8_t>(state >> 56);
+    }
+
+    for (size_t offset = 0; offset < 16; offset++) {
+        const uint8_t* p = data.data() + offset;
+        for (size_t length : lengths) {
+            const uint32_t want = crc32c(CrcKernel::SLICE_BY_8, p, length, 0x5A5A5A5A);
+            report("crc", offset, length, crc32c(kernel, p, length, 0x5A5A5A5A), want);
+
+            // Continuing from an odd split must give the same CRC
+            const size_t split = length / 3 | 1;
+            if (split < length) {
+                uint32_t crc = crc32c(kernel, p, split);
+                crc = crc32c(kernel, p + split, length - split, crc);
+                report("split crc", offset, length, crc, crc32c(CrcKernel::SLICE_BY_8, p, length));
+            }
+        }
+    }
+    return mismatches;
+}
+
+} // namespace
+
+int sc_main(int argc, char* argv[]) {
+    double megabytes = argc > 1 ? std::atof(argv[1]) : 256.0;
+    const size_t sizes[] = {64, 256, 1024, 4096, 65536};
+    const CrcKernel kernels[] = {CrcKernel::SLICE_BY_8, CrcKernel::SSE42, CrcKernel::PCLMUL};
+
+    std::vector<uint8_t> buffer(65536);
+    for (size_t i = 0; i < buffer.size(); i++) {
+        buffer[i] = static_cast<uint8_t>(i * 131 + 7);
+    }
+
+    int mismatches = 0;
+    for (CrcKernel kernel : kernels) {
+        if (crc_kernel_supported(kernel)) mismatches += verify(kernel);
+    }
+    if (mismatches) {
+        std::cerr << mismatches << " CRC mismatch(es)" << std::endl;
+        return 1;
+    }
+
+    std::cout << "kernel,bytes,calls,seconds,gb_per_sec,ns_per_call,crc" << std::endl;
+    for (CrcKernel kernel : kernels) {
+        if (!crc_kernel_supported(kernel)) {
+            std::cerr << crc_kernel_name(kernel) << " is not supported on this CPU" << std::endl;
+            continue;
+        }
+        for (size_t size : sizes) {
+            const uint64_t calls = std::max<uint64_t>(1, megabytes * 1e6 / size);
+
+            // Each call continues the previous CRC, so calls cannot overlap,
+            // and the final CRC is printed, so none can be dropped. Every
+            // kernel reports the same CRC for a size.
+            uint32_t crc = 0;
+            auto start = std::chrono::steady_clock::now();
+            for (uint64_t i = 0; i < calls; i++) {
+                crc = crc32c(kernel, buffer.data(), size, crc);
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            std::cout << crc_kernel_name(kernel) << "," << size << "," << calls << ","
+                      << std::fixed << std::setprecision(4) << seconds << ","
+                      << std::setprecision(2) << calls * size / seconds / 1e9 << ","
+                      << seconds * 1e9 / calls << "," << std::hex << std::setw(8)
+                      << std::setfill('0') << crc << std::dec << std::setfill(' ') << std::endl;
+        }
+    }
+    std::cout << "best: " << crc_kernel_name(crc_best_kernel()) << std::endl;
+    return 0;
+}
@@ -0,0 +1,128 @@
+// Injection throughput benchmark.
+//
+// Fills every injection queue of a concentrated torus through the
+// per-packet inject_packet() path, the descriptor batch API and the
+// preformatted record batch API, and reports packets injected per second
+// of wall time. The fabric is reset between rounds and only injection is
+// timed; the clock never runs.
+//
+// Usage: injection_throughput [rounds] [torus_side] [concentration]
+
+#include "fabric_tlm.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+
+using namespace fabric;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Workload {
+    std::vector<uint64_t> src;
+    std::vector<uint64_t> dst;
+    std::vector<uint8_t> payloads;  // PACKET_SIZE bytes per packet
+};
+
+// One packet per free injection queue slot, in router order
+Workload make_workload(const Fabric& fabric, uint32_t queue_depth) {
+    Workload workload;
+    std::mt19937_64 rng(7);
+    std::uniform_int_distribution<uint64_t> pick(0, fabric.num_routers - 1);
+    for (int src = 0; src < fabric.num_routers; src++) {
+        size_t packets = fabric.graph.terminal_ports[src].size() * queue_depth;
+        for (size_t i = 0; i < packets; i++) {
+            workload.src.push_back(src);
+            workload.dst.push_back(pick(rng));
+        }
+    }
+    workload.payloads.resize(workload.src.size() * PACKET_SIZE);
+    for (size_t i = 0; i < workload.payloads.size(); i++) {
+        workload.payloads[i] = static_cast<uint8_t>(i);
+    }
+    return workload;
+}
+
+template <typename Inject>
+double time_rounds(Fabric& fabric, int rounds, size_t& injected, Inject inject) {
+    double seconds = 0.0;
+    injected = 0;
+    for (int round = 0; round < rounds; round++) {
+        fabric.reset();
+        auto start = Clock::now();
+        injected += inject();
+        seconds += std::chrono::duration<double>(Clock::now() - start).count();
+    }
+    fabric.reset();
+    return seconds;
+}
+
+void report(const char* path, size_t injected, double seconds, double baseline) {
+    std::cout << path << "," << injected << "," << std::fixed << std::setprecision(4) << seconds
+              << "," << std::setprecision(0) << injected / seconds
+              << "," << std::setprecision(2) << baseline / seconds << std::endl;
+}
+
+} // namespace
+
+int sc_main(int argc, char* argv[]) {
+    int rounds = argc > 1 ? std::atoi(argv[1]) : 200;
+    int side = argc > 2 ? std::atoi(argv[2]) : 16;
+    int concentration = argc > 3 ? std::atoi(argv[3]) : 4;
+    if (rounds < 1) rounds = 1;
+    
+    sc_core::sc_signal<bool> clk;
+    sc_core::sc_signal<bool> rst_n;
+    
+    TopologyConfig topology;
+    topology.type = TopologyType::TORUS;
+    topology.dimensions = {side, side};
+    topology.concentration = concentration;
+    Fabric fabric("fabric", topology);
+    fabric.clk(clk);
+    fabric.rst_n(rst_n);
+    
+    const Workload workload = make_workload(fabric, DEFAULT_QUEUE_DEPTH);
+    const size_t count = workload.src.size();
+    
+    std::vector<PacketDescriptor> descriptors(count);
+    std::vector<PacketRecord> records(count);
+    for (size_t i = 0; i < count; i++) {
+        const uint8_t* payload = &workload.payloads[i * PACKET_SIZE];
+        descriptors[i] = {workload.src[i], workload.dst[i], payload, PACKET_SIZE};
+        records[i].src = workload.src[i];
+        records[i].dst = workload.dst[i];
+        std::copy(payload, payload + PACKET_SIZE, records[i].payload);
+    }
+    std::vector<InjectStatus> status(count);
+    
+    std::cout << "path,packets,seconds,packets_per_sec,speedup" << std::endl;
+    
+    // The existing path, as the Python traffic generator drives it: one
+    // payload vector built and one call per packet
+    size_t injected = 0;
+    double baseline = time_rounds(fabric, rounds, injected, [&]() {
+        for (size_t i = 0; i < count; i++) {
+            const uint8_t* payload = &workload.payloads[i * PACKET_SIZE];
+            std::vector<uint8_t> data(payload, payload + PACKET_SIZE);
+            fabric.inject_packet(workload.src[i], workload.dst[i], data);
+        }
+        return count;
+    });
+    report("inject_packet", injected, baseline, baseline);
+    
+    double seconds = time_rounds(fabric, rounds, injected, [&]() {
+        return fabric.inject_packets(descriptors.data(), count, status.data());
+    });
+    report("descriptors", injected, seconds, baseline);
+    
+    seconds = time_rounds(fabric, rounds, injected, [&]() {
+        return fabric.inject_packets(records.data(), count, status.data());
+    });
+    report("records", injected, seconds, baseline);
+    
+    return 0;
+}
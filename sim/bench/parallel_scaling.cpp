@@ -0,0 +1,111 @@
+// Scaling benchmark for the parallel fabric engine.
+//
+// Builds the same torus fabric once per thread count, drives it with an
+// identical uniform-random workload and reports simulated cycles per
+// second of wall time. Every run is checked against the single-threaded
+// run, which must match exactly in conservative mode; the exit status is
+// non-zero if any run differs.
+//
+// Usage: parallel_scaling [max_threads] [cycles] [torus_side]
+
+#include "parallel_engine.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+
+using namespace fabric;
+
+namespace {
+
+struct RunResult {
+    double seconds;
+    uint64_t ejected;
+    uint64_t blocked;
+    uint64_t signature;
+};
+
+RunResult run_once(Fabric& fabric, int threads, uint64_t cycles) {
+    const sc_core::sc_time period(10, sc_core::SC_NS);
+    const uint64_t batch_cycles = 16;
+    const double injection_rate = 0.05;  // packets per router per cycle
+    
+    std::mt19937_64 rng(42);
+    std::uniform_int_distribution<uint64_t> pick(0, fabric.num_routers - 1);
+    std::bernoulli_distribution inject(std::min(1.0, injection_rate * batch_cycles));
+    std::vector<uint8_t> payload(PACKET_SIZE, 0xA5);
+    
+    ParallelEngine engine(fabric, threads, period);
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t done = 0; done < cycles; done += batch_cycles) {
+        for (int src = 0; src < fabric.num_routers; src++) {
+            uint64_t dst = pick(rng);
+            int port = fabric.graph.terminal_ports[src][0];
+            if (inject(rng) && !fabric.routers[src]->input_queues[port].full()) {
+                fabric.inject_packet(src, dst, payload);
+            }
+        }
+        engine.run(batch_cycles);
+    }
+    auto stop = std::chrono::steady_clock::now();
+    
+    RunResult result{std::chrono::duration<double>(stop - start).count(), 0, 0, 0};
+    for (auto& router : fabric.routers) {
+        result.ejected += router->ejected_count;
+        result.blocked += router->blocked_count;
+        result.signature = route_hash(result.signature ^ router->ejected_count ^
+                                      (router->blocked_count << 20));
+    }
+    return result;
+}
+
+} // namespace
+
+int sc_main(int argc, char* argv[]) {
+    int max_threads = argc > 1 ? std::atoi(argv[1]) : static_cast<int>(std::thread::hardware_concurrency());
+    uint64_t cycles = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 20000;
+    int side = argc > 3 ? std::atoi(argv[3]) : 32;
+    if (max_threads < 1) max_threads = 1;
+    
+    sc_core::sc_signal<bool> clk;
+    sc_core::sc_signal<bool> rst_n;
+    
+    // Powers of two up to max_threads, plus max_threads itself
+    std::vector<int> thread_counts;
+    for (int threads = 1; threads < max_threads; threads *= 2) {
+        thread_counts.push_back(threads);
+    }
+    thread_counts.push_back(max_threads);
+    
+    // Every fabric is elaborated up front; SystemC does not allow modules
+    // to come and go once elaboration is over
+    TopologyConfig topology;
+    topology.type = TopologyType::TORUS;
+    topology.dimensions = {side, side};
+    std::vector<std::unique_ptr<Fabric>> fabrics;
+    for (int threads : thread_counts) {
+        std::string name = "fabric_t" + std::to_string(threads);
+        fabrics.push_back(std::make_unique<Fabric>(name.c_str(), topology));
+        fabrics.back()->clk(clk);
+        fabrics.back()->rst_n(rst_n);
+    }
+    
+    std::cout << "threads,seconds,cycles_per_sec,speedup,ejected,identical" << std::endl;
+    RunResult baseline{};
+    bool ok = true;
+    for (size_t i = 0; i < thread_counts.size(); i++) {
+        int threads = thread_counts[i];
+        RunResult result = run_once(*fabrics[i], threads, cycles);
+        if (i == 0) baseline = result;
+        bool identical = result.ejected == baseline.ejected &&
+                         result.blocked == baseline.blocked &&
+                         result.signature == baseline.signature;
+        if (!identical) ok = false;
+        std::cout << threads << "," << std::fixed << std::setprecision(4) << result.seconds
+                  << "," << std::setprecision(0) << cycles / result.seconds
+                  << "," << std::setprecision(2) << baseline.seconds / result.seconds
+                  << "," << result.ejected << "," << (identical ? "yes" : "no") << std::endl;
+    }
+    return ok ? 0 : 1;
+}
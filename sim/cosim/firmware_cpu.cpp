@@ -0,0 +1,222 @@
+#include "firmware_cpu.hpp"
+#include <iostream>
+
+extern "C" {
+#include "firmware.h"
+}
+
+namespace fabric {
+
+namespace {
+FirmwareCpu* cpu = nullptr;
+
+// Room for a task's C frames and SystemC's own
+constexpr size_t TASK_STACK_SIZE = 256 * 1024;
+
+void bus_write(void* context, uint32_t addr, uint32_t value) {
+    static_cast<FirmwareCpu*>(context)->write(addr, value);
+}
+
+uint32_t bus_read(void* context, uint32_t addr) {
+    return static_cast<FirmwareCpu*>(context)->read(addr);
+}
+} // namespace
+
+FirmwareCpu::FirmwareCpu(sc_core::sc_module_name name)
+    : sc_module(name)
+    , bus_socket("bus_socket")
+    , cycle_time(1, sc_core::SC_NS)
+    , running(&boot_context)
+    , masked(true)
+    , register_accesses(0)
+    , interrupts(0)
+    , context_switches(0)
+    , sleep_time(sc_core::SC_ZERO_TIME)
+{
+    if (cpu) {
+        std::cerr << "Only one FirmwareCpu can run the firmware" << std::endl;
+    }
+    cpu = this;
+    g_reg_bus.context = this;
+    g_reg_bus.write = bus_write;
+    g_reg_bus.read = bus_read;
+
+    trans.set_data_length(4);
+    trans.set_streaming_width(4);
+    trans.set_byte_enable_ptr(nullptr);
+    trans.set_dmi_allowed(false);
+
+    boot_context.started = true;
+    quantum_keeper.reset();
+    SC_THREAD(boot);
+}
+
+FirmwareCpu::~FirmwareCpu() {
+    if (cpu == this) cpu = nullptr;
+}
+
+void FirmwareCpu::boot() {
+    rtos_init();
+    firmware_init();
+
+    // Never returns: a task or the idle task takes the CPU
+    rtos_start();
+}
+
+void FirmwareCpu::run_task(Context* context) {
+    masked = false;
+    context->task->entry_point();
+
+    // A task that returns is parked for good
+    suspend_task(context->task);
+}
+
+void FirmwareCpu::start(Context* context) {
+    context->started = true;
+    sc_core::sc_spawn_options options;
+    options.set_stack_size(TASK_STACK_SIZE);
+    std::string name = std::string("task_") + context->task->name;
+    sc_core::sc_spawn(sc_bind(&FirmwareCpu::run_task, this, context),
+                      sc_core::sc_gen_unique_name(name.c_str()), &options);
+}
+
+FirmwareCpu::Context* FirmwareCpu::context_of(task_control_block_t* task) {
+    // create_task overwrites stack_pointer, so a deleted task's context is
+    // never picked up by a new task in the same TCB
+    const uint32_t id = task->stack_pointer;
+    if (id >= 1 && id <= contexts.size() && contexts[id - 1]->task == task) {
+        return contexts[id - 1].get();
+    }
+    contexts.push_back(std::make_unique<Context>());
+    contexts.back()->task = task;
+    task->stack_pointer = static_cast<uint32_t>(contexts.size());
+    return contexts.back().get();
+}
+
+void FirmwareCpu::switch_to(task_control_block_t* task) {
+    Context* next = context_of(task);
+    Context* self = running;
+    if (next == self) return;
+    context_switches++;
+
+    // Hand over at the current local time, then sleep until handed back;
+    // boot and deleted tasks never are
+    quantum_keeper.sync();
+    self->masked = masked;
+    running = next;
+    if (next->started) {
+        next->resume.notify();
+    } else {
+        start(next);
+    }
+    wait(self->resume);
+    quantum_keeper.reset();
+    masked = self->masked;
+}
+
+void FirmwareCpu::wait_for_interrupt() {
+    // A pending interrupt wakes the CPU whether masked or not
+    if (irq.get()) return;
+    quantum_keeper.sync();
+    const sc_core::sc_time start = sc_core::sc_time_stamp();
+    wait(irq.raised_event());
+    sleep_time += sc_core::sc_time_stamp() - start;
+    quantum_keeper.reset();
+}
+
+uint32_t FirmwareCpu::cycle_count() const {
+    return static_cast<uint32_t>(quantum_keeper.get_current_time().value() / cycle_time.value());
+}
+
+void FirmwareCpu::take_interrupt() {
+    interrupts++;
+    masked = true;
+    rtos_isr_enter();
+    handle_irq();
+
+    // May switch away; the rest runs once this context is resumed
+    rtos_isr_exit();
+    masked = false;
+}
+
+void FirmwareCpu::access(tlm::tlm_command command, uint32_t addr, uint32_t& value) {
+    register_accesses++;
+    trans.set_command(command);
+    trans.set_address(addr);
+    trans.set_data_ptr(reinterpret_cast<unsigned char*>(&value));
+    trans.set_response_status(tlm::TLM_INCOMPLETE_RESPONSE);
+
+    sc_core::sc_time delay = quantum_keeper.get_local_time();
+    bus_socket->b_transport(trans, delay);
+    quantum_keeper.set(delay);
+    if (trans.is_response_error()) {
+        std::cerr << sc_core::sc_time_stamp() << ": bus error at 0x" << std::hex << addr << std::dec
+                  << std::endl;
+    }
+    if (quantum_keeper.need_sync()) {
+        quantum_keeper.sync();
+    }
+
+    if (!masked && irq.get()) {
+        take_interrupt();
+    }
+}
+
+void FirmwareCpu::write(uint32_t addr, uint32_t value) {
+    access(tlm::TLM_WRITE_COMMAND, addr, value);
+}
+
+uint32_t FirmwareCpu::read(uint32_t addr) {
+    uint32_t value = 0;
+    access(tlm::TLM_READ_COMMAND, addr, value);
+    return value;
+}
+
+uint32_t FirmwareCpu::save_interrupts() {
+    const uint32_t state = masked;
+    masked = true;
+    return state;
+}
+
+void FirmwareCpu::restore_interrupts(uint32_t state) {
+    masked = state != 0;
+    if (!masked && irq.get()) {
+        take_interrupt();
+    }
+}
+
+} // namespace fabric
+
+// RTOS port functions
+extern "C" {
+
+uint32_t irq_save(void) {
+    return fabric::cpu->save_interrupts();
+}
+
+void irq_restore(uint32_t state) {
+    fabric::cpu->restore_interrupts(state);
+}
+
+void enable_interrupts(void) {
+    fabric::cpu->restore_interrupts(0);
+}
+
+void disable_interrupts(void) {
+    fabric::cpu->save_interrupts();
+}
+
+void port_switch(task_control_block_t* from, task_control_block_t* to) {
+    (void)from;
+    fabric::cpu->switch_to(to);
+}
+
+void wait_for_interrupt(void) {
+    fabric::cpu->wait_for_interrupt();
+}
+
+uint32_t port_cycle_count(void) {
+    return fabric::cpu->cycle_count();
+}
+
+} // extern "C"
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <systemc>
+#include <tlm>
+#include <tlm_utils/simple_initiator_socket.h>
+#include <tlm_utils/tlm_quantumkeeper.h>
+#include <memory>
+#include <vector>
+
+extern "C" {
+#include "rtos.h"
+}
+
+namespace fabric {
+
+// Level-sensitive interrupt request into a FirmwareCpu, driven by a device
+// model. Unlike a signal it changes immediately, so a handler that clears
+// the source is not interrupted again by a stale level.
+class InterruptLine {
+public:
+    void set(bool value) {
+        if (value && !level) raised.notify(sc_core::SC_ZERO_TIME);
+        level = value;
+    }
+    bool get() const { return level; }
+    const sc_core::sc_event& raised_event() const { return raised; }
+
+private:
+    bool level = false;
+    sc_core::sc_event raised;
+};
+
+// Runs the firmware on the host, standing in for the ARM core: it is the
+// register bus and RTOS port of a FIRMWARE_HOST build.
+//
+// Register accesses become b_transport calls on bus_socket. Their delays
+// are kept by a quantum keeper, so firmware runs ahead of the kernel by at
+// most the global quantum. Firmware code itself takes no simulated time.
+// Every RTOS task, the idle task included, and the boot code run in
+// threads of their own, and only the one holding the CPU is ever runnable.
+// port_switch hands the CPU over, which stands in for the register save
+// and restore of a real switch. Interrupts are taken between register
+// accesses and when they are unmasked. The handler runs on the interrupted
+// thread, as it would on the interrupted stack. wait_for_interrupt lets
+// simulated time pass until the interrupt line rises, and the cycle
+// counter counts simulated time in cycle_time steps.
+//
+// The firmware keeps its state in globals, so there can be one CPU.
+class FirmwareCpu : public sc_core::sc_module {
+public:
+    tlm_utils::simple_initiator_socket<FirmwareCpu> bus_socket;
+    InterruptLine irq;
+    sc_core::sc_time cycle_time;
+
+    SC_HAS_PROCESS(FirmwareCpu);
+    // The boot thread calls rtos_init, firmware_init and rtos_start
+    explicit FirmwareCpu(sc_core::sc_module_name name);
+    ~FirmwareCpu() override;
+
+    // Firmware side, reached through g_reg_bus and the port functions
+    void write(uint32_t addr, uint32_t value);
+    uint32_t read(uint32_t addr);
+    uint32_t save_interrupts();
+    void restore_interrupts(uint32_t state);
+    void switch_to(task_control_block_t* task);
+    void wait_for_interrupt();
+    uint32_t cycle_count() const;
+
+    uint64_t get_register_accesses() const { return register_accesses; }
+    uint64_t get_interrupts() const { return interrupts; }
+    uint64_t get_context_switches() const { return context_switches; }
+    const sc_core::sc_time& get_sleep_time() const { return sleep_time; }
+
+private:
+    struct Context {
+        task_control_block_t* task = nullptr;  // null for boot
+        sc_core::sc_event resume;
+        bool masked = false;  // interrupt mask while switched out
+        bool started = false;
+    };
+
+    void boot();
+    void run_task(Context* context);
+    void start(Context* context);
+    void take_interrupt();
+    void access(tlm::tlm_command command, uint32_t addr, uint32_t& value);
+    Context* context_of(task_control_block_t* task);
+
+    tlm_utils::tlm_quantumkeeper quantum_keeper;
+    tlm::tlm_generic_payload trans;
+
+    // Task contexts, numbered from 1 in their TCB's stack_pointer
+    std::vector<std::unique_ptr<Context>> contexts;
+    Context boot_context;
+    Context* running;
+    bool masked;
+
+    uint64_t register_accesses;
+    uint64_t interrupts;
+    uint64_t context_switches;
+    sc_core::sc_time sleep_time;
+};
+
+} // namespace fabric
@@ -0,0 +1,303 @@
+#include "link_controller.hpp"
+#include "crc32c.hpp"
+#include <cstddef>
+#include <cstring>
+
+extern "C" {
+#include "link_dma.h"
+}
+
+namespace fabric {
+
+static_assert(sizeof(packet_t::payload) == PACKET_SIZE, "firmware and fabric payloads differ");
+
+// rx_sent entry of a descriptor holding no packet
+static constexpr uint64_t NOT_FILLED = UINT64_MAX;
+
+LinkController::LinkController(sc_core::sc_module_name name, Fabric& fabric, int node)
+    : sc_module(name)
+    , bus_socket("bus_socket")
+    , irq(nullptr)
+    , destination(0)
+    , access_time(20, sc_core::SC_NS)
+    , training_time(1, sc_core::SC_US)
+    , fabric(fabric)
+    , node(node)
+    , link_status(0)
+    , link_control(0)
+    , error_status(0)
+    , error_mask(0)
+    , irq_status(0)
+    , irq_enable(0)
+    , irq_coalesce(0)
+    , timer_compare(0)
+    , rx_ring(0)
+    , rx_size(0)
+    , rx_head(0)
+    , rx_tail(0)
+    , tx_ring(0)
+    , tx_size(0)
+    , tx_head(0)
+    , tx_tail(0)
+    , coalesce_pending(0)
+{
+    bus_socket.register_b_transport(this, &LinkController::b_transport);
+    fabric.routers[node]->sink = this;
+
+    SC_METHOD(coalesce_timeout);
+    sensitive << coalesce_event;
+    dont_initialize();
+
+    SC_METHOD(link_trained);
+    sensitive << training_event;
+    dont_initialize();
+
+    SC_METHOD(transmit);
+    sensitive << tx_retry_event;
+    dont_initialize();
+
+    SC_METHOD(timer_expired);
+    sensitive << timer_event;
+    dont_initialize();
+}
+
+LinkController::~LinkController() {
+    if (fabric.routers[node]->sink == this) fabric.routers[node]->sink = nullptr;
+}
+
+void LinkController::b_transport(tlm::tlm_generic_payload& trans, sc_core::sc_time& delay) {
+    const uint64_t addr = trans.get_address();
+    if (trans.get_data_length() != 4 || addr < LINK_STATUS_REG || addr > TIMER_COMPARE_REG ||
+        addr % 4 != 0) {
+        trans.set_response_status(tlm::TLM_ADDRESS_ERROR_RESPONSE);
+        return;
+    }
+
+    // Side effects land at the end of the access, ahead of the kernel by
+    // the initiator's local time
+    delay += access_time;
+    access_delay = delay;
+    uint32_t* data = reinterpret_cast<uint32_t*>(trans.get_data_ptr());
+    if (trans.is_write()) {
+        write_register(static_cast<uint32_t>(addr), *data);
+    } else {
+        *data = read_register(static_cast<uint32_t>(addr));
+    }
+    access_delay = sc_core::SC_ZERO_TIME;
+    trans.set_response_status(tlm::TLM_OK_RESPONSE);
+}
+
+void LinkController::write_register(uint32_t addr, uint32_t value) {
+    switch (addr) {
+        case LINK_CONTROL_REG:
+            link_control = value;
+            if (value & LINK_RESET) {
+                link_status &= ~(LINK_UP | LINK_ACTIVE);
+                training_event.cancel();
+            } else if ((value & LINK_ENABLE) && !(link_status & LINK_UP)) {
+                training_event.notify(access_delay + training_time);
+            }
+            break;
+        case ERROR_STATUS_REG:
+            error_status &= ~value;
+            break;
+        case ERROR_MASK_REG:
+            error_mask = value;
+            break;
+        case DMA_RX_RING_REG:
+            rx_ring = (rx_ring & ~0xFFFFFFFFull) | value;
+            break;
+        case DMA_RX_RING_HI_REG:
+            rx_ring = (rx_ring & 0xFFFFFFFFull) | static_cast<uint64_t>(value) << 32;
+            break;
+        case DMA_RX_SIZE_REG:
+            rx_size = value;
+            rx_head = 0;
+            rx_tail = 0;
+            rx_sent.assign(value, NOT_FILLED);
+            coalesce_pending = 0;
+            break;
+        case DMA_RX_TAIL_REG:
+            return_rx(value);
+            break;
+        case DMA_TX_RING_REG:
+            tx_ring = (tx_ring & ~0xFFFFFFFFull) | value;
+            break;
+        case DMA_TX_RING_HI_REG:
+            tx_ring = (tx_ring & 0xFFFFFFFFull) | static_cast<uint64_t>(value) << 32;
+            break;
+        case DMA_TX_SIZE_REG:
+            tx_size = value;
+            tx_head = 0;
+            tx_tail = 0;
+            break;
+        case DMA_TX_TAIL_REG:
+            tx_tail = value;
+            transmit();
+            break;
+        case IRQ_STATUS_REG:
+            irq_status &= ~value;
+            update_irq();
+            break;
+        case IRQ_ENABLE_REG:
+            irq_enable = value;
+            update_irq();
+            break;
+        case IRQ_COALESCE_REG:
+            irq_coalesce = value;
+            break;
+        case TIMER_COMPARE_REG:
+            timer_compare = value;
+            program_timer();
+            break;
+        default:
+            break;
+    }
+}
+
+uint32_t LinkController::read_register(uint32_t addr) {
+    switch (addr) {
+        case LINK_STATUS_REG: return link_status;
+        case LINK_CONTROL_REG: return link_control;
+        case ERROR_STATUS_REG: return error_status;
+        case ERROR_MASK_REG: return error_mask;
+        case DMA_RX_RING_REG: return static_cast<uint32_t>(rx_ring);
+        case DMA_RX_RING_HI_REG: return static_cast<uint32_t>(rx_ring >> 32);
+        case DMA_RX_SIZE_REG: return rx_size;
+        case DMA_RX_HEAD_REG: return rx_head;
+        case DMA_RX_TAIL_REG: return rx_tail;
+        case DMA_TX_RING_REG: return static_cast<uint32_t>(tx_ring);
+        case DMA_TX_RING_HI_REG: return static_cast<uint32_t>(tx_ring >> 32);
+        case DMA_TX_SIZE_REG: return tx_size;
+        case DMA_TX_HEAD_REG: return tx_head;
+        case DMA_TX_TAIL_REG: return tx_tail;
+        case IRQ_STATUS_REG: return irq_status & irq_enable;
+        case IRQ_ENABLE_REG: return irq_enable;
+        case IRQ_COALESCE_REG: return irq_coalesce;
+        case TIMER_COUNT_REG: return timer_count();
+        case TIMER_COMPARE_REG: return timer_compare;
+        default: return 0;
+    }
+}
+
+void LinkController::on_eject(int, const Packet& packet, bool corrupted) {
+    // The controller fills in the firmware's header and CRC; a payload
+    // that arrived corrupted is flagged on its descriptor instead
+    packet_t received;
+    received.header = static_cast<uint32_t>(packet.src_id);
+    std::memcpy(received.payload, packet.payload.data(), PACKET_SIZE);
+    received.crc = crc32c(&received, offsetof(packet_t, crc));
+    receive(&received, corrupted, packet.timestamp);
+}
+
+bool LinkController::receive(const void* packet, bool error, uint64_t sent) {
+    if (!(link_status & LINK_UP) || !rx_ring || rx_head == rx_tail) {
+        error_status |= ERR_OVERFLOW;
+        statistics.rx_dropped++;
+        return false;
+    }
+
+    const uint32_t index = rx_head & (rx_size - 1);
+    dma_descriptor_t* desc = reinterpret_cast<dma_descriptor_t*>(rx_ring) + index;
+    std::memcpy(reinterpret_cast<packet_t*>(desc->buffer), packet, sizeof(packet_t));
+    desc->status = DMA_DESC_DONE | (error ? DMA_DESC_ERROR : 0);
+    rx_sent[index] = sent;
+    rx_head++;
+    statistics.rx_packets++;
+
+    // Coalescing: interrupt once enough packets wait or the first has
+    // waited long enough
+    const uint32_t count = irq_coalesce & 0xFFFF;
+    if (coalesce_pending++ == 0) {
+        coalesce_event.notify(sc_core::sc_time(irq_coalesce >> 16, sc_core::SC_US));
+    }
+    if (coalesce_pending >= count) {
+        coalesce_pending = 0;
+        coalesce_event.cancel();
+        raise(IRQ_LINK_RX);
+    }
+    return true;
+}
+
+void LinkController::return_rx(uint32_t tail) {
+    // Descriptors come back once the firmware is done with their packets,
+    // which is when their latency ends. Empty ones, such as those handed
+    // over when the ring is set up, carry no latency.
+    const uint64_t now = (sc_core::sc_time_stamp() + access_delay).value();
+    for (uint32_t i = rx_tail - rx_size; rx_size && i != tail - rx_size; i++) {
+        uint64_t& sent = rx_sent[i & (rx_size - 1)];
+        if (sent == NOT_FILLED) continue;
+        const uint64_t latency = now - sent;
+        sent = NOT_FILLED;
+        statistics.rx_returned++;
+        statistics.latency_sum += latency;
+        statistics.latency_max = std::max(statistics.latency_max, latency);
+    }
+    rx_tail = tail;
+}
+
+void LinkController::transmit() {
+    const bool loopback = link_control & LINK_LOOPBACK;
+    while (tx_ring && tx_head != tx_tail) {
+        dma_descriptor_t* desc = reinterpret_cast<dma_descriptor_t*>(tx_ring) + (tx_head & (tx_size - 1));
+        const packet_t* packet = reinterpret_cast<const packet_t*>(desc->buffer);
+        if (loopback) {
+            receive(packet, false, (sc_core::sc_time_stamp() + access_delay).value());
+        } else {
+            InjectStatus status = fabric.try_inject(node, destination, packet->payload, PACKET_SIZE);
+            if (status == InjectStatus::QUEUE_FULL || status == InjectStatus::POOL_EXHAUSTED) {
+                // Try again a little later
+                tx_retry_event.notify(access_time);
+                return;
+            }
+        }
+        desc->status = DMA_DESC_DONE;
+        tx_head++;
+        statistics.tx_packets++;
+    }
+}
+
+void LinkController::raise(uint32_t bits) {
+    irq_status |= bits;
+    update_irq();
+}
+
+void LinkController::update_irq() {
+    if (irq) irq->set((irq_status & irq_enable) != 0);
+}
+
+void LinkController::coalesce_timeout() {
+    if (coalesce_pending) {
+        coalesce_pending = 0;
+        raise(IRQ_LINK_RX);
+    }
+}
+
+void LinkController::link_trained() {
+    link_status |= LINK_UP | LINK_ACTIVE;
+}
+
+uint32_t LinkController::timer_count() const {
+    const sc_core::sc_time now = sc_core::sc_time_stamp() + access_delay;
+    return static_cast<uint32_t>(now.value() / sc_core::sc_time(1, sc_core::SC_US).value());
+}
+
+void LinkController::program_timer() {
+    // The compare value is taken to be ahead of the count by at most half
+    // its range, so one already passed fires at once
+    const uint64_t usec = sc_core::sc_time(1, sc_core::SC_US).value();
+    const uint64_t now = (sc_core::sc_time_stamp() + access_delay).value() / usec;
+    const int32_t remaining = static_cast<int32_t>(timer_compare - static_cast<uint32_t>(now));
+    timer_event.cancel();
+    if (remaining <= 0) {
+        raise(IRQ_TIMER);
+    } else {
+        timer_event.notify(sc_core::sc_time::from_value((now + remaining) * usec) - sc_core::sc_time_stamp());
+    }
+}
+
+void LinkController::timer_expired() {
+    raise(IRQ_TIMER);
+}
+
+} // namespace fabric
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "fabric_tlm.hpp"
+#include "firmware_cpu.hpp"
+#include <tlm_utils/simple_target_socket.h>
+
+namespace fabric {
+
+// Firmware-visible latency and throughput, as seen by a LinkController
+struct LinkControllerStatistics {
+    uint64_t rx_packets = 0;     // written into the receive ring
+    uint64_t rx_dropped = 0;     // arrived with the ring full or the link down
+    uint64_t rx_returned = 0;    // handed back by the firmware once handled
+    uint64_t tx_packets = 0;
+    uint64_t latency_sum = 0;    // raw sc_time, injection to hand-back
+    uint64_t latency_max = 0;
+};
+
+// The link hardware the firmware drives, as a memory-mapped TLM target:
+// the link, error, DMA ring, interrupt and timer registers of firmware.h
+// behind bus_socket.
+//
+// It stands at a terminal port of one fabric router. Packets ejected there
+// are written by DMA into the firmware's receive ring. Transmitted packets
+// are injected at that router for destination, or turned straight back
+// into the receive ring in loopback. The receive interrupt is coalesced by
+// count and timeout as IRQ_COALESCE_REG asks. The timer counts simulated
+// microseconds and raises IRQ_TIMER at its compare value. Ring addresses
+// are host pointers, so the firmware must run in this process.
+class LinkController : public sc_core::sc_module, public PacketSink {
+public:
+    tlm_utils::simple_target_socket<LinkController> bus_socket;
+
+    // Driven with the pending, enabled interrupts; set before simulation
+    InterruptLine* irq;
+
+    // Node transmitted packets go to
+    uint64_t destination;
+
+    // Register access time and link training time
+    sc_core::sc_time access_time;
+    sc_core::sc_time training_time;
+
+    SC_HAS_PROCESS(LinkController);
+    LinkController(sc_core::sc_module_name name, Fabric& fabric, int node);
+    ~LinkController() override;
+
+    void b_transport(tlm::tlm_generic_payload& trans, sc_core::sc_time& delay);
+    void on_eject(int port, const Packet& packet, bool corrupted) override;
+
+    const LinkControllerStatistics& get_statistics() const { return statistics; }
+
+private:
+    void write_register(uint32_t addr, uint32_t value);
+    uint32_t read_register(uint32_t addr);
+    bool receive(const void* packet, bool error, uint64_t sent);
+    void return_rx(uint32_t tail);
+    void transmit();
+    void raise(uint32_t bits);
+    void update_irq();
+    void coalesce_timeout();
+    void link_trained();
+    uint32_t timer_count() const;
+    void program_timer();
+    void timer_expired();
+
+    Fabric& fabric;
+    int node;
+
+    uint32_t link_status;
+    uint32_t link_control;
+    uint32_t error_status;
+    uint32_t error_mask;
+    uint32_t irq_status;   // pending, enabled or not
+    uint32_t irq_enable;
+    uint32_t irq_coalesce;
+    uint32_t timer_compare;
+
+    // Ring registers; addresses are assembled from the low and high halves
+    uint64_t rx_ring;
+    uint32_t rx_size;
+    uint32_t rx_head;
+    uint32_t rx_tail;
+    uint64_t tx_ring;
+    uint32_t tx_size;
+    uint32_t tx_head;
+    uint32_t tx_tail;
+
+    // Injection time of the packet in each receive descriptor
+    std::vector<uint64_t> rx_sent;
+
+    // Offset of the register access being served from the kernel's time
+    sc_core::sc_time access_delay;
+
+    uint32_t coalesce_pending;
+    sc_core::sc_event coalesce_event;
+    sc_core::sc_event training_event;
+    sc_core::sc_event tx_retry_event;
+    sc_core::sc_event timer_event;
+
+    LinkControllerStatistics statistics;
+};
+
+} // namespace fabric
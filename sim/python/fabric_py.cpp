@@ -0,0 +1,500 @@
+// Python bindings for the fabric TLM model.
+//
+// A fabric is stepped by a ParallelEngine rather than sc_start(), so Python
+// can advance it a cycle batch at a time and inspect it in between. Long
+// running calls release the GIL. Array arguments are read in place and
+// statistics come back as NumPy views of C++ storage, kept alive by the
+// object that owns it.
+
+#include <pybind11/numpy.h>
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include "traffic.hpp"
+
+namespace py = pybind11;
+using namespace fabric;
+
+namespace {
+
+double tick_ns() {
+    return sc_core::sc_time::from_value(1).to_seconds() * 1e9;
+}
+
+// Fabric-wide counters and statistics copied out of the model in one pass.
+// The arrays are exposed to Python as views of this object's vectors.
+struct StatisticsSnapshot {
+    int routers = 0;
+    int radix = 0;
+    uint64_t injected = 0;
+    uint64_t ejected = 0;
+    uint64_t dropped = 0;
+    uint64_t blocked = 0;
+    uint64_t link_packets = 0;
+    uint64_t link_errors = 0;
+    uint64_t bit_errors = 0;
+    uint64_t crc_errors = 0;
+    uint64_t in_flight = 0;
+
+    std::vector<uint64_t> ports;             // [router][port][in, out, flits_out, stalls]
+    std::vector<uint64_t> latency_counts;    // merged histogram
+    std::vector<double> latency_bucket_ns;   // lowest value of each bucket
+    std::vector<double> pair_latency_ns;     // [dst][src] mean, NaN without packets
+    std::vector<uint64_t> pair_packets;      // [dst][src]
+    std::vector<double> samples;             // [sample][time_ns, injected, ejected, in_flight]
+    size_t num_samples = 0;
+};
+
+// Owns a fabric, the signals its ports bind to and the engine stepping it
+class FabricHandle {
+public:
+    FabricHandle(TopologyType type, const std::vector<int>& dims, int concentration,
+                 RoutingAlgorithm algorithm, int queue_depth, LinkProtocol protocol,
+                 int virtual_channels, int vc_depth, int threads, double clock_ns,
+                 AllocatorType allocator, int allocator_iterations)
+        : threads(std::max(1, threads))
+        , period(clock_ns, sc_core::SC_NS)
+    {
+        TopologyConfig topology;
+        topology.type = type;
+        topology.dimensions = dims;
+        topology.concentration = concentration;
+        if (topology_num_routers(topology) <= 0) {
+            throw std::invalid_argument(std::string("Invalid dimensions for ") +
+                                        topology_name(type) + " topology");
+        }
+
+        ProtocolConfig config;
+        config.protocol = protocol;
+        config.virtual_channels = virtual_channels;
+        config.vc_depth = vc_depth;
+        config.allocator = allocator;
+        config.allocator_iterations = allocator_iterations;
+
+        // Module names must be unique within the simulation
+        static int instances = 0;
+        std::string name = "py_fabric_" + std::to_string(instances++);
+        fabric = std::make_unique<Fabric>(name.c_str(), topology, queue_depth, algorithm, config);
+        if (fabric->num_routers == 0) {
+            throw std::invalid_argument("Fabric could not be built; see stderr");
+        }
+        fabric->clk(clk);
+        fabric->rst_n(rst_n);
+    }
+
+    Fabric& get() { return *fabric; }
+
+    // Timing can change between steps: an attached engine recomputes its
+    // lookahead window on the next step, so cycle and time run on
+    void set_link_timing(double latency_ns, double flit_ns) {
+        if (!(latency_ns >= 0.0) || !(flit_ns >= 0.0)) {
+            throw std::invalid_argument("latency_ns and flit_ns must be non-negative");
+        }
+        fabric->set_link_timing(sc_core::sc_time(latency_ns, sc_core::SC_NS),
+                                sc_core::sc_time(flit_ns, sc_core::SC_NS));
+    }
+
+    int num_routers() const { return fabric->num_routers; }
+    int radix() const { return fabric->graph.radix; }
+
+    uint64_t cycle() const { return engine ? engine->get_cycle() : 0; }
+    double time_ns() const {
+        uint64_t time = engine ? engine->get_time() : sc_core::sc_time_stamp().value();
+        return time * tick_ns();
+    }
+
+    py::array_t<uint8_t> inject(py::array_t<uint64_t, py::array::c_style | py::array::forcecast> src,
+                                py::array_t<uint64_t, py::array::c_style | py::array::forcecast> dst,
+                                py::object payload) {
+        if (src.ndim() != 1 || dst.ndim() != 1 || src.shape(0) != dst.shape(0)) {
+            throw std::invalid_argument("src and dst must be 1-D arrays of the same length");
+        }
+        const size_t count = static_cast<size_t>(src.shape(0));
+
+        // Payload rows are referenced in place, not copied into a staging buffer
+        const uint8_t* data = nullptr;
+        uint32_t row = 0;
+        py::array_t<uint8_t, py::array::c_style | py::array::forcecast> payloads;
+        if (!payload.is_none()) {
+            payloads = py::array_t<uint8_t, py::array::c_style | py::array::forcecast>::ensure(payload);
+            if (!payloads || payloads.ndim() != 2 || static_cast<size_t>(payloads.shape(0)) != count) {
+                throw std::invalid_argument("payload must be a 2-D uint8 array with one row per packet");
+            }
+            data = payloads.data();
+            row = static_cast<uint32_t>(payloads.shape(1));
+        }
+
+        const uint64_t* s = src.data();
+        const uint64_t* d = dst.data();
+        descriptors.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            descriptors[i] = {s[i], d[i], data ? data + i * row : nullptr, data ? row : 0};
+        }
+
+        py::array_t<uint8_t> status(count);
+        auto* out = reinterpret_cast<InjectStatus*>(status.mutable_data());
+        attach_engine();
+        fabric->inject_packets(descriptors.data(), count, out);
+        return status;
+    }
+
+    void step(uint64_t cycles) {
+        attach_engine();
+        engine->run(cycles);
+    }
+
+    void run_until(double target_ns) {
+        double remaining = target_ns - time_ns();
+        if (remaining <= 0) return;
+        step(static_cast<uint64_t>(std::ceil(remaining / (period.value() * tick_ns()))));
+    }
+
+    // Steps until every packet has left the fabric or max_cycles pass
+    bool drain(uint64_t max_cycles) {
+        const uint64_t chunk = 64;
+        for (uint64_t done = 0; done < max_cycles; done += chunk) {
+            if (fabric->packet_pool.get_statistics().in_use == 0) return true;
+            step(std::min(chunk, max_cycles - done));
+        }
+        return fabric->packet_pool.get_statistics().in_use == 0;
+    }
+
+    uint64_t run_traffic(const TrafficConfig& config, uint64_t cycles) {
+        attach_engine();
+        TrafficGenerator generator(*fabric, config);
+        generator.run(*engine, cycles);
+        return generator.get_generated();
+    }
+
+    // Replays the trace's injections from the current time; returns
+    // packets injected
+    uint64_t replay_trace(const std::string& path, uint64_t cycles) {
+        attach_engine();
+        TraceReplay replay(*fabric);
+        if (!replay.open(path)) {
+            throw std::runtime_error("Cannot replay trace " + path + "; see stderr");
+        }
+        replay.run(*engine, cycles);
+        return replay.get_replayed();
+    }
+
+    void reset() {
+        // Packets parked in the engine's mailboxes are reclaimed with the pool
+        engine.reset();
+        fabric->reset();
+    }
+
+    void save_checkpoint(const std::string& path) const {
+        if (!fabric->save_checkpoint(path)) {
+            throw std::runtime_error("Cannot save checkpoint " + path + "; see stderr");
+        }
+    }
+
+    // Flits restored onto links within a region need the engine's regions
+    // to exist already
+    void restore_checkpoint(const std::string& path) {
+        attach_engine();
+        if (!fabric->restore_checkpoint(path)) {
+            throw std::runtime_error("Cannot restore checkpoint " + path + "; see stderr");
+        }
+    }
+
+    std::shared_ptr<StatisticsSnapshot> statistics() const {
+        auto snapshot = std::make_shared<StatisticsSnapshot>();
+        const Fabric& f = *fabric;
+        const int n = f.num_routers;
+        const int radix = f.graph.radix;
+        snapshot->routers = n;
+        snapshot->radix = radix;
+        snapshot->injected = f.injected_count;
+        snapshot->in_flight = f.packet_pool.get_statistics().in_use;
+        for (const auto& router : f.routers) {
+            snapshot->ejected += router->ejected_count;
+            snapshot->dropped += router->dropped_count;
+            snapshot->blocked += router->blocked_count;
+            snapshot->crc_errors += router->crc_errors;
+            for (const auto& link : router->links) {
+                snapshot->link_packets += link->packet_count;
+                snapshot->link_errors += link->error_count;
+                snapshot->bit_errors += link->faults.get_bit_errors();
+            }
+        }
+
+        const Instrumentation* inst = f.instrumentation.get();
+        if (!inst) return snapshot;
+        const double ns = tick_ns();
+
+        snapshot->ports.assign(static_cast<size_t>(n) * radix * 4, 0);
+        for (int r = 0; r < n; r++) {
+            const RouterStatistics& stats = inst->router(r);
+            for (int p = 0; p < radix; p++) {
+                const PortCounters& port = stats.ports[p];
+                uint64_t* out = &snapshot->ports[(static_cast<size_t>(r) * radix + p) * 4];
+                out[0] = port.packets_in;
+                out[1] = port.packets_out;
+                out[2] = port.flits_out;
+                out[3] = port.stalls;
+            }
+        }
+
+        LatencyHistogram latency = inst->latency();
+        snapshot->latency_counts = latency.get_counts();
+        snapshot->latency_bucket_ns.resize(snapshot->latency_counts.size());
+        for (size_t i = 0; i < snapshot->latency_counts.size(); i++) {
+            int bucket = latency.get_first_bucket() + static_cast<int>(i);
+            snapshot->latency_bucket_ns[i] = LatencyHistogram::bucket_lowest(bucket) * ns;
+        }
+
+        snapshot->pair_latency_ns.assign(static_cast<size_t>(n) * n,
+                                         std::numeric_limits<double>::quiet_NaN());
+        snapshot->pair_packets.assign(static_cast<size_t>(n) * n, 0);
+        for (int dst = 0; dst < n; dst++) {
+            const auto& sources = inst->router(dst).latency_by_source;
+            for (size_t src = 0; src < sources.size(); src++) {
+                if (!sources[src] || sources[src]->count() == 0) continue;
+                snapshot->pair_latency_ns[static_cast<size_t>(dst) * n + src] = sources[src]->mean() * ns;
+                snapshot->pair_packets[static_cast<size_t>(dst) * n + src] = sources[src]->count();
+            }
+        }
+
+        const std::vector<StatisticsSample>& samples = inst->get_samples();
+        snapshot->num_samples = samples.size();
+        snapshot->samples.reserve(samples.size() * 4);
+        for (const StatisticsSample& sample : samples) {
+            snapshot->samples.push_back(sample.time * ns);
+            snapshot->samples.push_back(static_cast<double>(sample.injected));
+            snapshot->samples.push_back(static_cast<double>(sample.ejected));
+            snapshot->samples.push_back(static_cast<double>(sample.in_flight));
+        }
+        return snapshot;
+    }
+
+private:
+    // The engine takes the routers over on first use and keeps them until
+    // reset, so cycle and time run on between calls
+    void attach_engine() {
+        if (!engine) engine = std::make_unique<ParallelEngine>(*fabric, threads, period);
+    }
+
+    sc_core::sc_signal<bool> clk;
+    sc_core::sc_signal<bool> rst_n;
+    std::unique_ptr<Fabric> fabric;
+    std::unique_ptr<ParallelEngine> engine;
+    std::vector<PacketDescriptor> descriptors;
+    int threads;
+    sc_core::sc_time period;
+};
+
+// View of a vector owned by the Python object base
+template <typename T>
+py::array_t<T> view(const std::vector<T>& data, std::vector<py::ssize_t> shape, py::handle base) {
+    std::vector<py::ssize_t> strides(shape.size());
+    py::ssize_t stride = sizeof(T);
+    for (size_t i = shape.size(); i-- > 0;) {
+        strides[i] = stride;
+        stride *= shape[i];
+    }
+    return py::array_t<T>(shape, strides, data.data(), base);
+}
+
+} // namespace
+
+PYBIND11_MODULE(fabric_py, m) {
+    m.doc() = "Python bindings for the fabric TLM model";
+
+    py::enum_<TopologyType>(m, "Topology")
+        .value("FULLY_CONNECTED", TopologyType::FULLY_CONNECTED)
+        .value("MESH", TopologyType::MESH)
+        .value("TORUS", TopologyType::TORUS)
+        .value("FLATTENED_BUTTERFLY", TopologyType::FLATTENED_BUTTERFLY)
+        .value("FAT_TREE", TopologyType::FAT_TREE)
+        .value("DRAGONFLY", TopologyType::DRAGONFLY);
+
+    py::enum_<RoutingAlgorithm>(m, "Routing")
+        .value("DIMENSION_ORDER", RoutingAlgorithm::DIMENSION_ORDER)
+        .value("MINIMAL", RoutingAlgorithm::MINIMAL)
+        .value("VALIANT", RoutingAlgorithm::VALIANT)
+        .value("ADAPTIVE", RoutingAlgorithm::ADAPTIVE);
+
+    py::enum_<LinkProtocol>(m, "Protocol")
+        .value("BLOCKING", LinkProtocol::BLOCKING)
+        .value("APPROXIMATELY_TIMED", LinkProtocol::APPROXIMATELY_TIMED);
+
+    py::enum_<AllocatorType>(m, "Allocator")
+        .value("NONE", AllocatorType::NONE)
+        .value("SEPARABLE", AllocatorType::SEPARABLE)
+        .value("ISLIP", AllocatorType::ISLIP)
+        .value("WAVEFRONT", AllocatorType::WAVEFRONT);
+
+    py::enum_<TrafficPattern>(m, "Pattern")
+        .value("UNIFORM_RANDOM", TrafficPattern::UNIFORM_RANDOM)
+        .value("TRANSPOSE", TrafficPattern::TRANSPOSE)
+        .value("BIT_COMPLEMENT", TrafficPattern::BIT_COMPLEMENT)
+        .value("HOTSPOT", TrafficPattern::HOTSPOT)
+        .value("TORNADO", TrafficPattern::TORNADO)
+        .value("NEAREST_NEIGHBOR", TrafficPattern::NEAREST_NEIGHBOR);
+
+    py::enum_<InjectStatus>(m, "InjectStatus")
+        .value("OK", InjectStatus::OK)
+        .value("INVALID_ROUTER", InjectStatus::INVALID_ROUTER)
+        .value("NO_TERMINAL_PORT", InjectStatus::NO_TERMINAL_PORT)
+        .value("POOL_EXHAUSTED", InjectStatus::POOL_EXHAUSTED)
+        .value("QUEUE_FULL", InjectStatus::QUEUE_FULL);
+
+    m.attr("PACKET_SIZE") = PACKET_SIZE;
+
+    py::class_<TrafficConfig>(m, "TrafficConfig")
+        .def(py::init<>())
+        .def_readwrite("pattern", &TrafficConfig::pattern)
+        .def_readwrite("injection_rate", &TrafficConfig::injection_rate)
+        .def_readwrite("seed", &TrafficConfig::seed)
+        .def_readwrite("payload_bytes", &TrafficConfig::payload_bytes)
+        .def_readwrite("hotspots", &TrafficConfig::hotspots)
+        .def_readwrite("hotspot_fraction", &TrafficConfig::hotspot_fraction)
+        .def_readwrite("bursty", &TrafficConfig::bursty)
+        .def_readwrite("burst_rate", &TrafficConfig::burst_rate)
+        .def_readwrite("burst_length", &TrafficConfig::burst_length);
+
+    py::class_<LinkDownWindow>(m, "LinkDownWindow")
+        .def(py::init([](int router, int port, double from_ns, double until_ns) {
+            LinkDownWindow window;
+            window.router = router;
+            window.port = port;
+            window.from = static_cast<uint64_t>(from_ns / tick_ns());
+            window.until = static_cast<uint64_t>(until_ns / tick_ns());
+            return window;
+        }), py::arg("router"), py::arg("port"), py::arg("from_ns"), py::arg("until_ns"))
+        .def_readwrite("router", &LinkDownWindow::router)
+        .def_readwrite("port", &LinkDownWindow::port)
+        .def_property_readonly("from_ns", [](const LinkDownWindow& w) { return w.from * tick_ns(); })
+        .def_property_readonly("until_ns", [](const LinkDownWindow& w) { return w.until * tick_ns(); });
+
+    py::class_<FaultConfig>(m, "FaultConfig")
+        .def(py::init<>())
+        .def_readwrite("seed", &FaultConfig::seed)
+        .def_readwrite("bit_error_rate", &FaultConfig::bit_error_rate)
+        .def_readwrite("burst_rate", &FaultConfig::burst_rate)
+        .def_readwrite("burst_length", &FaultConfig::burst_length)
+        .def_readwrite("stuck_bit", &FaultConfig::stuck_bit)
+        .def_readwrite("stuck_value", &FaultConfig::stuck_value)
+        .def_readwrite("link_down", &FaultConfig::link_down);
+
+    py::class_<StatisticsSnapshot, std::shared_ptr<StatisticsSnapshot>>(m, "Statistics")
+        .def_readonly("routers", &StatisticsSnapshot::routers)
+        .def_readonly("radix", &StatisticsSnapshot::radix)
+        .def_readonly("injected", &StatisticsSnapshot::injected)
+        .def_readonly("ejected", &StatisticsSnapshot::ejected)
+        .def_readonly("dropped", &StatisticsSnapshot::dropped)
+        .def_readonly("blocked", &StatisticsSnapshot::blocked)
+        .def_readonly("link_packets", &StatisticsSnapshot::link_packets)
+        .def_readonly("link_errors", &StatisticsSnapshot::link_errors)
+        .def_readonly("bit_errors", &StatisticsSnapshot::bit_errors)
+        .def_readonly("crc_errors", &StatisticsSnapshot::crc_errors)
+        .def_readonly("in_flight", &StatisticsSnapshot::in_flight)
+        .def_property_readonly("ports", [](py::object self) {
+            auto& s = self.cast<StatisticsSnapshot&>();
+            if (s.ports.empty()) return py::array_t<uint64_t>(std::vector<py::ssize_t>{0, 0, 4});
+            return view(s.ports, {s.routers, s.radix, 4}, self);
+        }, "[router, port, (packets_in, packets_out, flits_out, stalls)]")
+        .def_property_readonly("latency_counts", [](py::object self) {
+            auto& s = self.cast<StatisticsSnapshot&>();
+            return view(s.latency_counts, {static_cast<py::ssize_t>(s.latency_counts.size())}, self);
+        })
+        .def_property_readonly("latency_bucket_ns", [](py::object self) {
+            auto& s = self.cast<StatisticsSnapshot&>();
+            return view(s.latency_bucket_ns, {static_cast<py::ssize_t>(s.latency_bucket_ns.size())}, self);
+        }, "Lowest latency counted by each entry of latency_counts")
+        .def_property_readonly("pair_latency_ns", [](py::object self) {
+            auto& s = self.cast<StatisticsSnapshot&>();
+            py::ssize_t n = s.pair_latency_ns.empty() ? 0 : s.routers;
+            return view(s.pair_latency_ns, {n, n}, self);
+        }, "[dst, src] mean latency, NaN for pairs without packets")
+        .def_property_readonly("pair_packets", [](py::object self) {
+            auto& s = self.cast<StatisticsSnapshot&>();
+            py::ssize_t n = s.pair_packets.empty() ? 0 : s.routers;
+            return view(s.pair_packets, {n, n}, self);
+        })
+        .def_property_readonly("samples", [](py::object self) {
+            auto& s = self.cast<StatisticsSnapshot&>();
+            return view(s.samples, {static_cast<py::ssize_t>(s.num_samples), 4}, self);
+        }, "[sample, (time_ns, injected, ejected, in_flight)]");
+
+    py::class_<FabricHandle>(m, "Fabric")
+        .def(py::init<TopologyType, const std::vector<int>&, int, RoutingAlgorithm, int,
+                      LinkProtocol, int, int, int, double, AllocatorType, int>(),
+             py::arg("topology") = TopologyType::FULLY_CONNECTED,
+             py::arg("dims") = std::vector<int>{16},
+             py::arg("concentration") = 1,
+             py::arg("routing") = RoutingAlgorithm::DIMENSION_ORDER,
+             py::arg("queue_depth") = DEFAULT_QUEUE_DEPTH,
+             py::arg("protocol") = LinkProtocol::BLOCKING,
+             py::arg("virtual_channels") = DEFAULT_VIRTUAL_CHANNELS,
+             py::arg("vc_depth") = DEFAULT_VC_DEPTH,
+             py::arg("threads") = 1,
+             py::arg("clock_ns") = 10.0,
+             py::arg("allocator") = AllocatorType::NONE,
+             py::arg("allocator_iterations") = 1)
+        .def_property_readonly("num_routers", &FabricHandle::num_routers)
+        .def_property_readonly("radix", &FabricHandle::radix)
+        .def_property_readonly("cycle", &FabricHandle::cycle)
+        .def_property_readonly("time_ns", &FabricHandle::time_ns)
+        .def("set_link_timing", &FabricHandle::set_link_timing, py::arg("latency_ns"),
+             py::arg("flit_ns") = 0.0)
+        .def("set_error_rate", [](FabricHandle& self, double rate) {
+            self.get().set_error_rate(rate);
+        }, py::arg("rate"))
+        .def("set_fault_config", [](FabricHandle& self, const FaultConfig& config) {
+            self.get().set_fault_config(config);
+        }, py::arg("config"))
+        .def("enable_instrumentation", [](FabricHandle& self, double sample_interval_ns) {
+            self.get().enable_instrumentation(sc_core::sc_time(sample_interval_ns, sc_core::SC_NS));
+        }, py::arg("sample_interval_ns") = 0.0)
+        .def("inject", &FabricHandle::inject, py::arg("src"), py::arg("dst"),
+             py::arg("payload") = py::none(),
+             "Injects one packet per (src, dst) pair; returns an InjectStatus code per packet")
+        .def("step", &FabricHandle::step, py::arg("cycles") = 1,
+             py::call_guard<py::gil_scoped_release>())
+        .def("run_until", &FabricHandle::run_until, py::arg("time_ns"),
+             py::call_guard<py::gil_scoped_release>())
+        .def("drain", &FabricHandle::drain, py::arg("max_cycles") = 100000,
+             py::call_guard<py::gil_scoped_release>(),
+             "Steps until the fabric is empty; False if max_cycles pass first")
+        .def("run_traffic", &FabricHandle::run_traffic, py::arg("config"), py::arg("cycles"),
+             py::call_guard<py::gil_scoped_release>(),
+             "Drives synthetic traffic for a number of cycles; returns packets generated")
+        .def("replay_trace", &FabricHandle::replay_trace, py::arg("path"), py::arg("cycles"),
+             py::call_guard<py::gil_scoped_release>(),
+             "Injects a trace's packets with their original timing for a number of cycles")
+        .def("enable_trace", [](FabricHandle& self, const std::string& path, bool payloads) {
+            if (!self.get().enable_trace(path, payloads)) {
+                throw std::runtime_error("Cannot open trace " + path + "; see stderr");
+            }
+        }, py::arg("path"), py::arg("payloads") = false)
+        .def("disable_trace", [](FabricHandle& self) {
+            if (!self.get().disable_trace()) throw std::runtime_error("Failed writing trace");
+        })
+        .def("reset", &FabricHandle::reset)
+        .def("save_checkpoint", &FabricHandle::save_checkpoint, py::arg("path"))
+        .def("restore_checkpoint", &FabricHandle::restore_checkpoint, py::arg("path"),
+             "Resets the fabric and loads a checkpoint saved from one with the same configuration")
+        .def("statistics", &FabricHandle::statistics)
+        .def("port_counters", [](py::object self, int router) {
+            FabricHandle& handle = self.cast<FabricHandle&>();
+            Fabric& fabric = handle.get();
+            if (!fabric.instrumentation) throw std::runtime_error("Instrumentation is not enabled");
+            if (router < 0 || router >= fabric.num_routers) throw py::index_error("router out of range");
+            // Live view of the router's counters; valid until instrumentation
+            // is enabled again
+            std::vector<PortCounters>& ports = fabric.instrumentation->router(router).ports;
+            return py::array_t<uint64_t>({static_cast<py::ssize_t>(ports.size()), py::ssize_t(4)},
+                                         {static_cast<py::ssize_t>(sizeof(PortCounters)),
+                                          static_cast<py::ssize_t>(sizeof(uint64_t))},
+                                         &ports[0].packets_in, self);
+        }, py::arg("router"), "Live [port, (packets_in, packets_out, flits_out, stalls)] view");
+}
@@ -7,6 +7,11 @@ from typing import List, Tuple, Dict
 import time
 import logging
 
+try:
+    import fabric_py  # C++ fabric model, built by CMake when pybind11 is available
+except ImportError:
+    fabric_py = None
+
 @dataclass
 class TestConfig:
     num_routers: int
@@ -46,6 +51,13 @@ class FaultInjector:
             pattern.append((src, dst))
         return pattern
     
+    def generate_traffic_arrays(self) -> Tuple[np.ndarray, np.ndarray]:
+        """Vectorized generate_traffic_pattern: source and destination arrays."""
+        n = self.config.num_routers
+        src = np.random.randint(0, n, size=self.config.num_packets, dtype=np.uint64)
+        offset = np.random.randint(1, n, size=self.config.num_packets, dtype=np.uint64)
+        return src, (src + offset) % n
+    
     def inject_faults(self, packet: bytes) -> bytes:
         """Inject random bit errors into the packet."""
         if random.random() < self.config.error_rate:
@@ -63,6 +75,10 @@ class FaultInjector:
     
     def stress_test(self):
         """Run stress test with fault injection."""
+        if fabric_py is not None:
+            self.stress_test_model()
+            return
+        
         self.logger.info("Starting stress test...")
         start_time = time.time()
         
@@ -93,6 +109,38 @@ class FaultInjector:
         
         self._print_statistics()
     
+    def stress_test_model(self):
+        """Run the stress test against the C++ fabric model."""
+        self.logger.info("Starting stress test on the fabric model...")
+        fabric = fabric_py.Fabric(fabric_py.Topology.FULLY_CONNECTED, [self.config.num_routers])
+        fabric.set_error_rate(self.config.error_rate)
+        fabric.enable_instrumentation()
+        
+        # Higher stress leaves fewer cycles between batches
+        cycles_per_batch = max(1, int(self.config.num_packets * (1.0 - self.config.stress_level)))
+        start_time = time.time()
+        while time.time() - start_time < self.config.test_duration:
+            src, dst = self.generate_traffic_arrays()
+            payload = np.random.randint(0, 256, size=(len(src), fabric_py.PACKET_SIZE), dtype=np.uint8)
+            fabric.inject(src, dst, payload)
+            fabric.step(cycles_per_batch)
+            
+            elapsed = time.time() - start_time
+            if elapsed > 0:
+                self.stats['throughput'].append(fabric.statistics().ejected / elapsed)
+        fabric.drain()
+        
+        stats = fabric.statistics()
+        self.stats['total_packets'] = stats.link_packets
+        self.stats['error_packets'] = stats.link_errors
+        
+        # Mean packet latency in seconds from the latency histogram
+        counts = stats.latency_counts
+        if counts.sum() > 0:
+            mean_ns = float((counts * stats.latency_bucket_ns).sum() / counts.sum())
+            self.stats['latency'].append(mean_ns * 1e-9)
+        self._print_statistics()
+    
     def _print_statistics(self):
         """Print test statistics."""
         reliability = (1.0 - self.stats['error_packets'] / self.stats['total_packets']) * 100
@@ -0,0 +1,158 @@
+// Trace record and replay test.
+//
+// A fabric runs synthetic traffic with tracing on, payloads included, and
+// drains. TraceReplay then feeds the recorded trace into a second fabric
+// built the same way, traced as well. The replay must inject the same
+// packets, with the same payloads, from the same routers at the same
+// times, and every router's trace must come out record for record as it
+// was recorded.
+//
+// Usage: trace_replay_test [trace_file_prefix]
+// Exits non-zero on a failed check.
+
+#include "traffic.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+using namespace fabric;
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(cond)                                                                 \
+    do {                                                                            \
+        if (!(cond)) {                                                              \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #cond    \
+                      << std::endl;                                                 \
+            failures++;                                                             \
+        }                                                                           \
+    } while (0)
+
+const sc_core::sc_time PERIOD(10, sc_core::SC_NS);
+constexpr uint64_t RUN_CYCLES = 300;
+constexpr uint64_t DRAIN_CYCLES = 1000;
+
+struct Injection {
+    uint64_t time;
+    uint32_t router;
+    uint64_t dst;
+    std::vector<uint8_t> payload;
+
+    bool operator==(const Injection& other) const {
+        return time == other.time && router == other.router && dst == other.dst &&
+               payload == other.payload;
+    }
+};
+
+// Every injection in the trace, in the order TraceReplay issues them
+std::vector<Injection> injections(const TraceReader& reader) {
+    std::vector<Injection> result;
+    TraceReader::Cursor cursor = reader.cursor();
+    TraceRecord record;
+    while (cursor.next(record)) {
+        if (record.event != TraceEvent::INJECT) continue;
+        std::vector<uint8_t> payload;
+        if (record.payload) payload.assign(record.payload, record.payload + PACKET_SIZE);
+        result.push_back({record.time, record.router, record.dst, std::move(payload)});
+    }
+    CHECK(!cursor.failed());
+    std::stable_sort(result.begin(), result.end(), [](const Injection& a, const Injection& b) {
+        return a.time != b.time ? a.time < b.time : a.router < b.router;
+    });
+    return result;
+}
+
+// Records of one router, every field but the payload pointer
+std::vector<uint64_t> router_records(const TraceReader& reader, int router) {
+    std::vector<uint64_t> values;
+    TraceReader::Cursor cursor = reader.cursor(router);
+    TraceRecord record;
+    while (cursor.next(record)) {
+        values.insert(values.end(), {record.time, record.handle, record.router, record.port,
+                                     static_cast<uint64_t>(record.event), record.dst,
+                                     record.hops});
+    }
+    CHECK(!cursor.failed());
+    return values;
+}
+
+} // namespace
+
+int sc_main(int argc, char* argv[]) {
+    const std::string prefix = argc > 1 ? argv[1] : "trace_replay_test";
+    const std::string recorded_path = prefix + ".recorded.trace";
+    const std::string replayed_path = prefix + ".replayed.trace";
+
+    TopologyConfig topology;
+    topology.type = TopologyType::MESH;
+    topology.dimensions = {4, 4};
+
+    sc_core::sc_signal<bool> clk;
+    sc_core::sc_signal<bool> rst_n;
+    Fabric recorded("recorded", topology);
+    Fabric replayed("replayed", topology);
+    for (Fabric* fabric : {&recorded, &replayed}) {
+        fabric->clk(clk);
+        fabric->rst_n(rst_n);
+    }
+
+    // Injection between runs is stamped with the clock of the engine the
+    // thread last used, so the recording finishes before the replay's
+    // engine is created
+    {
+        ParallelEngine engine(recorded, 1, PERIOD);
+        CHECK(recorded.enable_trace(recorded_path, true));
+        // The hotspot backs up, so some injections are rejected; they are
+        // not traced and must not be replayed
+        TrafficConfig traffic;
+        traffic.pattern = TrafficPattern::HOTSPOT;
+        traffic.hotspot_fraction = 0.5;
+        traffic.injection_rate = 0.5;
+        TrafficGenerator generator(recorded, traffic);
+        generator.run(engine, RUN_CYCLES);
+        engine.run(DRAIN_CYCLES);
+        CHECK(recorded.disable_trace());
+        CHECK(generator.get_rejected() > 0);
+    }
+
+    ParallelEngine engine(replayed, 1, PERIOD);
+    CHECK(replayed.enable_trace(replayed_path, true));
+    TraceReplay replay(replayed);
+    CHECK(replay.open(recorded_path));
+    replay.run(engine, RUN_CYCLES);
+    CHECK(replay.done());
+    engine.run(DRAIN_CYCLES);
+    CHECK(replayed.disable_trace());
+    CHECK(replay.get_rejected() == 0);
+    CHECK(replay.get_replayed() == recorded.injected_count);
+    CHECK(replayed.injected_count == recorded.injected_count);
+
+    TraceReader original;
+    TraceReader repeated;
+    CHECK(original.open(recorded_path));
+    CHECK(repeated.open(replayed_path));
+    CHECK(original.has_payloads() && repeated.has_payloads());
+
+    const std::vector<Injection> sequence = injections(original);
+    CHECK(sequence.size() == recorded.injected_count);
+    CHECK(injections(repeated) == sequence);
+    for (int r = 0; r < recorded.num_routers; r++) {
+        CHECK(router_records(repeated, r) == router_records(original, r));
+    }
+
+    original.close();
+    repeated.close();
+    std::remove(recorded_path.c_str());
+    std::remove(replayed_path.c_str());
+
+    if (failures) {
+        std::cerr << failures << " check(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "trace replay test passed" << std::endl;
+    return 0;
+}
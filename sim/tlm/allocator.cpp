@@ -0,0 +1,241 @@
+#include "allocator.hpp"
+#include <algorithm>
+
+namespace fabric {
+
+namespace {
+// Lowest set bit of mask at or above from, wrapping around to the lowest
+// set bit overall; mask must not be zero
+int round_robin(uint64_t mask, uint32_t from) {
+    const uint64_t after = mask & (~0ull << from);
+    return __builtin_ctzll(after ? after : mask);
+}
+
+// Transposes the size x size bit matrix in rows, size a power of two up to
+// 64: bit j of rows[i] trades places with bit i of rows[j]. Blocks are
+// swapped in log2(size) passes of whole-word operations.
+void transpose(uint64_t* rows, int size) {
+    static constexpr uint64_t masks[] = {
+        0x5555555555555555ull, 0x3333333333333333ull, 0x0F0F0F0F0F0F0F0Full,
+        0x00FF00FF00FF00FFull, 0x0000FFFF0000FFFFull, 0x00000000FFFFFFFFull,
+    };
+    for (int j = size >> 1; j > 0; j >>= 1) {
+        const uint64_t mask = masks[__builtin_ctz(j)];
+        for (int k = 0; k < size; k = ((k | j) + 1) & ~j) {
+            const uint64_t swap = ((rows[k] >> j) ^ rows[k | j]) & mask;
+            rows[k] ^= swap << j;
+            rows[k | j] ^= swap;
+        }
+    }
+}
+} // namespace
+
+const char* allocator_type_name(AllocatorType type) {
+    switch (type) {
+        case AllocatorType::NONE: return "none";
+        case AllocatorType::SEPARABLE: return "separable";
+        case AllocatorType::ISLIP: return "islip";
+        case AllocatorType::WAVEFRONT: return "wavefront";
+    }
+    return "unknown";
+}
+
+SwitchAllocator::SwitchAllocator(AllocatorType type, int ports, int iterations)
+    : type(type)
+    , ports(std::max(1, std::min(ports, 64)))
+    , iterations(std::max(1, iterations))
+    , port_mask(this->ports == 64 ? ~0ull : (1ull << this->ports) - 1)
+    , block(1)
+    , input_pointer(this->ports, 0)
+    , output_pointer(this->ports, 0)
+    , diagonal(0)
+    , offers(this->ports, 0)
+{
+    while (block < this->ports) block <<= 1;
+    columns.assign(block, 0);
+}
+
+void SwitchAllocator::reset() {
+    std::fill(input_pointer.begin(), input_pointer.end(), 0);
+    std::fill(output_pointer.begin(), output_pointer.end(), 0);
+    diagonal = 0;
+}
+
+uint64_t SwitchAllocator::allocate(const uint64_t* requests, uint64_t inputs, uint64_t* grants) {
+    inputs &= port_mask;
+    if (!inputs) return 0;
+    switch (type) {
+        case AllocatorType::SEPARABLE: return separable(requests, inputs, grants);
+        case AllocatorType::ISLIP: return islip(requests, inputs, grants);
+        case AllocatorType::WAVEFRONT: return wavefront(requests, inputs, grants);
+        case AllocatorType::NONE: break;
+    }
+
+    // Without arbitration every input gets its lowest request
+    uint64_t granted = 0;
+    while (inputs) {
+        int i = __builtin_ctzll(inputs);
+        inputs &= inputs - 1;
+        const uint64_t row = requests[i] & port_mask;
+        if (!row) continue;
+        grants[i] = row & (0 - row);
+        granted |= 1ull << i;
+    }
+    return granted;
+}
+
+uint64_t SwitchAllocator::separable(const uint64_t* requests, uint64_t inputs, uint64_t* grants) {
+    // Input stage: every input picks one of its requests
+    uint64_t outputs = 0;
+    while (inputs) {
+        int i = __builtin_ctzll(inputs);
+        inputs &= inputs - 1;
+        const uint64_t row = requests[i] & port_mask;
+        if (!row) continue;
+        int o = round_robin(row, input_pointer[i]);
+        columns[o] |= 1ull << i;
+        outputs |= 1ull << o;
+    }
+
+    // Output stage: every output picks one of the inputs that chose it.
+    // Both arbiters move past a winner only, so a losing input keeps its
+    // choice for the next allocation.
+    uint64_t granted = 0;
+    while (outputs) {
+        int o = __builtin_ctzll(outputs);
+        outputs &= outputs - 1;
+        int i = round_robin(columns[o], output_pointer[o]);
+        columns[o] = 0;
+        grants[i] = 1ull << o;
+        granted |= 1ull << i;
+        input_pointer[i] = next(o);
+        output_pointer[o] = next(i);
+    }
+    return granted;
+}
+
+bool SwitchAllocator::dense(const uint64_t* requests, uint64_t inputs) const {
+    // A transpose costs about as much as moving a couple of bits per row
+    // one at a time
+    int bits = 0;
+    while (inputs) {
+        bits += __builtin_popcountll(requests[__builtin_ctzll(inputs)]);
+        inputs &= inputs - 1;
+    }
+    return bits > 2 * block;
+}
+
+uint64_t SwitchAllocator::islip(const uint64_t* requests, uint64_t inputs, uint64_t* grants) {
+    uint64_t unmatched = inputs;
+    uint64_t free_outputs = port_mask;
+    uint64_t granted = 0;
+    for (int round = 0; round < iterations && unmatched && free_outputs; round++) {
+        // Request: unmatched inputs to free outputs, transposed into columns
+        uint64_t outputs = 0;
+        uint64_t rows = unmatched;
+        if (dense(requests, rows)) {
+            for (int i = 0; i < block; i++) {
+                columns[i] = (rows >> i) & 1 ? requests[i] & free_outputs : 0;
+                outputs |= columns[i];
+            }
+            transpose(columns.data(), block);
+        } else {
+            while (rows) {
+                int i = __builtin_ctzll(rows);
+                rows &= rows - 1;
+                uint64_t row = requests[i] & free_outputs;
+                outputs |= row;
+                while (row) {
+                    int o = __builtin_ctzll(row);
+                    row &= row - 1;
+                    columns[o] |= 1ull << i;
+                }
+            }
+        }
+        if (!outputs) break;
+
+        // Grant: every requested output offers itself to one input
+        uint64_t offered = 0;
+        while (outputs) {
+            int o = __builtin_ctzll(outputs);
+            outputs &= outputs - 1;
+            int i = round_robin(columns[o], output_pointer[o]);
+            columns[o] = 0;
+            offers[i] |= 1ull << o;
+            offered |= 1ull << i;
+        }
+
+        // Accept: every input takes one offer. Pointers only move in the
+        // first round, which is what keeps iSLIP's grants desynchronized.
+        while (offered) {
+            int i = __builtin_ctzll(offered);
+            offered &= offered - 1;
+            int o = round_robin(offers[i], input_pointer[i]);
+            offers[i] = 0;
+            grants[i] = 1ull << o;
+            granted |= 1ull << i;
+            unmatched &= ~(1ull << i);
+            free_outputs &= ~(1ull << o);
+            if (round == 0) {
+                input_pointer[i] = next(o);
+                output_pointer[o] = next(i);
+            }
+        }
+    }
+    return granted;
+}
+
+uint64_t SwitchAllocator::wavefront(const uint64_t* requests, uint64_t inputs, uint64_t* grants) {
+    // Cells (i, (i + k) % ports) form diagonal k. No two cells of a
+    // diagonal share an input or an output, so a whole diagonal is granted
+    // at once: a row of the rotated request matrix per diagonal, in
+    // columns[k], with bit i for input i.
+    uint64_t diagonals = 0;
+    uint64_t rows = inputs;
+    if (dense(requests, rows)) {
+        for (int i = 0; i < block; i++) {
+            columns[i] = (rows >> i) & 1 ? rotate_right(requests[i] & port_mask, i) : 0;
+            diagonals |= columns[i];
+        }
+        transpose(columns.data(), block);
+    } else {
+        while (rows) {
+            int i = __builtin_ctzll(rows);
+            rows &= rows - 1;
+            uint64_t row = rotate_right(requests[i] & port_mask, i);
+            diagonals |= row;
+            while (row) {
+                int k = __builtin_ctzll(row);
+                row &= row - 1;
+                columns[k] |= 1ull << i;
+            }
+        }
+    }
+
+    // Sweep the diagonals from the priority one; a cell is granted when
+    // neither its input nor its output was granted on an earlier diagonal
+    uint64_t free_inputs = inputs;
+    uint64_t free_outputs = port_mask;
+    uint64_t order = rotate_right(diagonals, diagonal);
+    while (order) {
+        int k = __builtin_ctzll(order) + diagonal;
+        if (k >= ports) k -= ports;
+        order &= order - 1;
+        const uint64_t cells = columns[k] & free_inputs & rotate_right(free_outputs, k);
+        columns[k] = 0;
+        if (!cells) continue;
+        free_inputs &= ~cells;
+        free_outputs &= ~rotate_left(cells, k);
+        uint64_t won = cells;
+        while (won) {
+            int i = __builtin_ctzll(won);
+            won &= won - 1;
+            const int o = i + k;
+            grants[i] = 1ull << (o >= ports ? o - ports : o);
+        }
+    }
+    diagonal = next(diagonal);
+    return inputs & ~free_inputs;
+}
+
+} // namespace fabric
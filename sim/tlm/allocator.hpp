@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace fabric {
+
+// Switch allocation: which inputs cross the crossbar on an edge. An input
+// may request any set of outputs; an allocation grants each input at most
+// one output and each output to at most one input.
+enum class AllocatorType {
+    NONE,       // no output arbitration, the routers' original crossbar stage
+    SEPARABLE,  // input-first separable: round-robin at every input, then at every output
+    ISLIP,      // request-grant-accept rounds, pointers moved by first-round accepts only
+    WAVEFRONT   // diagonal wavefront from a priority diagonal that moves every allocation
+};
+
+const char* allocator_type_name(AllocatorType type);
+
+// Allocator for a crossbar of up to 64 ports. Requests are one bit row
+// per input, so a round of arbitration is a mask and a count of trailing
+// zeros per port, and only inputs and outputs with requests are visited.
+// The arbiters' priority state changes only when allocate() is called,
+// which routers do only on edges with requests, so skipped idle edges do
+// not change the result.
+class SwitchAllocator {
+public:
+    explicit SwitchAllocator(AllocatorType type = AllocatorType::NONE, int ports = 64,
+                             int iterations = 1);
+
+    // requests[i] holds the outputs input i wants, for each input i in
+    // inputs; the other rows are not read. Sets grants[i] to the bit of
+    // the output granted to input i and returns the inputs granted one.
+    // Grants of inputs left out of the result are not written.
+    uint64_t allocate(const uint64_t* requests, uint64_t inputs, uint64_t* grants);
+
+    // Back to the initial priorities
+    void reset();
+
+    AllocatorType get_type() const { return type; }
+    int get_ports() const { return ports; }
+    int get_iterations() const { return iterations; }
+
+private:
+    friend class Checkpoint;
+
+    uint64_t separable(const uint64_t* requests, uint64_t inputs, uint64_t* grants);
+    uint64_t islip(const uint64_t* requests, uint64_t inputs, uint64_t* grants);
+    uint64_t wavefront(const uint64_t* requests, uint64_t inputs, uint64_t* grants);
+
+    // Whether the requests have enough bits to transpose them a word at a
+    // time rather than bit by bit
+    bool dense(const uint64_t* requests, uint64_t inputs) const;
+
+    uint8_t next(int port) const { return static_cast<uint8_t>(port + 1 == ports ? 0 : port + 1); }
+
+    // Bit i of the result is bit (i + k) % ports of value
+    uint64_t rotate_right(uint64_t value, int k) const {
+        return k == 0 ? value : ((value >> k) | (value << (ports - k))) & port_mask;
+    }
+
+    uint64_t rotate_left(uint64_t value, int k) const {
+        return k == 0 ? value : ((value << k) | (value >> (ports - k))) & port_mask;
+    }
+
+    AllocatorType type;
+    int ports;
+    int iterations;
+    uint64_t port_mask;
+    int block;  // ports rounded up to a power of two, for transposes
+
+    // Round-robin arbiters: the port each input and output favours next,
+    // and the wavefront's priority diagonal
+    std::vector<uint8_t> input_pointer;
+    std::vector<uint8_t> output_pointer;
+    uint32_t diagonal;
+
+    // Scratch, all zero between calls: requests seen by each output or
+    // the wavefront's request diagonals, block rows, and grants offered to
+    // each input
+    std::vector<uint64_t> columns;
+    std::vector<uint64_t> offers;
+};
+
+} // namespace fabric
@@ -0,0 +1,759 @@
+#include "checkpoint.hpp"
+#include "fabric_tlm.hpp"
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fabric {
+
+namespace {
+constexpr char MAGIC[8] = {'F', 'A', 'B', 'C', 'K', 'P', 'T', '\0'};
+constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+constexpr uint64_t END_MARK = 0x444E45544E494F50;  // "POINTEND"
+constexpr uint32_t HAS_INSTRUMENTATION = 1;
+constexpr uint32_t NO_PACKET = 0xFFFFFFFF;
+
+// On-disk records: fixed-width fields in natural alignment with explicit
+// padding, so a record can be read straight out of the mapped file.
+// Times marked relative are offsets from the time of the save.
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t fingerprint;
+    uint64_t time;  // raw sc_time of the save
+    uint32_t num_routers;
+    uint32_t flags;
+};
+
+struct FabricRecord {
+    uint64_t injected_count;
+    uint64_t fault_seed;
+    double bit_error_rate;
+    double burst_rate;
+    uint32_t burst_length;
+    int32_t stuck_bit;
+    uint32_t stuck_value;
+    uint32_t link_down_windows;
+};
+
+struct WindowRecord {
+    int32_t router;
+    int32_t port;
+    int64_t from;   // relative, saturating; INT64_MAX for never
+    int64_t until;  // relative, saturating; INT64_MAX for never
+};
+
+struct RouterRecord {
+    uint64_t blocked_count;
+    uint64_t ejected_count;
+    uint64_t dropped_count;
+    uint64_t crc_errors;
+    uint64_t input_active;
+    uint64_t output_active;
+    uint64_t flit_active;
+    uint64_t valiant_sequence;
+    int32_t input_pointer;
+    uint32_t injection_port;
+    uint32_t allocator_diagonal;  // switch allocator pointers follow when there is one
+    uint32_t padding;
+};
+
+struct InputVcRecord {
+    int32_t out_port;
+    int32_t out_vc;
+    uint32_t flits;
+    uint32_t padding;
+};
+
+struct FlitRecord {
+    int64_t arrival;  // relative
+    uint32_t packet;
+    uint16_t index;
+    uint16_t padding;
+};
+
+struct InjectionRecord {
+    int32_t vc;
+    uint16_t next_flit;
+    uint8_t vc_pointer;
+    uint8_t padding;
+};
+
+struct LinkRecord {
+    uint64_t error_count;
+    uint64_t packet_count;
+    int64_t busy_until;  // relative
+    uint64_t total_latency;
+    uint64_t fault_position;
+    uint64_t next_error;
+    uint64_t next_burst;
+    uint64_t burst_from;
+    uint64_t burst_until;
+    uint64_t errors;
+    uint64_t bursts;
+    uint64_t bit_errors;
+    uint32_t is_active;
+    uint32_t output_vcs;
+};
+
+struct OutputVcRecord {
+    int64_t head_time;  // relative
+    uint32_t credits;
+    uint32_t owner;
+    uint32_t discard;
+    uint32_t credit_returns;  // relative arrival times follow
+};
+
+struct HistogramRecord {
+    uint64_t total;
+    uint64_t sum;
+    uint64_t min_value;
+    uint64_t max_value;
+    int32_t first_bucket;
+    uint32_t buckets;  // counts follow
+};
+
+struct PacketState {
+    uint64_t src_id;
+    uint64_t dst_id;
+    int64_t timestamp;     // relative
+    int64_t arrival_time;  // relative
+    uint64_t intermediate_id;
+    uint32_t hop_count;
+    uint32_t crc;
+    uint8_t payload[PACKET_SIZE];
+    uint32_t is_control;
+    uint32_t padding;
+};
+
+} // namespace
+
+class Checkpoint::Writer {
+public:
+    Writer(const std::string& path, uint64_t now)
+        : buffer(1 << 20)
+        , now(now)
+    {
+        out.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+        out.open(path, std::ios::binary | std::ios::trunc);
+    }
+
+    bool good() const { return static_cast<bool>(out); }
+
+    template <typename T>
+    void put(const T& value) {
+        out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    template <typename T>
+    void put_array(const T* values, size_t count) {
+        out.write(reinterpret_cast<const char*>(values), sizeof(T) * count);
+    }
+
+    int64_t relative(uint64_t time) const {
+        return static_cast<int64_t>(time - now);
+    }
+
+    // Window bounds may lie arbitrarily far ahead, UINT64_MAX for a link
+    // that stays down for good, so they saturate instead of wrapping
+    int64_t bound(uint64_t time) const {
+        if (time >= now) {
+            return time - now >= static_cast<uint64_t>(INT64_MAX) ? INT64_MAX
+                                                                  : static_cast<int64_t>(time - now);
+        }
+        return now - time > static_cast<uint64_t>(INT64_MAX) ? INT64_MIN
+                                                             : -static_cast<int64_t>(now - time);
+    }
+
+    // Packets are numbered in the order they are first referenced
+    uint32_t packet_id(PacketHandle handle) {
+        if (handle == INVALID_PACKET) return NO_PACKET;
+        auto result = ids.emplace(handle, static_cast<uint32_t>(order.size()));
+        if (result.second) order.push_back(handle);
+        return result.first->second;
+    }
+
+    const std::vector<PacketHandle>& packets() const { return order; }
+
+    void put_histogram(const LatencyHistogram& histogram);
+
+private:
+    std::vector<char> buffer;
+    std::ofstream out;
+    uint64_t now;
+    std::unordered_map<PacketHandle, uint32_t> ids;
+    std::vector<PacketHandle> order;
+};
+
+class Checkpoint::Reader {
+public:
+    Reader(const std::string& path, PacketPool& pool, uint64_t now)
+        : data(nullptr)
+        , size(0)
+        , offset(0)
+        , failed(false)
+        , pool(pool)
+        , now(now)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return;
+        struct stat info;
+        if (::fstat(fd, &info) == 0 && info.st_size > 0) {
+            void* mapped = ::mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped != MAP_FAILED) {
+                data = static_cast<const uint8_t*>(mapped);
+                size = info.st_size;
+                ::madvise(mapped, size, MADV_SEQUENTIAL);
+            }
+        }
+        ::close(fd);
+    }
+
+    ~Reader() {
+        if (data) ::munmap(const_cast<uint8_t*>(data), size);
+    }
+
+    bool is_open() const { return data != nullptr; }
+    bool ok() const { return !failed; }
+
+    template <typename T>
+    bool get(T& value) {
+        return get_array(&value, 1);
+    }
+
+    template <typename T>
+    bool get_array(T* values, size_t count) {
+        if (failed || count > (size - offset) / sizeof(T)) {
+            failed = true;
+            return false;
+        }
+        std::memcpy(values, data + offset, sizeof(T) * count);
+        offset += sizeof(T) * count;
+        return true;
+    }
+
+    // Times that only take part in differences wrap like the originals
+    uint64_t absolute(int64_t relative) const {
+        return now + static_cast<uint64_t>(relative);
+    }
+
+    // Times compared against the clock are clamped at zero, which is
+    // already in the past for the first edge
+    uint64_t due(int64_t relative) const {
+        if (relative < 0 && static_cast<uint64_t>(-relative) > now) return 0;
+        return now + static_cast<uint64_t>(relative);
+    }
+
+    // Window bounds saved by Writer::bound; a saturated one stays never
+    uint64_t bound(int64_t relative) const {
+        if (relative == INT64_MAX) return UINT64_MAX;
+        return due(relative);
+    }
+
+    // Pool handle for a checkpoint packet id, allocated on first reference
+    bool packet_handle(uint32_t id, PacketHandle& handle) {
+        if (id == NO_PACKET) {
+            handle = INVALID_PACKET;
+            return true;
+        }
+        if (id < handles.size()) {
+            handle = handles[id];
+            return true;
+        }
+        if (id != handles.size()) return fail("packet reference out of order");
+        handle = pool.allocate(0, 0);
+        if (handle == INVALID_PACKET) return fail("packet pool exhausted");
+        handles.push_back(handle);
+        return true;
+    }
+
+    const std::vector<PacketHandle>& packets() const { return handles; }
+
+    bool get_histogram(LatencyHistogram& histogram);
+
+    bool fail(const char* reason) {
+        if (!failed) error = reason;
+        failed = true;
+        return false;
+    }
+
+    const char* reason() const { return error ? error : "file is truncated"; }
+
+private:
+    const uint8_t* data;
+    size_t size;
+    size_t offset;
+    bool failed;
+    const char* error = nullptr;
+    PacketPool& pool;
+    uint64_t now;
+    std::vector<PacketHandle> handles;
+};
+
+void Checkpoint::Writer::put_histogram(const LatencyHistogram& histogram) {
+    HistogramRecord record{};
+    record.total = histogram.total;
+    record.sum = histogram.sum;
+    record.min_value = histogram.min_value;
+    record.max_value = histogram.max_value;
+    record.first_bucket = histogram.first_bucket;
+    record.buckets = static_cast<uint32_t>(histogram.counts.size());
+    put(record);
+    put_array(histogram.counts.data(), histogram.counts.size());
+}
+
+bool Checkpoint::Reader::get_histogram(LatencyHistogram& histogram) {
+    HistogramRecord record;
+    if (!get(record)) return false;
+    histogram.total = record.total;
+    histogram.sum = record.sum;
+    histogram.min_value = record.min_value;
+    histogram.max_value = record.max_value;
+    histogram.first_bucket = record.first_bucket;
+    histogram.counts.resize(record.buckets);
+    return get_array(histogram.counts.data(), record.buckets);
+}
+
+uint64_t Checkpoint::fingerprint(const Fabric& fabric) {
+    uint64_t hash = route_hash(VERSION);
+    auto mix = [&hash](uint64_t value) { hash = route_hash(hash ^ value); };
+    const NetworkGraph& graph = fabric.graph;
+    mix(static_cast<uint64_t>(fabric.num_routers));
+    mix(static_cast<uint64_t>(graph.radix));
+    for (int32_t neighbor : graph.neighbors) mix(static_cast<uint32_t>(neighbor));
+    for (int32_t port : graph.neighbor_ports) mix(static_cast<uint32_t>(port));
+    for (const auto& ports : graph.terminal_ports) {
+        mix(ports.size());
+        for (int port : ports) mix(static_cast<uint64_t>(port));
+    }
+    for (const auto& router : fabric.routers) {
+        mix(static_cast<uint64_t>(router->protocol));
+        mix(static_cast<uint64_t>(router->num_vcs));
+        mix(static_cast<uint64_t>(router->allocator.type));
+        mix(static_cast<uint64_t>(router->allocator.iterations));
+        for (int port = 0; port < router->radix; port++) {
+            mix(router->input_queues[port].capacity());
+            mix(router->output_queues[port].capacity());
+        }
+        if (!router->input_vcs.empty()) mix(router->input_vcs[0].flits.capacity());
+    }
+    return hash;
+}
+
+bool Checkpoint::save(const Fabric& fabric, const std::string& path) {
+    const uint64_t now = current_time();
+    Writer writer(path, now);
+    if (!writer.good()) {
+        std::cerr << "Cannot open " << path << " for writing" << std::endl;
+        return false;
+    }
+
+    FileHeader header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.byte_order = BYTE_ORDER_MARK;
+    header.fingerprint = fingerprint(fabric);
+    header.time = now;
+    header.num_routers = static_cast<uint32_t>(fabric.num_routers);
+    header.flags = fabric.instrumentation ? HAS_INSTRUMENTATION : 0;
+    writer.put(header);
+
+    const FaultConfig& faults = fabric.get_fault_config();
+    FabricRecord record{};
+    record.injected_count = fabric.injected_count;
+    record.fault_seed = faults.seed;
+    record.bit_error_rate = faults.bit_error_rate;
+    record.burst_rate = faults.burst_rate;
+    record.burst_length = faults.burst_length;
+    record.stuck_bit = faults.stuck_bit;
+    record.stuck_value = faults.stuck_value;
+    record.link_down_windows = static_cast<uint32_t>(faults.link_down.size());
+    writer.put(record);
+    for (const LinkDownWindow& window : faults.link_down) {
+        writer.put(WindowRecord{window.router, window.port, writer.bound(window.from),
+                                writer.bound(window.until)});
+    }
+
+    auto put_queue = [&writer](const RingBuffer<PacketHandle>& queue) {
+        const uint32_t count = queue.size();
+        writer.put(count);
+        for (uint32_t i = 0; i < count; i++) {
+            writer.put(writer.packet_id(queue.peek(i)));
+        }
+    };
+
+    for (int r = 0; r < fabric.num_routers; r++) {
+        const Router& router = *fabric.routers[r];
+        RouterRecord state{};
+        state.blocked_count = router.blocked_count;
+        state.ejected_count = router.ejected_count;
+        state.dropped_count = router.dropped_count;
+        state.crc_errors = router.crc_errors;
+        state.input_active = router.input_active;
+        state.output_active = router.output_active;
+        state.flit_active = router.flit_active;
+        state.valiant_sequence = router.valiant_sequence;
+        state.input_pointer = router.input_pointer;
+        state.injection_port = fabric.injection_port[r];
+        state.allocator_diagonal = router.allocator.diagonal;
+        writer.put(state);
+        if (router.allocator.type != AllocatorType::NONE) {
+            writer.put_array(router.allocator.input_pointer.data(), router.allocator.ports);
+            writer.put_array(router.allocator.output_pointer.data(), router.allocator.ports);
+        }
+
+        for (int port = 0; port < router.radix; port++) {
+            put_queue(router.input_queues[port]);
+            put_queue(router.output_queues[port]);
+        }
+
+        for (const Router::InputVc& input : router.input_vcs) {
+            const uint32_t count = input.flits.size();
+            writer.put(InputVcRecord{input.out_port, input.out_vc, count, 0});
+            for (uint32_t i = 0; i < count; i++) {
+                const Flit& flit = input.flits.peek(i);
+                writer.put(FlitRecord{writer.relative(flit.arrival), writer.packet_id(flit.handle),
+                                      flit.index, 0});
+            }
+        }
+        for (size_t port = 0; port < router.injections.size(); port++) {
+            const Router::Injection& injection = router.injections[port];
+            writer.put(InjectionRecord{injection.vc, injection.next_flit,
+                                       router.vc_pointer[port], 0});
+        }
+
+        for (const auto& link : router.links) {
+            const FaultEngine& engine = link->faults;
+            LinkRecord link_state{};
+            link_state.error_count = link->error_count;
+            link_state.packet_count = link->packet_count;
+            link_state.busy_until = writer.relative(link->busy_until);
+            link_state.total_latency = link->total_latency;
+            link_state.fault_position = engine.position;
+            link_state.next_error = engine.next_error;
+            link_state.next_burst = engine.next_burst;
+            link_state.burst_from = engine.burst_from;
+            link_state.burst_until = engine.burst_until;
+            link_state.errors = engine.errors;
+            link_state.bursts = engine.bursts;
+            link_state.bit_errors = engine.bit_errors;
+            link_state.is_active = link->is_active;
+            link_state.output_vcs = static_cast<uint32_t>(link->output_vcs.size());
+            writer.put(link_state);
+
+            for (const Link::OutputVc& output : link->output_vcs) {
+                const uint32_t returns = output.credit_returns.size();
+                writer.put(OutputVcRecord{writer.relative(output.head_time), output.credits,
+                                          writer.packet_id(output.owner), output.discard, returns});
+                for (uint32_t i = 0; i < returns; i++) {
+                    writer.put(writer.relative(output.credit_returns.peek(i)));
+                }
+            }
+        }
+    }
+
+    if (const Instrumentation* instrumentation = fabric.instrumentation.get()) {
+        writer.put(instrumentation->sample_interval);
+        writer.put(writer.relative(instrumentation->next_sample));
+        writer.put(static_cast<uint64_t>(instrumentation->samples.size()));
+        writer.put_array(instrumentation->samples.data(), instrumentation->samples.size());
+        for (const auto& stats : instrumentation->routers) {
+            for (const PortCounters& port : stats->ports) {
+                const uint64_t counters[4] = {port.packets_in, port.packets_out, port.flits_out,
+                                              port.stalls};
+                writer.put(counters);
+            }
+            uint32_t sources = 0;
+            for (const auto& histogram : stats->latency_by_source) sources += histogram != nullptr;
+            writer.put(sources);
+            for (size_t src = 0; src < stats->latency_by_source.size(); src++) {
+                if (!stats->latency_by_source[src]) continue;
+                writer.put(static_cast<uint32_t>(src));
+                writer.put_histogram(*stats->latency_by_source[src]);
+            }
+            writer.put(static_cast<uint32_t>(stats->latency_by_hops.size()));
+            for (const LatencyHistogram& histogram : stats->latency_by_hops) {
+                writer.put_histogram(histogram);
+            }
+        }
+    }
+
+    // Packets last, now that every reference has been numbered
+    writer.put(static_cast<uint64_t>(writer.packets().size()));
+    for (PacketHandle handle : writer.packets()) {
+        const Packet& packet = fabric.packet_pool.get(handle);
+        PacketState state{};
+        state.src_id = packet.src_id;
+        state.dst_id = packet.dst_id;
+        state.timestamp = writer.relative(packet.timestamp);
+        state.arrival_time = writer.relative(packet.arrival_time);
+        state.intermediate_id = packet.intermediate_id;
+        state.hop_count = packet.hop_count;
+        state.crc = packet.crc;
+        std::memcpy(state.payload, packet.payload.data(), PACKET_SIZE);
+        state.is_control = packet.is_control;
+        writer.put(state);
+    }
+    writer.put(END_MARK);
+
+    if (!writer.good()) {
+        std::cerr << "Failed writing checkpoint " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool Checkpoint::restore(Fabric& fabric, const std::string& path) {
+    fabric.reset();
+    Reader reader(path, fabric.packet_pool, current_time());
+    if (!reader.is_open()) {
+        std::cerr << "Cannot open checkpoint " << path << std::endl;
+        return false;
+    }
+
+    FileHeader header;
+    if (!reader.get(header) || std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+        std::cerr << path << " is not a fabric checkpoint" << std::endl;
+        return false;
+    }
+    if (header.byte_order != BYTE_ORDER_MARK || header.version != VERSION) {
+        std::cerr << "Checkpoint " << path << " has version " << header.version
+                  << ", expected " << VERSION << std::endl;
+        return false;
+    }
+    if (header.fingerprint != fingerprint(fabric) ||
+        header.num_routers != static_cast<uint32_t>(fabric.num_routers)) {
+        std::cerr << "Checkpoint " << path << " was taken from a differently configured fabric"
+                  << std::endl;
+        return false;
+    }
+
+    bool restored = [&]() {
+        FabricRecord record;
+        if (!reader.get(record)) return false;
+        fabric.injected_count = record.injected_count;
+        FaultConfig faults;
+        faults.seed = record.fault_seed;
+        faults.bit_error_rate = record.bit_error_rate;
+        faults.burst_rate = record.burst_rate;
+        faults.burst_length = record.burst_length;
+        faults.stuck_bit = record.stuck_bit;
+        faults.stuck_value = record.stuck_value != 0;
+        for (uint32_t i = 0; i < record.link_down_windows; i++) {
+            WindowRecord window;
+            if (!reader.get(window)) return false;
+            faults.link_down.push_back({window.router, window.port, reader.bound(window.from),
+                                        reader.bound(window.until)});
+        }
+        fabric.set_fault_config(faults);
+
+        auto get_queue = [&reader](RingBuffer<PacketHandle>& queue) {
+            uint32_t count;
+            if (!reader.get(count)) return false;
+            for (uint32_t i = 0; i < count; i++) {
+                uint32_t id;
+                PacketHandle handle;
+                if (!reader.get(id) || !reader.packet_handle(id, handle)) return false;
+                if (!queue.push(handle)) return reader.fail("queue overflow");
+            }
+            return true;
+        };
+
+        for (int r = 0; r < fabric.num_routers; r++) {
+            Router& router = *fabric.routers[r];
+            RouterRecord state;
+            if (!reader.get(state)) return false;
+            router.blocked_count = state.blocked_count;
+            router.ejected_count = state.ejected_count;
+            router.dropped_count = state.dropped_count;
+            router.crc_errors = state.crc_errors;
+            router.input_active = state.input_active;
+            router.output_active = state.output_active;
+            router.flit_active = state.flit_active;
+            router.valiant_sequence = state.valiant_sequence;
+            router.input_pointer = state.input_pointer;
+            fabric.injection_port[r] = state.injection_port;
+            SwitchAllocator& allocator = router.allocator;
+            allocator.diagonal = state.allocator_diagonal % allocator.ports;
+            if (allocator.type != AllocatorType::NONE &&
+                (!reader.get_array(allocator.input_pointer.data(), allocator.ports) ||
+                 !reader.get_array(allocator.output_pointer.data(), allocator.ports))) {
+                return false;
+            }
+
+            for (int port = 0; port < router.radix; port++) {
+                if (!get_queue(router.input_queues[port]) || !get_queue(router.output_queues[port])) {
+                    return false;
+                }
+            }
+
+            for (size_t index = 0; index < router.input_vcs.size(); index++) {
+                Router::InputVc& input = router.input_vcs[index];
+                InputVcRecord vc;
+                if (!reader.get(vc)) return false;
+                input.out_port = vc.out_port;
+                input.out_vc = vc.out_vc;
+
+                // The sender's AT transaction stays open until the flit
+                // leaves, unless the link crosses parallel engine regions
+                const int port = static_cast<int>(index) / router.num_vcs;
+                Link* sender = router.links[port]->peer;
+                for (uint32_t i = 0; i < vc.flits; i++) {
+                    FlitRecord record;
+                    PacketHandle handle;
+                    if (!reader.get(record) || !reader.packet_handle(record.packet, handle)) {
+                        return false;
+                    }
+                    Flit flit{handle, record.index, reader.due(record.arrival), nullptr};
+                    if (sender && !sender->mailbox) {
+                        constexpr int flit_bytes = LINK_WIDTH / 8;
+                        tlm::tlm_generic_payload* trans = sender->router->payloads.allocate();
+                        trans->acquire();
+                        trans->set_data_ptr(fabric.packet_pool.get(handle).payload.data() +
+                                            flit.index * flit_bytes);
+                        trans->set_data_length(flit_bytes);
+                        trans->set_response_status(tlm::TLM_INCOMPLETE_RESPONSE);
+                        PacketExtension* ext = trans->get_extension<PacketExtension>();
+                        ext->handle = handle;
+                        ext->flit = flit.index;
+                        ext->vc = static_cast<uint8_t>(index % router.num_vcs);
+                        flit.trans = trans;
+                    }
+                    if (!input.flits.push(flit)) return reader.fail("virtual channel overflow");
+                }
+            }
+            for (size_t port = 0; port < router.injections.size(); port++) {
+                InjectionRecord injection;
+                if (!reader.get(injection)) return false;
+                router.injections[port].vc = injection.vc;
+                router.injections[port].next_flit = injection.next_flit;
+                router.vc_pointer[port] = injection.vc_pointer;
+            }
+
+            for (auto& link : router.links) {
+                LinkRecord link_state;
+                if (!reader.get(link_state)) return false;
+                if (link_state.output_vcs != link->output_vcs.size()) {
+                    return reader.fail("virtual channel count mismatch");
+                }
+                link->error_count = link_state.error_count;
+                link->packet_count = link_state.packet_count;
+                link->busy_until = reader.due(link_state.busy_until);
+                link->total_latency = link_state.total_latency;
+                link->is_active = link_state.is_active != 0;
+                FaultEngine& engine = link->faults;
+                engine.position = link_state.fault_position;
+                engine.next_error = link_state.next_error;
+                engine.next_burst = link_state.next_burst;
+                engine.burst_from = link_state.burst_from;
+                engine.burst_until = link_state.burst_until;
+                engine.errors = link_state.errors;
+                engine.bursts = link_state.bursts;
+                engine.bit_errors = link_state.bit_errors;
+
+                for (Link::OutputVc& output : link->output_vcs) {
+                    OutputVcRecord vc;
+                    if (!reader.get(vc) || !reader.packet_handle(vc.owner, output.owner)) {
+                        return false;
+                    }
+                    output.head_time = reader.absolute(vc.head_time);
+                    output.credits = vc.credits;
+                    output.discard = vc.discard != 0;
+                    for (uint32_t i = 0; i < vc.credit_returns; i++) {
+                        int64_t arrival;
+                        if (!reader.get(arrival)) return false;
+                        if (!output.credit_returns.push(reader.due(arrival))) {
+                            return reader.fail("credit overflow");
+                        }
+                    }
+                }
+            }
+        }
+
+        if (header.flags & HAS_INSTRUMENTATION) {
+            uint64_t interval;
+            int64_t next_sample;
+            uint64_t samples;
+            if (!reader.get(interval) || !reader.get(next_sample) || !reader.get(samples)) {
+                return false;
+            }
+            if (!fabric.instrumentation || fabric.instrumentation->sample_interval != interval) {
+                fabric.enable_instrumentation(sc_core::sc_time::from_value(interval));
+            }
+            Instrumentation& instrumentation = *fabric.instrumentation;
+            instrumentation.next_sample = reader.due(next_sample);
+            instrumentation.samples.resize(samples);
+            if (!reader.get_array(instrumentation.samples.data(), samples)) return false;
+
+            for (auto& stats : instrumentation.routers) {
+                for (PortCounters& port : stats->ports) {
+                    uint64_t counters[4];
+                    if (!reader.get(counters)) return false;
+                    port.packets_in = counters[0];
+                    port.packets_out = counters[1];
+                    port.flits_out = counters[2];
+                    port.stalls = counters[3];
+                }
+                uint32_t sources;
+                if (!reader.get(sources)) return false;
+                for (uint32_t i = 0; i < sources; i++) {
+                    uint32_t src;
+                    if (!reader.get(src)) return false;
+                    if (src >= stats->latency_by_source.size()) return reader.fail("bad source");
+                    stats->latency_by_source[src] = std::make_unique<LatencyHistogram>();
+                    if (!reader.get_histogram(*stats->latency_by_source[src])) return false;
+                }
+                uint32_t hops;
+                if (!reader.get(hops)) return false;
+                stats->latency_by_hops.resize(hops);
+                for (LatencyHistogram& histogram : stats->latency_by_hops) {
+                    if (!reader.get_histogram(histogram)) return false;
+                }
+            }
+        }
+
+        uint64_t count;
+        if (!reader.get(count)) return false;
+        if (count != reader.packets().size()) return reader.fail("packet count mismatch");
+        for (PacketHandle handle : reader.packets()) {
+            PacketState state;
+            if (!reader.get(state)) return false;
+            Packet& packet = fabric.packet_pool.get(handle);
+            packet.src_id = state.src_id;
+            packet.dst_id = state.dst_id;
+            packet.timestamp = reader.absolute(state.timestamp);
+            packet.arrival_time = reader.due(state.arrival_time);
+            packet.intermediate_id = state.intermediate_id;
+            packet.hop_count = state.hop_count;
+            packet.crc = state.crc;
+            std::memcpy(packet.payload.data(), state.payload, PACKET_SIZE);
+            packet.is_control = state.is_control != 0;
+        }
+
+        uint64_t end;
+        if (!reader.get(end) || end != END_MARK) return reader.fail("missing end marker");
+        return true;
+    }();
+
+    if (!restored) {
+        std::cerr << "Cannot restore checkpoint " << path << ": " << reader.reason() << std::endl;
+        fabric.reset();
+        return false;
+    }
+
+    // Event-driven routers sleep through a restore like any other reset
+    for (auto& router : fabric.routers) {
+        if (!router->is_idle()) router->wake();
+    }
+    return true;
+}
+
+} // namespace fabric
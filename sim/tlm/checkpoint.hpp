@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace fabric {
+
+class Fabric;
+
+// Binary snapshots of a fabric's dynamic state: live packets, router
+// queues and virtual channels, link credits and counters, fault streams
+// and, when enabled, instrumentation. Topology, routing tables and timing
+// come from elaboration and are not saved, so a checkpoint restores into
+// any fabric built with the same configuration.
+//
+// The file is a fixed header followed by fixed-size little-endian records
+// in one pass over routers and links, then the packet table. Packets are
+// numbered as they are first referenced, so saving and restoring are both
+// single streaming passes, linear in the number of live packets plus the
+// size of the fabric. Restore reads the file through mmap.
+//
+// Times are stored relative to the time of the save and rebased onto the
+// current time on restore, so a checkpoint taken deep into a run can be
+// restored at time zero in a fresh process and continue cycle for cycle
+// as the original would have. Save and restore between sc_start() calls
+// or engine runs, never during one. With a ParallelEngine, create it
+// before restoring.
+class Checkpoint {
+public:
+    static constexpr uint32_t VERSION = 2;
+
+    static bool save(const Fabric& fabric, const std::string& path);
+
+    // Resets the fabric and loads the checkpoint into it. On failure the
+    // fabric is left reset.
+    static bool restore(Fabric& fabric, const std::string& path);
+
+    // Hash of everything a checkpoint relies on matching: router count,
+    // radix, links, terminal ports, protocol and buffer depths
+    static uint64_t fingerprint(const Fabric& fabric);
+
+private:
+    class Reader;
+    class Writer;
+};
+
+} // namespace fabric
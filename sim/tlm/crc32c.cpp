@@ -0,0 +1,193 @@
+#include "crc32c.hpp"
+#include <array>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#include <wmmintrin.h>
+#define FABRIC_CRC_X86 1
+#endif
+
+namespace fabric {
+
+namespace {
+constexpr uint32_t POLYNOMIAL = 0x82F63B78;
+
+using CrcTables = std::array<std::array<uint32_t, 256>, 8>;
+
+// tables[k][b] is the CRC of byte b followed by k zero bytes
+constexpr CrcTables make_tables() {
+    CrcTables tables{};
+    for (uint32_t b = 0; b < 256; b++) {
+        uint32_t crc = b;
+        for (int i = 0; i < 8; i++) {
+            crc = (crc >> 1) ^ (POLYNOMIAL & (0u - (crc & 1)));
+        }
+        tables[0][b] = crc;
+    }
+    for (uint32_t b = 0; b < 256; b++) {
+        for (int k = 1; k < 8; k++) {
+            uint32_t prev = tables[k - 1][b];
+            tables[k][b] = (prev >> 8) ^ tables[0][prev & 0xFF];
+        }
+    }
+    return tables;
+}
+
+constexpr CrcTables TABLES = make_tables();
+
+// Kernels take and return the raw register, without the inversions
+uint32_t crc_slice_by_8(uint32_t crc, const uint8_t* p, size_t n) {
+    while (n >= 8) {
+        uint32_t lo, hi;
+        std::memcpy(&lo, p, 4);
+        std::memcpy(&hi, p + 4, 4);
+        lo ^= crc;
+        crc = TABLES[7][lo & 0xFF] ^ TABLES[6][(lo >> 8) & 0xFF] ^
+              TABLES[5][(lo >> 16) & 0xFF] ^ TABLES[4][lo >> 24] ^
+              TABLES[3][hi & 0xFF] ^ TABLES[2][(hi >> 8) & 0xFF] ^
+              TABLES[1][(hi >> 16) & 0xFF] ^ TABLES[0][hi >> 24];
+        p += 8;
+        n -= 8;
+    }
+    while (n--) {
+        crc = (crc >> 8) ^ TABLES[0][(crc ^ *p++) & 0xFF];
+    }
+    return crc;
+}
+
+#ifdef FABRIC_CRC_X86
+__attribute__((target("sse4.2")))
+uint32_t crc_sse42(uint32_t crc, const uint8_t* p, size_t n) {
+    uint64_t c = crc;
+    while (n >= 8) {
+        uint64_t word;
+        std::memcpy(&word, p, 8);
+        c = _mm_crc32_u64(c, word);
+        p += 8;
+        n -= 8;
+    }
+    uint32_t c32 = static_cast<uint32_t>(c);
+    while (n--) {
+        c32 = _mm_crc32_u8(c32, *p++);
+    }
+    return c32;
+}
+
+// x * k folded onto the next 128 bits of data
+__attribute__((target("pclmul")))
+inline __m128i fold(__m128i x, __m128i k, __m128i data) {
+    __m128i lo = _mm_clmulepi64_si128(x, k, 0x00);
+    __m128i hi = _mm_clmulepi64_si128(x, k, 0x11);
+    return _mm_xor_si128(_mm_xor_si128(lo, hi), data);
+}
+
+// Folds four 128-bit lanes across the buffer with carry-less multiplies,
+// after Gopal et al., "Fast CRC Computation for Generic Polynomials Using
+// PCLMULQDQ". Constants are (x^e mod P << 32)' << 1 for the reflected
+// polynomial, with e = 4*128 +/- 32 for the 64-byte stride and
+// 128 +/- 32 for folding lanes together. The folded 128 bits have the same
+// CRC as the bytes they replace, so they are finished with crc32.
+__attribute__((target("sse4.2,pclmul")))
+uint32_t crc_pclmul(uint32_t crc, const uint8_t* p, size_t n) {
+    if (n < 64) return crc_sse42(crc, p, n);
+
+    auto load = [](const uint8_t* at) {
+        return _mm_loadu_si128(reinterpret_cast<const __m128i*>(at));
+    };
+
+    const __m128i k1k2 = _mm_set_epi64x(0x9E4ADDF8, 0x740EEF02);
+    const __m128i k3k4 = _mm_set_epi64x(0x14CD00BD6, 0xF20C0DFE);
+
+    __m128i x1 = _mm_xor_si128(load(p), _mm_cvtsi32_si128(static_cast<int>(crc)));
+    __m128i x2 = load(p + 16);
+    __m128i x3 = load(p + 32);
+    __m128i x4 = load(p + 48);
+    p += 64;
+    n -= 64;
+
+    while (n >= 64) {
+        x1 = fold(x1, k1k2, load(p));
+        x2 = fold(x2, k1k2, load(p + 16));
+        x3 = fold(x3, k1k2, load(p + 32));
+        x4 = fold(x4, k1k2, load(p + 48));
+        p += 64;
+        n -= 64;
+    }
+
+    x1 = fold(x1, k3k4, x2);
+    x1 = fold(x1, k3k4, x3);
+    x1 = fold(x1, k3k4, x4);
+    while (n >= 16) {
+        x1 = fold(x1, k3k4, load(p));
+        p += 16;
+        n -= 16;
+    }
+
+    uint64_t c = _mm_crc32_u64(0, static_cast<uint64_t>(_mm_cvtsi128_si64(x1)));
+    c = _mm_crc32_u64(c, static_cast<uint64_t>(_mm_extract_epi64(x1, 1)));
+    return crc_sse42(static_cast<uint32_t>(c), p, n);
+}
+#endif
+
+using CrcFunction = uint32_t (*)(uint32_t, const uint8_t*, size_t);
+
+CrcFunction kernel_function(CrcKernel kernel) {
+    switch (kernel) {
+#ifdef FABRIC_CRC_X86
+        case CrcKernel::SSE42: return crc_sse42;
+        case CrcKernel::PCLMUL: return crc_pclmul;
+#endif
+        default: return crc_slice_by_8;
+    }
+}
+
+CrcFunction best_function() {
+    static const CrcFunction function = kernel_function(crc_best_kernel());
+    return function;
+}
+} // namespace
+
+const char* crc_kernel_name(CrcKernel kernel) {
+    switch (kernel) {
+        case CrcKernel::SLICE_BY_8: return "slice-by-8";
+        case CrcKernel::SSE42: return "sse4.2";
+        case CrcKernel::PCLMUL: return "pclmul";
+    }
+    return "unknown";
+}
+
+bool crc_kernel_supported(CrcKernel kernel) {
+    switch (kernel) {
+        case CrcKernel::SLICE_BY_8:
+            return true;
+#ifdef FABRIC_CRC_X86
+        case CrcKernel::SSE42:
+            return __builtin_cpu_supports("sse4.2");
+        case CrcKernel::PCLMUL:
+            return __builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("pclmul");
+#endif
+        default:
+            return false;
+    }
+}
+
+CrcKernel crc_best_kernel() {
+    // Folding only pays off past a few cache lines but falls back to
+    // crc32 below that, so it is never slower
+    for (CrcKernel kernel : {CrcKernel::PCLMUL, CrcKernel::SSE42}) {
+        if (crc_kernel_supported(kernel)) return kernel;
+    }
+    return CrcKernel::SLICE_BY_8;
+}
+
+uint32_t crc32c(const void* data, size_t length, uint32_t crc) {
+    return ~best_function()(~crc, static_cast<const uint8_t*>(data), length);
+}
+
+uint32_t crc32c(CrcKernel kernel, const void* data, size_t length, uint32_t crc) {
+    if (!crc_kernel_supported(kernel)) kernel = CrcKernel::SLICE_BY_8;
+    return ~kernel_function(kernel)(~crc, static_cast<const uint8_t*>(data), length);
+}
+
+} // namespace fabric
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace fabric {
+
+// CRC32C (Castagnoli, reflected polynomial 0x82F63B78) as used by iSCSI,
+// SCTP and ext4. Matches crc32c() in the firmware, so packets stamped on
+// either side verify on the other.
+enum class CrcKernel {
+    SLICE_BY_8,  // portable, eight 1 KiB tables, 8 bytes per step
+    SSE42,       // SSE4.2 crc32 instruction, 8 bytes per step
+    PCLMUL       // carry-less multiply folding of 64-byte blocks, SSE4.2 for the rest
+};
+
+const char* crc_kernel_name(CrcKernel kernel);
+bool crc_kernel_supported(CrcKernel kernel);
+
+// Fastest kernel the CPU supports, picked on first use
+CrcKernel crc_best_kernel();
+
+// CRC of length bytes continuing from the CRC of the data before them;
+// crc32c("123456789", 9) == 0xE3069283
+uint32_t crc32c(const void* data, size_t length, uint32_t crc = 0);
+uint32_t crc32c(CrcKernel kernel, const void* data, size_t length, uint32_t crc = 0);
+
+} // namespace fabric
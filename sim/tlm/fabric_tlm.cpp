@@ -1,33 +1,112 @@
 #include "fabric_tlm.hpp"
 #include <iostream>
 #include <algorithm>
+#include <cstring>
 
 namespace fabric {
 
+namespace {
+bool g_event_driven = false;
+bool g_loosely_timed = false;
+sc_core::sc_time g_cycle_time(10, sc_core::SC_NS);
+uint64_t g_timing_generation = 0;
+thread_local const uint64_t* t_time_source = nullptr;
+
+inline uint64_t now() {
+    return t_time_source ? *t_time_source : sc_core::sc_time_stamp().value();
+}
+} // namespace
+
+void set_event_driven(bool enabled) {
+    g_event_driven = enabled;
+}
+
+bool is_event_driven() {
+    return g_event_driven;
+}
+
+void set_loosely_timed(bool enabled, const sc_core::sc_time& cycle_time) {
+    g_loosely_timed = enabled;
+    g_cycle_time = cycle_time;
+}
+
+bool is_loosely_timed() {
+    return g_loosely_timed;
+}
+
+// PayloadPool implementation
+tlm::tlm_generic_payload* PayloadPool::allocate() {
+    if (free_list.empty()) {
+        payloads.push_back(std::make_unique<tlm::tlm_generic_payload>(this));
+        payloads.back()->set_extension(new PacketExtension);
+        payloads.back()->set_command(tlm::TLM_WRITE_COMMAND);
+        free_list.push_back(payloads.back().get());
+    }
+    tlm::tlm_generic_payload* trans = free_list.back();
+    free_list.pop_back();
+    return trans;
+}
+
+void PayloadPool::free(tlm::tlm_generic_payload* trans) {
+    free_list.push_back(trans);
+}
+
+void set_thread_time_source(const uint64_t* time) {
+    t_time_source = time;
+}
+
+uint64_t current_time() {
+    return now();
+}
+
+uint64_t link_timing_generation() {
+    return g_timing_generation;
+}
+
 // Link implementation
-Link::Link(sc_core::sc_module_name name, double err_rate)
+Link::Link(sc_core::sc_module_name name)
     : sc_module(name)
-    , error_rate(err_rate)
+    , router(nullptr)
+    , port(-1)
+    , peer(nullptr)
+    , mailbox(nullptr)
+    , is_connected(false)
     , is_active(false)
     , error_count(0)
     , packet_count(0)
-    , rng(std::random_device{}())
-    , error_dist(0.0, 1.0)
+    , latency(sc_core::SC_ZERO_TIME)
+    , flit_time(sc_core::SC_ZERO_TIME)
+    , serialization_delay(sc_core::SC_ZERO_TIME)
+    , busy_until(0)
+    , total_latency(0)
 {
     SC_METHOD(reset);
     sensitive << rst_n.neg();
     
-    init_socket.register_b_transport(this, &Link::b_transport);
+    target_socket.register_b_transport(this, &Link::b_transport);
+    target_socket.register_nb_transport_fw(this, &Link::nb_transport_fw);
+    init_socket.register_nb_transport_bw(this, &Link::nb_transport_bw);
 }
 
 void Link::reset() {
-    is_active = false;
+    is_active = is_connected;
     error_count = 0;
     packet_count = 0;
+    busy_until = 0;
+    total_latency = 0;
+    faults.reset();
+    for (OutputVc& vc : output_vcs) {
+        vc.credits = vc.max_credits;
+        vc.credit_returns.clear();
+        vc.owner = INVALID_PACKET;
+        vc.discard = false;
+    }
 }
 
-bool Link::inject_error() {
-    return error_dist(rng) < error_rate;
+bool Link::inject_error(PacketHandle handle) {
+    // Corrupts the payload in place; all hops share the pool's copy
+    if (!faults.enabled()) return false;
+    return faults.apply(router->pool->get(handle).payload.data());
 }
 
 void Link::update_statistics(bool error) {
@@ -35,118 +114,1262 @@ void Link::update_statistics(bool error) {
     if (error) error_count++;
 }
 
+void Link::connect(Link* remote) {
+    // Called on the sending side once the sockets are bound
+    peer = remote;
+    remote->peer = this;
+    is_connected = true;
+    is_active = true;
+    
+    // Blocking links count packet slots in the peer's input queue, AT links
+    // count flit slots in each of its virtual channels
+    Router* remote_router = remote->router;
+    int num_vcs = 1;
+    uint32_t depth = remote_router->input_queues[remote->port].capacity();
+    if (remote_router->protocol == LinkProtocol::APPROXIMATELY_TIMED) {
+        num_vcs = remote_router->num_vcs;
+        depth = remote_router->input_vcs[remote->port * num_vcs].flits.capacity();
+    }
+    output_vcs.clear();
+    output_vcs.resize(num_vcs);
+    for (OutputVc& vc : output_vcs) {
+        vc.max_credits = depth;
+        vc.credits = depth;
+        vc.credit_returns = RingBuffer<uint64_t>(depth);
+    }
+}
+
+void Link::set_timing(const sc_core::sc_time& latency, const sc_core::sc_time& flit_time) {
+    this->latency = latency;
+    this->flit_time = flit_time;
+    serialization_delay = flit_time * FLITS_PER_PACKET;
+    g_timing_generation++;
+}
+
+sc_core::sc_time Link::reserve(uint64_t now) {
+    // The link is free again once the last flit is on the wire
+    busy_until = now + serialization_delay.value();
+    total_latency += (serialization_delay + latency).value();
+    return serialization_delay + latency;
+}
+
+sc_core::sc_time Link::reserve_flit(uint64_t now, const Flit& flit, int vc) {
+    // Packet latency on the link runs from its head flit leaving to its
+    // tail flit arriving
+    busy_until = now + flit_time.value();
+    OutputVc& output = output_vcs[vc];
+    if (flit.is_head()) output.head_time = now;
+    if (flit.is_tail()) total_latency += now - output.head_time + (flit_time + latency).value();
+    return flit_time + latency;
+}
+
+void Link::return_credit(int vc, tlm::tlm_generic_payload* trans) {
+    if (!peer) return;
+    if (trans) {
+        // AT: the response phase of the flit's transaction is the credit
+        tlm::tlm_phase phase = tlm::BEGIN_RESP;
+        sc_core::sc_time delay = latency;
+        trans->set_response_status(tlm::TLM_OK_RESPONSE);
+        target_socket->nb_transport_bw(*trans, phase, delay);
+        return;
+    }
+    uint64_t arrival = now() + latency.value();
+    if (mailbox) {
+        mailbox->push({peer, INVALID_PACKET, arrival, 0, static_cast<uint8_t>(vc)});
+    } else {
+        peer->add_credit(arrival, vc);
+    }
+}
+
+void Link::add_credit(uint64_t arrival, int vc) {
+    OutputVc& output = output_vcs[vc];
+    if (output.credits + output.credit_returns.size() < output.max_credits) {
+        output.credit_returns.push(arrival);
+    }
+}
+
+bool Link::has_credit(int vc) {
+    // Credits come back in order, so the oldest arrival is at the front
+    OutputVc& output = output_vcs[vc];
+    const uint64_t current = now();
+    while (!output.credit_returns.empty() && output.credit_returns.front() < current) {
+        output.credit_returns.pop();
+        output.credits++;
+    }
+    return output.credits > 0;
+}
+
+int Link::free_vc() {
+    for (size_t vc = 0; vc < output_vcs.size(); vc++) {
+        if (output_vcs[vc].owner == INVALID_PACKET) return static_cast<int>(vc);
+    }
+    return -1;
+}
+
+void Link::b_transport(tlm::tlm_generic_payload& trans, sc_core::sc_time& delay) {
+    PacketExtension* ext = nullptr;
+    trans.get_extension(ext);
+    if (!ext || ext->handle == INVALID_PACKET || !router) {
+        trans.set_response_status(tlm::TLM_GENERIC_ERROR_RESPONSE);
+        return;
+    }
+    
+    // The annotated delay covers serialization and flight time; the packet
+    // is usable on the first edge after it has fully arrived
+    if (!deliver(ext->handle, now() + delay.value())) {
+        trans.set_response_status(tlm::TLM_GENERIC_ERROR_RESPONSE);
+        return;
+    }
+    trans.set_response_status(tlm::TLM_OK_RESPONSE);
+}
+
+bool Link::deliver(PacketHandle handle, uint64_t arrival) {
+    // The sender holds a credit for this slot, so a full queue here means
+    // the flow control state is out of sync
+    if (!router->receive_packet(port, handle, arrival)) {
+        return false;
+    }
+    update_statistics(inject_error(handle));
+    return true;
+}
+
+bool Link::deliver_flit(const Flit& flit, int vc) {
+    if (vc >= router->num_vcs || !router->receive_flit(port, vc, flit)) {
+        return false;
+    }
+    if (flit.is_tail()) update_statistics(inject_error(flit.handle));
+    return true;
+}
+
+tlm::tlm_sync_enum Link::nb_transport_fw(tlm::tlm_generic_payload& trans, tlm::tlm_phase& phase,
+                                         sc_core::sc_time& delay) {
+    if (phase == tlm::END_RESP) {
+        return tlm::TLM_COMPLETED;
+    }
+    
+    PacketExtension* ext = nullptr;
+    trans.get_extension(ext);
+    if (phase != tlm::BEGIN_REQ || !ext || ext->handle == INVALID_PACKET || !router) {
+        trans.set_response_status(tlm::TLM_GENERIC_ERROR_RESPONSE);
+        return tlm::TLM_COMPLETED;
+    }
+    
+    // Accept the flit into its VC right away; the response phase follows
+    // once it has left the buffer
+    Flit flit{ext->handle, ext->flit, now() + delay.value(), &trans};
+    if (!deliver_flit(flit, ext->vc)) {
+        trans.set_response_status(tlm::TLM_GENERIC_ERROR_RESPONSE);
+        return tlm::TLM_COMPLETED;
+    }
+    phase = tlm::END_REQ;
+    return tlm::TLM_UPDATED;
+}
+
+tlm::tlm_sync_enum Link::nb_transport_bw(tlm::tlm_generic_payload& trans, tlm::tlm_phase& phase,
+                                         sc_core::sc_time& delay) {
+    if (phase != tlm::BEGIN_RESP) {
+        return tlm::TLM_ACCEPTED;
+    }
+    PacketExtension* ext = nullptr;
+    trans.get_extension(ext);
+    if (ext) add_credit(now() + delay.value(), ext->vc);
+    trans.release();
+    return tlm::TLM_COMPLETED;
+}
+
 // Router implementation
-Router::Router(sc_core::sc_module_name name, int radix)
+Router::Router(sc_core::sc_module_name name, int radix, PacketPool* pool, int queue_depth,
+               const ProtocolConfig& config)
     : sc_module(name)
     , radix(radix)
+    , router_id(-1)
+    , routing_table(nullptr)
+    , pool(pool)
+    , blocked_count(0)
+    , ejected_count(0)
+    , dropped_count(0)
+    , crc_errors(0)
+    , protocol(config.protocol)
+    , num_vcs(1)
+    , input_active(0)
+    , output_active(0)
+    , flit_active(0)
+    , release_sink(nullptr)
+    , stats(nullptr)
+    , trace(nullptr)
+    , sink(nullptr)
+    , valiant_sequence(0)
+    , input_pointer(0)
+    , allocator(config.allocator, radix, config.allocator_iterations)
+    , event_driven(is_event_driven())
+    , detached(false)
+    , asleep(true)
+    , waiting_for_clock(false)
+    , loosely_timed(is_loosely_timed())
+    , cycle_time(g_cycle_time)
+    , local_time(0)
 {
+    if (!this->pool) {
+        own_pool = std::make_unique<PacketPool>();
+        this->pool = own_pool.get();
+    }
+    
     SC_METHOD(reset);
     sensitive << rst_n.neg();
     
-    SC_METHOD(routing_logic);
-    sensitive << clk.pos();
-    
-    SC_METHOD(switch_fabric);
-    sensitive << clk.pos();
+    if (loosely_timed) {
+        SC_THREAD(run_loosely_timed);
+    } else {
+        SC_METHOD(evaluate);
+        if (event_driven) {
+            sensitive << wake_event;
+            dont_initialize();
+        } else {
+            sensitive << clk.pos();
+        }
+    }
     
     // Initialize queues
-    input_queues.resize(radix);
-    output_queues.resize(radix);
+    input_queues.reserve(radix);
+    output_queues.reserve(radix);
+    for (int i = 0; i < radix; i++) {
+        input_queues.emplace_back(queue_depth);
+        output_queues.emplace_back(queue_depth);
+    }
+    
+    // Virtual channels only exist under the AT protocol
+    if (protocol == LinkProtocol::APPROXIMATELY_TIMED) {
+        num_vcs = std::max(1, std::min(config.virtual_channels, MAX_VIRTUAL_CHANNELS));
+        uint32_t vc_depth = static_cast<uint32_t>(std::max(1, config.vc_depth));
+        input_vcs.resize(static_cast<size_t>(radix) * num_vcs);
+        for (InputVc& input : input_vcs) {
+            input.flits = RingBuffer<Flit>(vc_depth);
+        }
+        injections.resize(radix);
+        vc_pointer.resize(radix, 0);
+    }
+    
+    if (config.allocator != AllocatorType::NONE) {
+        requests.resize(radix, 0);
+        grants.resize(radix, 0);
+        if (protocol == LinkProtocol::APPROXIMATELY_TIMED) {
+            request_vcs.resize(static_cast<size_t>(radix) * num_vcs, 0);
+        }
+    }
     
     // Create links
     for (int i = 0; i < radix; i++) {
         links.push_back(std::make_unique<Link>(("link_" + std::to_string(i)).c_str()));
+        links.back()->router = this;
+        links.back()->port = i;
+        links.back()->clk(clk);
+        links.back()->rst_n(rst_n);
     }
 }
 
 void Router::reset() {
+    // Queued packets go back to the pool
+    PacketHandle handle;
     for (auto& queue : input_queues) {
-        while (!queue.empty()) queue.pop();
+        while (queue.pop(handle)) release_packet(handle);
     }
     for (auto& queue : output_queues) {
-        while (!queue.empty()) queue.pop();
+        while (queue.pop(handle)) release_packet(handle);
+    }
+    
+    // A packet is released where its tail flit sits; transactions still
+    // holding a credit go back to the sender's payload pool
+    Flit flit;
+    for (InputVc& input : input_vcs) {
+        while (input.flits.pop(flit)) {
+            if (flit.trans) flit.trans->release();
+            if (flit.is_tail()) release_packet(flit.handle);
+        }
+        input.out_port = -1;
+        input.out_vc = -1;
     }
+    std::fill(injections.begin(), injections.end(), Injection());
+    allocator.reset();
+    
+    input_active = 0;
+    output_active = 0;
+    flit_active = 0;
+    blocked_count = 0;
+    ejected_count = 0;
+    dropped_count = 0;
+    crc_errors = 0;
 }
 
-void Router::route_packet(Packet& packet) {
-    // Simple dimension-order routing
-    uint64_t current = packet.src_id;
+void Router::set_queue_depth(int port, uint32_t input_depth, uint32_t output_depth) {
+    // Only valid during elaboration, before links are connected
+    input_queues[port] = RingBuffer<PacketHandle>(input_depth);
+    output_queues[port] = RingBuffer<PacketHandle>(output_depth);
+}
+
+void Router::set_routing_table(const RoutingTable* table) {
+    routing_table = table;
+    router_id = table ? table->router_id : -1;
+}
+
+int Router::select_port(Packet& packet) {
+    const RoutingTable& table = *routing_table;
     uint64_t target = packet.dst_id;
     
-    // Calculate next hop
-    int next_port = (target > current) ? 1 : 0;
-    output_queues[next_port].push(packet);
+    switch (table.algorithm) {
+        case RoutingAlgorithm::DIMENSION_ORDER:
+            return table.dimension_order_port(target);
+        
+        case RoutingAlgorithm::VALIANT: {
+            // Pick the waypoint at the source, then head for the real
+            // destination once it has been reached
+            uint64_t num_routers = table.dor_ports.size();
+            if (packet.hop_count == 0 && packet.intermediate_id == packet.dst_id) {
+                packet.intermediate_id = route_hash(
+                    (static_cast<uint64_t>(router_id) << 32) ^ valiant_sequence++) % num_routers;
+            }
+            if (packet.intermediate_id == static_cast<uint64_t>(router_id)) {
+                packet.intermediate_id = packet.dst_id;
+            }
+            target = packet.intermediate_id;
+        }
+        // fall through
+        case RoutingAlgorithm::MINIMAL: {
+            // Hash the flow so its packets stay in order while different
+            // flows spread across the minimal ports
+            uint32_t count = table.minimal_count(target);
+            if (count == 0) return NO_ROUTE;
+            uint64_t flow = (packet.src_id << 32) ^ packet.dst_id ^
+                            (static_cast<uint64_t>(router_id) << 48);
+            return table.minimal_begin(target)[route_hash(flow) % count];
+        }
+        
+        case RoutingAlgorithm::ADAPTIVE: {
+            uint32_t count = table.minimal_count(target);
+            if (count == 0) return NO_ROUTE;
+            const uint8_t* ports = table.minimal_begin(target);
+            
+            // Emptiest output queue wins; ties go to the first port after a
+            // per-flow offset so equal queues do not all favour one port
+            uint32_t start = static_cast<uint32_t>(
+                route_hash((packet.src_id << 32) ^ packet.dst_id) % count);
+            int best_port = ports[start];
+            uint32_t best_size = port_load(best_port);
+            for (uint32_t k = 1; k < count && best_size > 0; k++) {
+                int port = ports[(start + k) % count];
+                uint32_t size = port_load(port);
+                if (size < best_size) {
+                    best_port = port;
+                    best_size = size;
+                }
+            }
+            return best_port;
+        }
+    }
+    return NO_ROUTE;
+}
+
+uint32_t Router::port_load(int port) {
+    if (protocol == LinkProtocol::BLOCKING) {
+        return output_queues[port].size();
+    }
+    // Flit slots already taken downstream, counting credits that have
+    // arrived by now as returned
+    Link* link = links[port].get();
+    uint32_t load = 0;
+    for (size_t vc = 0; vc < link->output_vcs.size(); vc++) {
+        link->has_credit(static_cast<int>(vc));
+        load += link->output_vcs[vc].max_credits - link->output_vcs[vc].credits;
+    }
+    return load;
+}
+
+int Router::next_port(Packet& packet) {
+    if (routing_table) return select_port(packet);
+    
+    // Standalone routers without a table keep the two-port heuristic
+    return (packet.dst_id > packet.src_id) ? 1 : 0;
+}
+
+bool Router::route_packet(PacketHandle handle) {
+    const int next_port = this->next_port(pool->get(handle));
+    
+    // Unreachable destinations are dropped rather than left to block
+    if (next_port == NO_ROUTE) {
+        dropped_count++;
+        release_packet(handle);
+        return true;
+    }
+    if (!output_queues[next_port].push(handle)) {
+        return false;
+    }
+    output_active |= 1ull << next_port;
+    return true;
+}
+
+bool Router::receive_packet(int port, PacketHandle handle, uint64_t arrival) {
+    if (!enqueue_input(port, handle, arrival)) {
+        return false;
+    }
+    pool->get(handle).hop_count++;
+    if (stats) stats->ports[port].packets_in++;
+    return true;
+}
+
+bool Router::receive_flit(int port, int vc, const Flit& flit) {
+    if (!input_vcs[port * num_vcs + vc].flits.push(flit)) {
+        return false;
+    }
+    if (flit.is_head()) {
+        pool->get(flit.handle).hop_count++;
+        if (stats) stats->ports[port].packets_in++;
+    }
+    flit_active |= 1ull << port;
+    wake();
+    return true;
+}
+
+bool Router::inject_packet(int port, PacketHandle handle) {
+    const uint64_t current = now();
+    if (!enqueue_input(port, handle, current)) {
+        return false;
+    }
+    pool->get(handle).timestamp = current;
+    if (stats) stats->ports[port].packets_in++;
+    return true;
+}
+
+bool Router::enqueue_input(int port, PacketHandle handle, uint64_t arrival) {
+    if (!input_queues[port].push(handle)) {
+        return false;
+    }
+    // Packets become eligible for routing on the first edge after arrival
+    pool->get(handle).arrival_time = arrival;
+    input_active |= 1ull << port;
+    wake();
+    return true;
+}
+
+void Router::wake() {
+    if ((event_driven || loosely_timed) && asleep && !detached) {
+        asleep = false;
+        wake_event.notify(sc_core::SC_ZERO_TIME);
+    }
+}
+
+void Router::evaluate() {
+    if (!event_driven) {
+        process_queues();
+        return;
+    }
+    
+    // Woken by an arrival: start following the clock from the next edge
+    if (!waiting_for_clock) {
+        waiting_for_clock = true;
+        next_trigger(clk.posedge_event());
+        return;
+    }
+    
+    process_queues();
+    
+    // Fall back to the static sensitivity on wake_event once idle
+    if (is_idle()) {
+        asleep = true;
+        waiting_for_clock = false;
+    } else {
+        next_trigger(clk.posedge_event());
+    }
+}
+
+void Router::run_loosely_timed() {
+    tlm_utils::tlm_quantumkeeper quantum_keeper;
+    quantum_keeper.reset();
+    asleep = false;
+    
+    while (true) {
+        // Nothing to do: give the kernel our local time and sleep
+        if (is_idle() || detached) {
+            quantum_keeper.sync();
+            asleep = true;
+            wait(wake_event);
+            quantum_keeper.reset();
+        }
+        
+        // Evaluate at local time without returning to the kernel; packets
+        // sent from here are stamped with the same local time
+        local_time = (quantum_keeper.get_current_time() + cycle_time).value();
+        set_thread_time_source(&local_time);
+        process_queues();
+        set_thread_time_source(nullptr);
+        
+        quantum_keeper.inc(cycle_time);
+        if (quantum_keeper.need_sync()) {
+            quantum_keeper.sync();
+        }
+    }
+}
+
+void Router::process_queues() {
+    // Outputs first, so a packet routed on this edge leaves on the next one
+    if (protocol == LinkProtocol::APPROXIMATELY_TIMED) {
+        flit_pipeline();
+        flit_injection();
+        return;
+    }
+    switch_fabric();
+    routing_logic();
+}
+
+void Router::eject_packet(int port, PacketHandle handle) {
+    ejected_count++;
+    const Packet& packet = pool->get(handle);
+    const bool corrupted = crc32c(packet.payload.data(), packet.payload.size()) != packet.crc;
+    if (corrupted) crc_errors++;
+    if (stats) {
+        stats->record_ejection(packet.src_id, packet.hop_count, now() - packet.timestamp);
+    }
+    if (trace) trace->eject(now(), handle, port, packet.hop_count);
+    if (sink) sink->on_eject(port, packet, corrupted);
+    release_packet(handle);
+}
+
+void Router::count_stall(int port) {
+    blocked_count++;
+    if (stats) stats->ports[port].stalls++;
+}
+
+void Router::release_packet(PacketHandle handle) {
+    if (release_sink) {
+        release_sink->push_back(handle);
+    } else {
+        pool->release(handle);
+    }
+}
+
+void Router::detach() {
+    detached = true;
+}
+
+void Router::attach() {
+    detached = false;
+    release_sink = nullptr;
+    if (!is_idle()) wake();
 }
 
 void Router::routing_logic() {
-    // Process input queues
-    for (int i = 0; i < radix; i++) {
-        if (!input_queues[i].empty()) {
-            Packet packet = input_queues[i].front();
-            input_queues[i].pop();
-            route_packet(packet);
+    // Visit only ports with queued packets; a packet whose output queue is
+    // full stays at the head of its input queue
+    const uint64_t current = now();
+    uint64_t pending = input_active;
+    if (allocator.get_type() != AllocatorType::NONE) {
+        allocate_outputs(pending, current);
+        return;
+    }
+    while (pending) {
+        int i = __builtin_ctzll(pending);
+        pending &= pending - 1;
+        
+        PacketHandle handle = input_queues[i].front();
+        if (pool->get(handle).arrival_time >= current) continue;
+        
+        if (route_packet(handle)) {
+            pop_input(i);
+        } else {
+            count_stall(i);
+        }
+    }
+}
+
+void Router::allocate_outputs(uint64_t pending, uint64_t current) {
+    // Every input with a due head packet requests the output it routes
+    // to, and each output takes at most one packet per edge
+    uint64_t inputs = 0;
+    while (pending) {
+        int i = __builtin_ctzll(pending);
+        pending &= pending - 1;
+        
+        PacketHandle handle = input_queues[i].front();
+        Packet& packet = pool->get(handle);
+        if (packet.arrival_time >= current) continue;
+        
+        const int port = next_port(packet);
+        if (port == NO_ROUTE) {
+            dropped_count++;
+            release_packet(handle);
+            pop_input(i);
+        } else if (output_queues[port].full()) {
+            count_stall(i);
+        } else {
+            requests[i] = 1ull << port;
+            inputs |= 1ull << i;
         }
     }
+    if (!inputs) return;
+    
+    uint64_t granted = allocator.allocate(requests.data(), inputs, grants.data());
+    for (uint64_t lost = inputs & ~granted; lost; lost &= lost - 1) {
+        count_stall(__builtin_ctzll(lost));
+    }
+    while (granted) {
+        int i = __builtin_ctzll(granted);
+        granted &= granted - 1;
+        const int port = __builtin_ctzll(grants[i]);
+        output_queues[port].push(input_queues[i].front());
+        output_active |= 1ull << port;
+        pop_input(i);
+    }
+}
+
+void Router::pop_input(int port) {
+    input_queues[port].pop();
+    if (input_queues[port].empty()) input_active &= ~(1ull << port);
+    links[port]->return_credit();
 }
 
 void Router::switch_fabric() {
     // Process output queues
-    for (int i = 0; i < radix; i++) {
-        if (!output_queues[i].empty()) {
-            Packet packet = output_queues[i].front();
-            output_queues[i].pop();
+    const uint64_t current = now();
+    uint64_t pending = output_active;
+    while (pending) {
+        int i = __builtin_ctzll(pending);
+        pending &= pending - 1;
+        Link* link = links[i].get();
+        const bool up = link->is_up(current);
+        
+        // Hold the packet until the link is free and the downstream router
+        // has room for it
+        if (up && (link->busy_until > current || !link->has_credit())) {
+            count_stall(i);
+            continue;
+        }
+        
+        PacketHandle handle = output_queues[i].front();
+        output_queues[i].pop();
+        if (output_queues[i].empty()) output_active &= ~(1ull << i);
+        if (stats) {
+            stats->ports[i].packets_out++;
+            stats->ports[i].flits_out += FLITS_PER_PACKET;
+        }
+        
+        // Ports without a peer are terminal ports and eject the packet
+        if (!link->is_connected) {
+            eject_packet(i, handle);
+            continue;
+        }
+        
+        if (!up) {
+            if (trace) trace->drop(current, handle, i);
+            dropped_count++;
+            release_packet(handle);
+            continue;
+        }
+        
+        Link::OutputVc& output = link->output_vcs[0];
+        output.credits--;
+        sc_core::sc_time delay = link->reserve(current);
+        if (trace) trace->forward(current, handle, i);
+        
+        if (link->mailbox) {
+            // Peer is stepped by another thread; it picks the packet up
+            // before its next edge
+            if (!link->mailbox->push({link->peer, handle, current + delay.value(), 0, 0})) {
+                output.credits++;
+                dropped_count++;
+                release_packet(handle);
+            }
+            continue;
+        }
+        
+        // Send packet through link; ownership passes to the receiver
+        Packet& packet = pool->get(handle);
+        tlm::tlm_generic_payload* trans = payloads.allocate();
+        trans->acquire();
+        trans->set_data_ptr(packet.payload.data());
+        trans->set_data_length(packet.payload.size());
+        trans->set_response_status(tlm::TLM_INCOMPLETE_RESPONSE);
+        trans->get_extension<PacketExtension>()->handle = handle;
+        
+        link->init_socket->b_transport(*trans, delay);
+        if (trans->is_response_error()) {
+            output.credits++;
+            dropped_count++;
+            release_packet(handle);
+        }
+        trans->release();
+    }
+}
+
+void Router::flit_injection() {
+    // Cut packets queued on terminal ports into flits, one per cycle, each
+    // packet into an idle VC of its port
+    const uint64_t current = now();
+    uint64_t pending = input_active;
+    while (pending) {
+        int port = __builtin_ctzll(pending);
+        pending &= pending - 1;
+        
+        PacketHandle handle = input_queues[port].front();
+        if (pool->get(handle).arrival_time >= current) continue;
+        
+        Injection& injection = injections[port];
+        if (injection.vc < 0) {
+            for (int vc = 0; vc < num_vcs; vc++) {
+                const InputVc& input = input_vcs[port * num_vcs + vc];
+                if (input.flits.empty() && input.out_port < 0) {
+                    injection.vc = vc;
+                    break;
+                }
+            }
+            if (injection.vc < 0) {
+                count_stall(port);
+                continue;
+            }
+        }
+        
+        InputVc& input = input_vcs[port * num_vcs + injection.vc];
+        if (!input.flits.push({handle, injection.next_flit, current, nullptr})) {
+            count_stall(port);
+            continue;
+        }
+        flit_active |= 1ull << port;
+        
+        if (++injection.next_flit == FLITS_PER_PACKET) {
+            input_queues[port].pop();
+            if (input_queues[port].empty()) input_active &= ~(1ull << port);
+            injection = Injection();
+        }
+    }
+}
+
+bool Router::allocate_vc(InputVc& input, const Flit& flit) {
+    // Route computation and VC allocation for the head flit; body flits
+    // follow on the same output VC
+    const int port = next_port(pool->get(flit.handle));
+    if (port == NO_ROUTE) {
+        input.out_port = NO_ROUTE;
+        input.out_vc = 0;
+        return true;
+    }
+    
+    // Terminal ports eject into the endpoint and need no VC
+    Link* link = links[port].get();
+    int vc = 0;
+    if (link->is_connected) {
+        vc = link->free_vc();
+        if (vc < 0) return false;
+        link->output_vcs[vc].owner = flit.handle;
+    }
+    input.out_port = port;
+    input.out_vc = vc;
+    return true;
+}
+
+void Router::flit_pipeline() {
+    if (allocator.get_type() != AllocatorType::NONE) {
+        allocate_flits();
+        return;
+    }
+    
+    // Switch allocation: each input port forwards at most one flit per
+    // cycle and each output port accepts at most one. Inputs take turns at
+    // priority, and so do the VCs within an input.
+    const uint64_t current = now();
+    const uint64_t first = input_pointer ? ~((1ull << input_pointer) - 1) : ~0ull;
+    uint64_t outputs_used = 0;
+    int next_pointer = -1;
+    
+    for (uint64_t group : {flit_active & first, flit_active & ~first}) {
+        while (group) {
+            int port = __builtin_ctzll(group);
+            group &= group - 1;
             
-            // Send packet through link
-            if (links[i]->is_active) {
-                tlm::tlm_generic_payload trans;
-                trans.set_data_ptr(packet.payload.data());
-                trans.set_data_length(packet.payload.size());
+            bool empty = true;
+            bool sent = false;
+            const int start = vc_pointer[port];
+            for (int k = 0; k < num_vcs; k++) {
+                int vc = (start + k) % num_vcs;
+                InputVc& input = input_vcs[port * num_vcs + vc];
+                if (input.flits.empty()) continue;
+                if (sent) {
+                    empty = false;
+                    break;
+                }
+                
+                const Flit& head = input.flits.front();
+                if (head.arrival >= current) {
+                    empty = false;
+                    continue;
+                }
+                if (input.out_port < 0 && !allocate_vc(input, head)) {
+                    count_stall(port);
+                    empty = false;
+                    continue;
+                }
                 
-                sc_core::sc_time delay = sc_core::SC_ZERO_TIME;
-                links[i]->init_socket->b_transport(trans, delay);
+                int out = input.out_port;
+                if (out != NO_ROUTE) {
+                    if ((outputs_used >> out) & 1 || !output_ready(input, head, current)) {
+                        count_stall(port);
+                        empty = false;
+                        continue;
+                    }
+                    outputs_used |= 1ull << out;
+                }
+                
+                forward_flit(port, vc);
+                if (!input.flits.empty()) empty = false;
+                sent = true;
             }
+            if (sent && next_pointer < 0) next_pointer = (port + 1) % radix;
+            if (empty) flit_active &= ~(1ull << port);
         }
     }
+    
+    // Priority moves past the first input served, so it only changes on
+    // edges where something moved and skipped idle edges do not matter
+    if (next_pointer >= 0) input_pointer = next_pointer;
+}
+
+void Router::allocate_flits() {
+    // Each input requests an output for every VC with a due head flit, VC
+    // allocated and ready to go; the first VC in its round-robin order
+    // stands for the input at an output several of them want. Unroutable
+    // flits need no output and are discarded instead of requesting one.
+    const uint64_t current = now();
+    uint64_t inputs = 0;
+    uint64_t moved = 0;
+    uint64_t pending = flit_active;
+    while (pending) {
+        int port = __builtin_ctzll(pending);
+        pending &= pending - 1;
+        
+        uint64_t row = 0;
+        int count = 0;
+        const int start = vc_pointer[port];
+        for (int k = 0; k < num_vcs; k++) {
+            int vc = (start + k) % num_vcs;
+            InputVc& input = input_vcs[port * num_vcs + vc];
+            if (input.flits.empty()) continue;
+            
+            const Flit& head = input.flits.front();
+            if (head.arrival >= current) continue;
+            if (input.out_port < 0 && !allocate_vc(input, head)) {
+                count_stall(port);
+                continue;
+            }
+            
+            int out = input.out_port;
+            if (out == NO_ROUTE) {
+                if (row) continue;
+                forward_flit(port, vc);
+                moved |= 1ull << port;
+                break;
+            }
+            if ((row >> out) & 1) continue;
+            if (!output_ready(input, head, current)) {
+                count_stall(port);
+                continue;
+            }
+            row |= 1ull << out;
+            request_vcs[port * num_vcs + count++] = static_cast<uint16_t>(out << 8 | vc);
+        }
+        if (row) {
+            requests[port] = row;
+            inputs |= 1ull << port;
+        }
+    }
+    
+    uint64_t granted = inputs ? allocator.allocate(requests.data(), inputs, grants.data()) : 0;
+    for (uint64_t lost = inputs & ~granted; lost; lost &= lost - 1) {
+        count_stall(__builtin_ctzll(lost));
+    }
+    moved |= granted;
+    while (granted) {
+        int port = __builtin_ctzll(granted);
+        granted &= granted - 1;
+        const int out = __builtin_ctzll(grants[port]);
+        const uint16_t* slot = &request_vcs[port * num_vcs];
+        while ((*slot >> 8) != out) slot++;
+        forward_flit(port, *slot & 0xFF);
+    }
+    
+    // Inputs that moved a flit may have emptied
+    while (moved) {
+        int port = __builtin_ctzll(moved);
+        moved &= moved - 1;
+        bool empty = true;
+        for (int vc = 0; vc < num_vcs && empty; vc++) {
+            empty = input_vcs[port * num_vcs + vc].flits.empty();
+        }
+        if (empty) flit_active &= ~(1ull << port);
+    }
+}
+
+bool Router::output_ready(const InputVc& input, const Flit& head, uint64_t current) {
+    // Terminal ports always take the flit, and so do links the packet is
+    // being discarded on; other links need to be free with a credit
+    Link* link = links[input.out_port].get();
+    if (!link->is_connected) return true;
+    bool carried = head.is_head()
+        ? link->is_up(current)
+        : !link->output_vcs[input.out_vc].discard;
+    return !carried || (link->busy_until <= current && link->has_credit(input.out_vc));
+}
+
+void Router::forward_flit(int port, int vc) {
+    InputVc& input = input_vcs[port * num_vcs + vc];
+    Flit flit = input.flits.front();
+    input.flits.pop();
+    links[port]->return_credit(vc, flit.trans);
+    if (input.out_port == NO_ROUTE) {
+        // Unreachable: discard the packet flit by flit
+        if (flit.is_tail()) {
+            dropped_count++;
+            release_packet(flit.handle);
+        }
+    } else {
+        send_flit(input.out_port, input.out_vc, flit);
+    }
+    if (flit.is_tail()) {
+        input.out_port = -1;
+        input.out_vc = -1;
+    }
+    vc_pointer[port] = static_cast<uint8_t>((vc + 1) % num_vcs);
+}
+
+void Router::send_flit(int port, int vc, const Flit& flit) {
+    if (stats) {
+        stats->ports[port].flits_out++;
+        if (flit.is_tail()) stats->ports[port].packets_out++;
+    }
+    
+    Link* link = links[port].get();
+    if (!link->is_connected) {
+        if (flit.is_tail()) eject_packet(port, flit.handle);
+        return;
+    }
+    
+    const uint64_t current = now();
+    Link::OutputVc& output = link->output_vcs[vc];
+    if (flit.is_head()) output.discard = !link->is_up(current);
+    if (flit.is_tail()) output.owner = INVALID_PACKET;
+    if (output.discard) {
+        if (flit.is_tail()) {
+            if (trace) trace->drop(current, flit.handle, port);
+            dropped_count++;
+            release_packet(flit.handle);
+        }
+        return;
+    }
+    
+    output.credits--;
+    sc_core::sc_time delay = link->reserve_flit(current, flit, vc);
+    if (trace && flit.is_head()) trace->forward(current, flit.handle, port);
+    
+    if (link->mailbox) {
+        if (!link->mailbox->push({link->peer, flit.handle, current + delay.value(),
+                                  flit.index, static_cast<uint8_t>(vc)})) {
+            output.credits++;
+            if (flit.is_tail()) {
+                dropped_count++;
+                release_packet(flit.handle);
+            }
+        }
+        return;
+    }
+    
+    // BEGIN_REQ carries the flit; the transaction stays open until the
+    // downstream router returns the credit with BEGIN_RESP
+    constexpr int flit_bytes = LINK_WIDTH / 8;
+    Packet& packet = pool->get(flit.handle);
+    tlm::tlm_generic_payload* trans = payloads.allocate();
+    trans->acquire();
+    trans->set_data_ptr(packet.payload.data() + flit.index * flit_bytes);
+    trans->set_data_length(flit_bytes);
+    trans->set_response_status(tlm::TLM_INCOMPLETE_RESPONSE);
+    PacketExtension* ext = trans->get_extension<PacketExtension>();
+    ext->handle = flit.handle;
+    ext->flit = flit.index;
+    ext->vc = static_cast<uint8_t>(vc);
+    
+    tlm::tlm_phase phase = tlm::BEGIN_REQ;
+    if (link->init_socket->nb_transport_fw(*trans, phase, delay) == tlm::TLM_COMPLETED) {
+        // Refused by the target
+        output.credits++;
+        trans->release();
+        if (flit.is_tail()) {
+            dropped_count++;
+            release_packet(flit.handle);
+        }
+    }
+}
+
+const char* inject_status_name(InjectStatus status) {
+    switch (status) {
+        case InjectStatus::OK: return "ok";
+        case InjectStatus::INVALID_ROUTER: return "invalid router";
+        case InjectStatus::NO_TERMINAL_PORT: return "no terminal port";
+        case InjectStatus::POOL_EXHAUSTED: return "pool exhausted";
+        case InjectStatus::QUEUE_FULL: return "queue full";
+    }
+    return "unknown";
 }
 
 // Fabric implementation
-Fabric::Fabric(sc_core::sc_module_name name, int num_routers)
+Fabric::Fabric(sc_core::sc_module_name name, int num_routers, int queue_depth,
+               RoutingAlgorithm algorithm, const ProtocolConfig& protocol)
+    : Fabric(name, TopologyConfig{TopologyType::FULLY_CONNECTED, {num_routers}, 1, 0},
+             queue_depth, algorithm, protocol)
+{
+}
+
+Fabric::Fabric(sc_core::sc_module_name name, const TopologyConfig& topology, int queue_depth,
+               RoutingAlgorithm algorithm, const ProtocolConfig& protocol)
     : sc_module(name)
-    , num_routers(num_routers)
+    , num_routers(0)
+    , topology(topology)
+    , injected_count(0)
 {
     SC_METHOD(reset);
     sensitive << rst_n.neg();
     
-    initialize_network();
+    SC_METHOD(sample_statistics);
+    sensitive << sample_event;
+    dont_initialize();
+    
+    initialize_network(queue_depth, algorithm, protocol);
 }
 
 void Fabric::reset() {
     for (auto& router : routers) {
         router->reset();
+        for (auto& link : router->links) {
+            link->reset();
+        }
+    }
+    packet_pool.reset();
+    injected_count = 0;
+    std::fill(injection_port.begin(), injection_port.end(), 0);
+    if (instrumentation) instrumentation->reset();
+}
+
+void Fabric::enable_instrumentation(const sc_core::sc_time& sample_interval) {
+    bool sampling = instrumentation && instrumentation->get_sample_interval() != 0;
+    double tick_ns = sc_core::sc_time::from_value(1).to_seconds() * 1e9;
+    instrumentation = std::make_unique<Instrumentation>(num_routers, graph.radix,
+                                                        sample_interval.value(), tick_ns);
+    for (int i = 0; i < num_routers; i++) {
+        routers[i]->stats = &instrumentation->router(i);
+    }
+    
+    // The parallel engine samples on its own; this covers the kernel
+    if (!sampling && sample_interval != sc_core::SC_ZERO_TIME) {
+        sample_event.notify(sample_interval);
+    }
+}
+
+void Fabric::sample_statistics() {
+    if (!instrumentation || instrumentation->get_sample_interval() == 0) return;
+    record_sample(sc_core::sc_time_stamp().value());
+    next_trigger(sc_core::sc_time::from_value(instrumentation->get_sample_interval()));
+}
+
+void Fabric::record_sample(uint64_t time) {
+    uint64_t ejected = 0;
+    for (auto& router : routers) {
+        ejected += router->ejected_count;
+    }
+    instrumentation->add_sample({time, injected_count, ejected,
+                                 packet_pool.get_statistics().in_use});
+}
+
+bool Fabric::enable_trace(const std::string& path, bool payloads) {
+    disable_trace();
+    trace = std::make_unique<TraceWriter>();
+    double tick_ns = sc_core::sc_time::from_value(1).to_seconds() * 1e9;
+    if (!trace->open(path, num_routers, graph.radix, tick_ns, payloads)) {
+        trace.reset();
+        return false;
+    }
+    for (int i = 0; i < num_routers; i++) {
+        routers[i]->trace = &trace->buffer(i);
+    }
+    return true;
+}
+
+bool Fabric::disable_trace() {
+    if (!trace) return true;
+    for (auto& router : routers) {
+        router->trace = nullptr;
+    }
+    bool ok = trace->close();
+    trace.reset();
+    return ok;
+}
+
+bool Fabric::save_checkpoint(const std::string& path) const {
+    return Checkpoint::save(*this, path);
+}
+
+bool Fabric::restore_checkpoint(const std::string& path) {
+    return Checkpoint::restore(*this, path);
+}
+
+bool Fabric::write_statistics_json(const std::string& path) const {
+    if (!instrumentation) {
+        std::cerr << "Instrumentation is not enabled" << std::endl;
+        return false;
+    }
+    return instrumentation->write_json(path);
+}
+
+bool Fabric::write_statistics_csv(const std::string& prefix) const {
+    if (!instrumentation) {
+        std::cerr << "Instrumentation is not enabled" << std::endl;
+        return false;
+    }
+    return instrumentation->write_csv(prefix);
+}
+
+void Fabric::set_link_timing(const sc_core::sc_time& latency, const sc_core::sc_time& flit_time) {
+    for (auto& router : routers) {
+        for (auto& link : router->links) {
+            link->set_timing(latency, flit_time);
+        }
+    }
+}
+
+void Fabric::set_error_rate(double rate) {
+    FaultConfig config = fault_config;
+    config.bit_error_rate = packet_to_bit_error_rate(rate);
+    set_fault_config(config);
+}
+
+void Fabric::set_fault_config(const FaultConfig& config) {
+    // Link ids key the fault streams, so they must not depend on the order
+    // links are visited in
+    fault_config = config;
+    for (auto& router : routers) {
+        for (auto& link : router->links) {
+            uint32_t link_id = static_cast<uint32_t>(router->router_id) * MAX_RADIX + link->port;
+            link->faults.configure(config, link_id, router->router_id, link->port);
+        }
     }
 }
 
 void Fabric::inject_packet(uint64_t src, uint64_t dst, const std::vector<uint8_t>& data) {
-    if (src >= num_routers || dst >= num_routers) {
-        std::cerr << "Invalid source or destination router ID" << std::endl;
-        return;
+    InjectStatus status = try_inject(src, dst, data.data(), data.size());
+    switch (status) {
+        case InjectStatus::OK:
+            break;
+        case InjectStatus::INVALID_ROUTER:
+            std::cerr << "Invalid source or destination router ID" << std::endl;
+            break;
+        case InjectStatus::NO_TERMINAL_PORT:
+            std::cerr << "Router " << src << " has no terminal ports" << std::endl;
+            break;
+        case InjectStatus::POOL_EXHAUSTED:
+            std::cerr << "Packet pool exhausted" << std::endl;
+            break;
+        case InjectStatus::QUEUE_FULL:
+            std::cerr << "Injection queue full at router " << src << std::endl;
+            break;
+    }
+}
+
+InjectStatus Fabric::try_inject(uint64_t src, uint64_t dst, const uint8_t* payload,
+                                size_t length) {
+    if (src >= static_cast<uint64_t>(num_routers) || dst >= static_cast<uint64_t>(num_routers)) {
+        return InjectStatus::INVALID_ROUTER;
+    }
+    const std::vector<int>& ports = graph.terminal_ports[src];
+    if (ports.empty()) {
+        return InjectStatus::NO_TERMINAL_PORT;
+    }
+    
+    // Take the next terminal port with room, so a full queue is found
+    // before a packet is allocated for it. Terminal ports have no peer, so
+    // draining them returns no credit upstream.
+    Router& router = *routers[src];
+    const uint32_t terminals = static_cast<uint32_t>(ports.size());
+    uint32_t& next = injection_port[src];
+    int port = -1;
+    for (uint32_t i = 0; i < terminals; i++) {
+        int candidate = ports[(next + i) % terminals];
+        if (!router.input_queues[candidate].full()) {
+            port = candidate;
+            next = (next + i + 1) % terminals;
+            break;
+        }
+    }
+    if (port < 0) {
+        return InjectStatus::QUEUE_FULL;
     }
     
-    Packet packet(src, dst);
-    std::copy(data.begin(), data.end(), packet.payload.begin());
+    PacketHandle handle = packet_pool.allocate(src, dst);
+    if (handle == INVALID_PACKET) {
+        return InjectStatus::POOL_EXHAUSTED;
+    }
     
-    // Inject into source router
-    routers[src]->input_queues[0].push(packet);
+    Packet& packet = packet_pool.get(handle);
+    length = std::min(length, packet.payload.size());
+    if (length) std::memcpy(packet.payload.data(), payload, length);
+    std::memset(packet.payload.data() + length, 0, packet.payload.size() - length);
+    packet.crc = crc32c(packet.payload.data(), packet.payload.size());
+    
+    if (!router.inject_packet(port, handle)) {
+        packet_pool.release(handle);
+        return InjectStatus::QUEUE_FULL;
+    }
+    if (router.trace) {
+        router.trace->inject(packet.timestamp, handle, port, dst, packet.payload.data());
+    }
+    injected_count++;
+    return InjectStatus::OK;
+}
+
+size_t Fabric::inject_packets(const PacketDescriptor* packets, size_t count,
+                              InjectStatus* status) {
+    size_t injected = 0;
+    for (size_t i = 0; i < count; i++) {
+        const PacketDescriptor& packet = packets[i];
+        InjectStatus result = try_inject(packet.src, packet.dst, packet.payload, packet.length);
+        injected += result == InjectStatus::OK;
+        if (status) status[i] = result;
+    }
+    return injected;
+}
+
+size_t Fabric::inject_packets(const PacketRecord* records, size_t count, InjectStatus* status) {
+    size_t injected = 0;
+    for (size_t i = 0; i < count; i++) {
+        const PacketRecord& record = records[i];
+        InjectStatus result = try_inject(record.src, record.dst, record.payload, PACKET_SIZE);
+        injected += result == InjectStatus::OK;
+        if (status) status[i] = result;
+    }
+    return injected;
 }
 
 void Fabric::get_statistics() {
     uint64_t total_packets = 0;
     uint64_t total_errors = 0;
+    uint64_t total_bit_errors = 0;
+    uint64_t total_blocked = 0;
+    uint64_t total_ejected = 0;
+    uint64_t total_dropped = 0;
+    uint64_t total_crc_errors = 0;
+    uint64_t total_latency = 0;
     
     for (auto& router : routers) {
+        total_blocked += router->blocked_count;
+        total_ejected += router->ejected_count;
+        total_dropped += router->dropped_count;
+        total_crc_errors += router->crc_errors;
         for (auto& link : router->links) {
             total_packets += link->packet_count;
             total_errors += link->error_count;
+            total_bit_errors += link->faults.get_bit_errors();
+            total_latency += link->total_latency;
         }
     }
     
@@ -156,24 +1379,76 @@ void Fabric::get_statistics() {
     std::cout << "Fabric Statistics:" << std::endl;
     std::cout << "Total Packets: " << total_packets << std::endl;
     std::cout << "Total Errors: " << total_errors << std::endl;
+    std::cout << "Bit Errors: " << total_bit_errors << std::endl;
     std::cout << "Reliability: " << reliability << "%" << std::endl;
+    std::cout << "Delivered Packets: " << total_ejected << std::endl;
+    std::cout << "CRC Errors Detected: " << total_crc_errors << std::endl;
+    std::cout << "Dropped Packets: " << total_dropped << std::endl;
+    std::cout << "Backpressure Stalls: " << total_blocked << std::endl;
+    if (total_packets > 0) {
+        sc_core::sc_time average = sc_core::sc_time::from_value(total_latency / total_packets);
+        std::cout << "Average Link Latency: " << average << std::endl;
+    }
+    
+    if (instrumentation) {
+        LatencyHistogram latency = instrumentation->latency();
+        double tick_ns = sc_core::sc_time::from_value(1).to_seconds() * 1e9;
+        std::cout << "Packet Latency (ns): mean " << latency.mean() * tick_ns
+                  << ", p50 " << latency.percentile(0.50) * tick_ns
+                  << ", p99 " << latency.percentile(0.99) * tick_ns
+                  << ", max " << latency.max() * tick_ns << std::endl;
+    }
+    
+    PacketPoolStats pool_stats = packet_pool.get_statistics();
+    std::cout << "Packet Pool: " << pool_stats.in_use << "/" << pool_stats.capacity
+              << " in use (peak " << pool_stats.peak_in_use << ", "
+              << pool_stats.slabs << " slabs)" << std::endl;
+    std::cout << "Pool Allocations: " << pool_stats.allocations
+              << " (failed " << pool_stats.failed_allocations << ")" << std::endl;
 }
 
-void Fabric::initialize_network() {
+void Fabric::initialize_network(int queue_depth, RoutingAlgorithm algorithm,
+                                const ProtocolConfig& protocol) {
+    std::string error;
+    if (!build_topology(topology, graph, error)) {
+        std::cerr << error << std::endl;
+        return;
+    }
+    if (graph.radix > MAX_RADIX) {
+        std::cerr << topology_name(topology.type) << " topology needs radix " << graph.radix
+                  << ", above MAX_RADIX " << MAX_RADIX << std::endl;
+        return;
+    }
+    num_routers = graph.num_routers;
+    injection_port.assign(num_routers, 0);
+    
     // Create routers
+    routers.reserve(num_routers);
     for (int i = 0; i < num_routers; i++) {
-        routers.push_back(std::make_unique<Router>(("router_" + std::to_string(i)).c_str()));
+        routers.push_back(std::make_unique<Router>(("router_" + std::to_string(i)).c_str(),
+                                                   graph.radix, &packet_pool, queue_depth,
+                                                   protocol));
+        routers[i]->clk(clk);
+        routers[i]->rst_n(rst_n);
     }
     
-    // Connect routers in a mesh topology
+    // Bind only the ports the topology uses, once per direction
     for (int i = 0; i < num_routers; i++) {
-        for (int j = 0; j < num_routers; j++) {
-            if (i != j) {
-                // Connect router i to router j
-                routers[i]->links[j]->init_socket.bind(routers[j]->links[i]->target_socket);
-            }
+        for (int p = 0; p < graph.radix; p++) {
+            int j = graph.neighbor(i, p);
+            if (j < 0) continue;
+            Link* local = routers[i]->links[p].get();
+            Link* remote = routers[j]->links[graph.neighbor_port(i, p)].get();
+            local->init_socket.bind(remote->target_socket);
+            local->connect(remote);
         }
     }
+    
+    // Precompute forwarding tables
+    routing = std::make_unique<RoutingEngine>(graph, algorithm);
+    for (int i = 0; i < num_routers; i++) {
+        routers[i]->set_routing_table(&routing->table(i));
+    }
 }
 
 } // namespace fabric 
\ No newline at end of file
@@ -2,37 +2,146 @@
 
 #include <systemc>
 #include <tlm>
+#include <tlm_utils/simple_initiator_socket.h>
+#include <tlm_utils/simple_target_socket.h>
+#include <tlm_utils/tlm_quantumkeeper.h>
 #include <vector>
-#include <queue>
 #include <memory>
-#include <random>
+
+#include "allocator.hpp"
+#include "checkpoint.hpp"
+#include "crc32c.hpp"
+#include "fault.hpp"
+#include "instrumentation.hpp"
+#include "packet.hpp"
+#include "ring_buffer.hpp"
+#include "routing.hpp"
+#include "topology.hpp"
+#include "trace.hpp"
 
 namespace fabric {
 
 // Forward declarations
 class Router;
 class Link;
-class Packet;
 
 // Constants
 constexpr int MAX_RADIX = 64;
-constexpr int PACKET_SIZE = 64;  // bytes
 constexpr int LINK_WIDTH = 16;   // bits
+constexpr int DEFAULT_QUEUE_DEPTH = 16;  // packets per port
+constexpr int FLITS_PER_PACKET = (PACKET_SIZE * 8 + LINK_WIDTH - 1) / LINK_WIDTH;
+constexpr int MAX_VIRTUAL_CHANNELS = 8;
+constexpr int DEFAULT_VIRTUAL_CHANNELS = 2;
+constexpr int DEFAULT_VC_DEPTH = 8;  // flits per virtual channel
+
+// How packets cross links. BLOCKING moves whole packets with b_transport.
+// APPROXIMATELY_TIMED splits them into LINK_WIDTH flits that go through
+// per-port virtual channels and a one-flit-per-cycle crossbar, using the
+// 4-phase base protocol on nb_transport: BEGIN_REQ carries a flit,
+// END_REQ accepts it into the downstream buffer, and BEGIN_RESP returns
+// its credit once it leaves that buffer. A VC depth below
+// FLITS_PER_PACKET gives wormhole switching, at or above it virtual
+// cut-through.
+enum class LinkProtocol {
+    BLOCKING,
+    APPROXIMATELY_TIMED
+};
+
+// The allocator arbitrates the crossbar between input ports. Without one,
+// blocking routers move every routable head packet into its output queue
+// on each edge, however many share an output, and AT routers grant
+// greedily in round-robin input order. With one, an output takes at most
+// one packet (blocking) or flit (AT) per edge, and AT inputs request an
+// output for each of their ready VCs.
+struct ProtocolConfig {
+    LinkProtocol protocol = LinkProtocol::BLOCKING;
+    int virtual_channels = DEFAULT_VIRTUAL_CHANNELS;
+    int vc_depth = DEFAULT_VC_DEPTH;
+    AllocatorType allocator = AllocatorType::NONE;
+    int allocator_iterations = 1;  // iSLIP rounds per edge
+};
+
+// Router evaluation mode, read when a router is constructed. Polling
+// routers evaluate on every clock edge; event-driven routers sleep while
+// all their queues are empty and are woken by the next arriving packet.
+// Both modes produce the same cycle-by-cycle results.
+void set_event_driven(bool enabled);
+bool is_event_driven();
+
+// Loosely-timed mode, read when a router is constructed. Routers run as
+// temporally decoupled threads: each evaluation advances a local time by
+// cycle_time, and a tlm_quantumkeeper only yields to the kernel once the
+// global quantum (tlm_global_quantum) is used up.
+void set_loosely_timed(bool enabled,
+                       const sc_core::sc_time& cycle_time = sc_core::sc_time(10, sc_core::SC_NS));
+bool is_loosely_timed();
+
+// Time seen by routers and links on the calling thread, as a raw sc_time
+// value. Defaults to sc_time_stamp(); engines that step routers outside
+// the SystemC kernel point it at their own clock.
+void set_thread_time_source(const uint64_t* time);
+uint64_t current_time();
+
+// Bumped by every Link::set_timing(), so anything sized from link
+// latencies can tell when it is out of date
+uint64_t link_timing_generation();
+
+// Packet, flit or credit crossing between threads of the parallel engine
+struct LinkMessage {
+    Link* target;         // receiving end of the link
+    PacketHandle handle;  // INVALID_PACKET for a credit
+    uint64_t time;        // when it reaches the target
+    uint16_t flit;        // flit index, AT protocol only
+    uint8_t vc;           // virtual channel, AT protocol only
+};
+using Mailbox = RingBuffer<LinkMessage>;
+
+// One LINK_WIDTH slice of a packet buffered in a virtual channel. The
+// payload stays in the pool; trans is the AT transaction that brought the
+// flit in and is completed when the flit leaves.
+struct Flit {
+    PacketHandle handle;
+    uint16_t index;
+    uint64_t arrival;
+    tlm::tlm_generic_payload* trans;
+    
+    bool is_head() const { return index == 0; }
+    bool is_tail() const { return index == FLITS_PER_PACKET - 1; }
+};
 
-// Packet structure
-struct Packet {
-    uint64_t src_id;
-    uint64_t dst_id;
-    uint64_t timestamp;
-    std::vector<uint8_t> payload;
-    bool is_control;
-    
-    Packet(uint64_t src, uint64_t dst, bool control = false)
-        : src_id(src), dst_id(dst), timestamp(0), is_control(control) {
-        payload.resize(PACKET_SIZE);
+// Carries a packet handle alongside the payload pointer so the receiving
+// router can enqueue the packet without copying it
+struct PacketExtension : tlm::tlm_extension<PacketExtension> {
+    PacketHandle handle = INVALID_PACKET;
+    uint16_t flit = 0;  // AT protocol only
+    uint8_t vc = 0;
+
+    tlm::tlm_extension_base* clone() const override {
+        PacketExtension* ext = new PacketExtension;
+        ext->copy_from(*this);
+        return ext;
+    }
+    void copy_from(const tlm::tlm_extension_base& other) override {
+        const PacketExtension& ext = static_cast<const PacketExtension&>(other);
+        handle = ext.handle;
+        flit = ext.flit;
+        vc = ext.vc;
     }
 };
 
+// Memory manager that recycles generic payloads. Each payload keeps its
+// PacketExtension for life, so allocation after warm-up is a list pop.
+class PayloadPool : public tlm::tlm_mm_interface {
+public:
+    tlm::tlm_generic_payload* allocate();
+    void free(tlm::tlm_generic_payload* trans) override;
+    size_t size() const { return payloads.size(); }
+    
+private:
+    std::vector<std::unique_ptr<tlm::tlm_generic_payload>> payloads;
+    std::vector<tlm::tlm_generic_payload*> free_list;
+};
+
 // Link class representing a physical connection between routers
 class Link : public sc_core::sc_module {
 public:
@@ -40,26 +149,86 @@ public:
     sc_core::sc_in<bool> rst_n;
     
     // TLM sockets
-    tlm::tlm_initiator_socket<> init_socket;
-    tlm::tlm_target_socket<> target_socket;
+    tlm_utils::simple_initiator_socket<Link> init_socket;
+    tlm_utils::simple_target_socket<Link> target_socket;
+    
+    // Owning router and the port this link is attached to
+    Router* router;
+    int port;
+    
+    // Link at the other end; credits flow back to it as the receiving
+    // router drains its input queue
+    Link* peer;
+    
+    // Set by the parallel engine when the peer is stepped by another thread
+    Mailbox* mailbox;
     
     // Link state
+    bool is_connected;
     bool is_active;
-    double error_rate;
-    uint64_t error_count;
+    uint64_t error_count;   // packets that arrived with a corrupted payload
     uint64_t packet_count;
     
+    // Bit errors, bursts, stuck-at bits and down windows; see FaultEngine
+    FaultEngine faults;
+    
+    // Timing: a packet occupies the link for serialization_delay (a flit
+    // for flit_time) and reaches the far end latency after that; credits
+    // only see latency
+    sc_core::sc_time latency;
+    sc_core::sc_time flit_time;
+    sc_core::sc_time serialization_delay;
+    uint64_t busy_until;     // raw sc_time value
+    uint64_t total_latency;  // raw sc_time, summed over packets sent
+    
+    // Credit-based flow control: one credit per free slot in the peer's
+    // input queue, or per flit slot in each of its virtual channels. A
+    // returned credit becomes usable on the first edge after it arrives,
+    // whatever order the routers are evaluated in.
+    struct OutputVc {
+        uint32_t max_credits = 0;
+        uint32_t credits = 0;
+        RingBuffer<uint64_t> credit_returns;  // arrival times of credits in flight
+        PacketHandle owner = INVALID_PACKET;  // AT: packet holding the downstream VC
+        uint64_t head_time = 0;               // AT: when the owner's head flit left
+        bool discard = false;                 // AT: owner's head flit met a down link
+    };
+    std::vector<OutputVc> output_vcs;  // one entry for the blocking protocol
+    
     SC_HAS_PROCESS(Link);
-    Link(sc_core::sc_module_name name, double err_rate = 0.0);
+    Link(sc_core::sc_module_name name);
     
     // Link methods
     void reset();
-    bool inject_error();
+    bool inject_error(PacketHandle handle);
+    bool is_up(uint64_t now) const { return is_active && !faults.is_down(now); }
     void update_statistics(bool error);
+    void connect(Link* remote);
+    void set_timing(const sc_core::sc_time& latency, const sc_core::sc_time& flit_time);
+    sc_core::sc_time reserve(uint64_t now);
+    sc_core::sc_time reserve_flit(uint64_t now, const Flit& flit, int vc);
+    void return_credit(int vc = 0, tlm::tlm_generic_payload* trans = nullptr);
+    void add_credit(uint64_t arrival, int vc = 0);
+    bool has_credit(int vc = 0);
+    int free_vc();
+    bool deliver(PacketHandle handle, uint64_t arrival);
+    bool deliver_flit(const Flit& flit, int vc);
+    void b_transport(tlm::tlm_generic_payload& trans, sc_core::sc_time& delay);
+    tlm::tlm_sync_enum nb_transport_fw(tlm::tlm_generic_payload& trans, tlm::tlm_phase& phase,
+                                       sc_core::sc_time& delay);
+    tlm::tlm_sync_enum nb_transport_bw(tlm::tlm_generic_payload& trans, tlm::tlm_phase& phase,
+                                       sc_core::sc_time& delay);
+};
+
+// Receives packets as a router ejects them, before they are released, so
+// a device model can stand at a terminal port. Called from the thread
+// that steps the router.
+class PacketSink {
+public:
+    virtual ~PacketSink() = default;
     
-private:
-    std::mt19937 rng;
-    std::uniform_real_distribution<double> error_dist;
+    // corrupted is set when the payload fails its CRC
+    virtual void on_eject(int port, const Packet& packet, bool corrupted) = 0;
 };
 
 // Router class implementing the high-radix switch
@@ -70,23 +239,153 @@ public:
     
     // Router configuration
     int radix;
+    int router_id;
+    const RoutingTable* routing_table;
     std::vector<std::unique_ptr<Link>> links;
     
     // Router state
-    std::vector<std::queue<Packet>> input_queues;
-    std::vector<std::queue<Packet>> output_queues;
+    PacketPool* pool;
+    std::vector<RingBuffer<PacketHandle>> input_queues;
+    std::vector<RingBuffer<PacketHandle>> output_queues;
+    uint64_t blocked_count;  // packets held back by full queues or missing credits
+    uint64_t ejected_count;
+    uint64_t dropped_count;
+    uint64_t crc_errors;  // ejected packets whose payload fails its CRC
+    
+    // AT protocol state: virtual channel buffers indexed by
+    // port * num_vcs + vc. Packets queued on terminal ports are cut into
+    // flits one per cycle as a free VC becomes available.
+    struct InputVc {
+        RingBuffer<Flit> flits;
+        int out_port = -1;  // set by route computation for the head packet
+        int out_vc = -1;    // downstream VC won in VC allocation
+    };
+    LinkProtocol protocol;
+    int num_vcs;
+    std::vector<InputVc> input_vcs;
+    
+    // Ports with a non-empty queue or VC, one bit per port
+    uint64_t input_active;
+    uint64_t output_active;
+    uint64_t flit_active;
     
     SC_HAS_PROCESS(Router);
-    Router(sc_core::sc_module_name name, int radix = MAX_RADIX);
+    // Routers without a shared pool allocate their own
+    Router(sc_core::sc_module_name name, int radix = MAX_RADIX, PacketPool* pool = nullptr,
+           int queue_depth = DEFAULT_QUEUE_DEPTH, const ProtocolConfig& config = ProtocolConfig());
     
     // Router methods
     void reset();
-    void route_packet(Packet& packet);
+    void set_queue_depth(int port, uint32_t input_depth, uint32_t output_depth);
+    void set_routing_table(const RoutingTable* table);
+    bool route_packet(PacketHandle handle);
+    bool receive_packet(int port, PacketHandle handle, uint64_t arrival);
+    bool inject_packet(int port, PacketHandle handle);
+    bool receive_flit(int port, int vc, const Flit& flit);
     void process_queues();
+    bool is_idle() const { return (input_active | output_active | flit_active) == 0; }
+    
+    // Hand the router to an engine that calls process_queues() directly.
+    // While detached, wake-ups are suppressed and freed packets go to
+    // release_sink when one is set.
+    void detach();
+    void attach();
+    std::vector<PacketHandle>* release_sink;
+    
+    // Per-port counters and latency histograms, null when instrumentation
+    // is off
+    RouterStatistics* stats;
+    
+    // Packet trace records of this router, null when tracing is off
+    TraceBuffer* trace;
+    
+    // Receiver of ejected packets, null when none is attached
+    PacketSink* sink;
     
 private:
+    friend class Checkpoint;
+    
+    void evaluate();
+    void run_loosely_timed();
+    void wake();
+    void release_packet(PacketHandle handle);
+    bool enqueue_input(int port, PacketHandle handle, uint64_t arrival);
     void routing_logic();
+    void allocate_outputs(uint64_t pending, uint64_t current);
+    void pop_input(int port);
     void switch_fabric();
+    void flit_injection();
+    void flit_pipeline();
+    void allocate_flits();
+    bool output_ready(const InputVc& input, const Flit& head, uint64_t current);
+    void forward_flit(int port, int vc);
+    bool allocate_vc(InputVc& input, const Flit& flit);
+    void send_flit(int port, int vc, const Flit& flit);
+    int next_port(Packet& packet);
+    int select_port(Packet& packet);
+    uint32_t port_load(int port);
+    void eject_packet(int port, PacketHandle handle);
+    void count_stall(int port);
+    
+    std::unique_ptr<PacketPool> own_pool;
+    PayloadPool payloads;
+    uint64_t valiant_sequence;
+    
+    // AT allocation state
+    struct Injection {
+        int vc = -1;
+        uint16_t next_flit = 0;
+    };
+    std::vector<Injection> injections;
+    std::vector<uint8_t> vc_pointer;  // round-robin VC priority per input port
+    int input_pointer;                // round-robin input priority for the crossbar
+    
+    // Switch allocation, when the protocol config names an allocator:
+    // request and grant rows per input port, and for AT the output and VC
+    // of each request an input makes, num_vcs slots per port
+    SwitchAllocator allocator;
+    std::vector<uint64_t> requests;
+    std::vector<uint64_t> grants;
+    std::vector<uint16_t> request_vcs;
+    
+    // Event-driven evaluation state
+    bool event_driven;
+    bool detached;
+    bool asleep;
+    bool waiting_for_clock;
+    sc_core::sc_event wake_event;
+    
+    // Loosely-timed evaluation state
+    bool loosely_timed;
+    sc_core::sc_time cycle_time;
+    uint64_t local_time;
+};
+
+// Outcome of injecting one packet
+enum class InjectStatus : uint8_t {
+    OK,
+    INVALID_ROUTER,    // source or destination out of range
+    NO_TERMINAL_PORT,  // source router has no terminal ports
+    POOL_EXHAUSTED,
+    QUEUE_FULL         // every injection queue at the source is full
+};
+
+const char* inject_status_name(InjectStatus status);
+
+// One packet of a batch. The payload is a view of caller memory, copied
+// straight into the pooled packet; bytes past PACKET_SIZE are ignored.
+struct PacketDescriptor {
+    uint64_t src;
+    uint64_t dst;
+    const uint8_t* payload;  // may be null when length is 0
+    uint32_t length;
+};
+
+// Fixed-layout record for preformatted, contiguous packet buffers
+struct PacketRecord {
+    uint64_t src;
+    uint64_t dst;
+    uint8_t payload[PACKET_SIZE];
 };
 
 // Top-level fabric model
@@ -97,18 +396,71 @@ public:
     
     // Fabric configuration
     int num_routers;
+    TopologyConfig topology;
+    PacketPool packet_pool;
+    NetworkGraph graph;
+    std::unique_ptr<RoutingEngine> routing;
     std::vector<std::unique_ptr<Router>> routers;
+    uint64_t injected_count;
+    std::unique_ptr<Instrumentation> instrumentation;
     
     SC_HAS_PROCESS(Fabric);
-    Fabric(sc_core::sc_module_name name, int num_routers);
+    // Fully connected fabric of num_routers routers
+    Fabric(sc_core::sc_module_name name, int num_routers, int queue_depth = DEFAULT_QUEUE_DEPTH,
+           RoutingAlgorithm algorithm = RoutingAlgorithm::DIMENSION_ORDER,
+           const ProtocolConfig& protocol = ProtocolConfig());
+    Fabric(sc_core::sc_module_name name, const TopologyConfig& topology,
+           int queue_depth = DEFAULT_QUEUE_DEPTH,
+           RoutingAlgorithm algorithm = RoutingAlgorithm::DIMENSION_ORDER,
+           const ProtocolConfig& protocol = ProtocolConfig());
     
     // Fabric methods
     void reset();
+    void set_link_timing(const sc_core::sc_time& latency, const sc_core::sc_time& flit_time);
+    void set_error_rate(double rate);  // per packet, spread over its bits
+    void set_fault_config(const FaultConfig& config);
+    const FaultConfig& get_fault_config() const { return fault_config; }
     void inject_packet(uint64_t src, uint64_t dst, const std::vector<uint8_t>& data);
     void get_statistics();
     
+    // Batch injection. Packets are spread round-robin over each source's
+    // terminal ports, nothing is logged and, when status is non-null, it
+    // receives one code per packet. Returns the number injected.
+    size_t inject_packets(const PacketDescriptor* packets, size_t count,
+                          InjectStatus* status = nullptr);
+    size_t inject_packets(const PacketRecord* records, size_t count,
+                          InjectStatus* status = nullptr);
+    InjectStatus try_inject(uint64_t src, uint64_t dst, const uint8_t* payload, size_t length);
+    
+    // Latency histograms, per-port counters and, with a non-zero interval,
+    // an occupancy/throughput time series. Off until enabled.
+    void enable_instrumentation(const sc_core::sc_time& sample_interval = sc_core::SC_ZERO_TIME);
+    void record_sample(uint64_t time);
+    bool write_statistics_json(const std::string& path) const;
+    bool write_statistics_csv(const std::string& prefix) const;
+    
+    // Records injections, per-hop forwarding, drops and ejections to a
+    // trace file until disable_trace(), optionally with injected payloads
+    // so TraceReplay can reproduce them exactly. Both must be called
+    // between runs.
+    bool enable_trace(const std::string& path, bool payloads = false);
+    bool disable_trace();
+    
+    // Binary snapshot of the fabric's dynamic state; see Checkpoint
+    bool save_checkpoint(const std::string& path) const;
+    bool restore_checkpoint(const std::string& path);
+    
 private:
-    void initialize_network();
+    friend class Checkpoint;
+    
+    void initialize_network(int queue_depth, RoutingAlgorithm algorithm,
+                            const ProtocolConfig& protocol);
+    void sample_statistics();
+    
+    sc_core::sc_event sample_event;
+    FaultConfig fault_config;
+    std::vector<uint32_t> injection_port;  // next terminal port to try, per router
+    std::unique_ptr<TraceWriter> trace;
 };
 
 } // namespace fabric 
\ No newline at end of file
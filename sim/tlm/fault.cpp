@@ -0,0 +1,183 @@
+#include "fault.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace fabric {
+
+namespace {
+constexpr uint64_t NEVER = UINT64_MAX;
+constexpr size_t MASK_WORDS = PACKET_SIZE / 8;
+
+inline void multiply(uint32_t a, uint32_t b, uint32_t& hi, uint32_t& lo) {
+    uint64_t product = static_cast<uint64_t>(a) * b;
+    hi = static_cast<uint32_t>(product >> 32);
+    lo = static_cast<uint32_t>(product);
+}
+
+inline uint64_t advance(uint64_t position, uint64_t skip) {
+    return skip >= NEVER - position ? NEVER : position + skip;
+}
+
+// XORs a packet-sized mask into the payload
+inline void apply_mask(uint8_t* payload, const uint64_t* mask) {
+#ifdef __SSE2__
+    for (size_t i = 0; i < PACKET_SIZE; i += 16) {
+        __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(payload + i));
+        __m128i flips = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mask + i / 8));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(payload + i), _mm_xor_si128(data, flips));
+    }
+#else
+    for (size_t i = 0; i < MASK_WORDS; i++) {
+        uint64_t word;
+        std::memcpy(&word, payload + i * 8, 8);
+        word ^= mask[i];
+        std::memcpy(payload + i * 8, &word, 8);
+    }
+#endif
+}
+} // namespace
+
+PhiloxCounter philox4x32(PhiloxCounter counter, PhiloxKey key) {
+    constexpr uint32_t M0 = 0xD2511F53, M1 = 0xCD9E8D57;
+    constexpr uint32_t W0 = 0x9E3779B9, W1 = 0xBB67AE85;
+    for (int round = 0; round < 10; round++) {
+        uint32_t hi0, lo0, hi1, lo1;
+        multiply(M0, counter[0], hi0, lo0);
+        multiply(M1, counter[2], hi1, lo1);
+        counter = {hi1 ^ counter[1] ^ key[0], lo1, hi0 ^ counter[3] ^ key[1], lo0};
+        key[0] += W0;
+        key[1] += W1;
+    }
+    return counter;
+}
+
+double packet_to_bit_error_rate(double packet_error_rate) {
+    if (packet_error_rate <= 0.0) return 0.0;
+    if (packet_error_rate >= 1.0) return 1.0;
+    return -std::expm1(std::log1p(-packet_error_rate) / PACKET_BITS);
+}
+
+FaultEngine::FaultEngine()
+    : key{0, 0}
+    , link_id(0)
+    , active(false)
+    , log_keep_bit(0.0)
+    , log_keep_burst(0.0)
+    , burst_length(1)
+    , stuck_bit(-1)
+    , stuck_value(false)
+{
+    reset();
+}
+
+void FaultEngine::configure(const FaultConfig& config, uint32_t link_id, int router, int port) {
+    key = {static_cast<uint32_t>(config.seed), static_cast<uint32_t>(config.seed >> 32)};
+    this->link_id = link_id;
+    log_keep_bit = std::log1p(-std::min(std::max(config.bit_error_rate, 0.0), 1.0));
+    log_keep_burst = std::log1p(-std::min(std::max(config.burst_rate, 0.0), 1.0));
+    burst_length = std::max<uint32_t>(config.burst_length, 1);
+    stuck_bit = config.stuck_bit < static_cast<int>(PACKET_BITS) ? config.stuck_bit : -1;
+    stuck_value = config.stuck_value;
+
+    down.clear();
+    for (const LinkDownWindow& window : config.link_down) {
+        bool match = window.router < 0 ||
+                     (window.router == router && (window.port < 0 || window.port == port));
+        if (match && window.until > window.from) down.emplace_back(window.from, window.until);
+    }
+
+    active = log_keep_bit != 0.0 || log_keep_burst != 0.0 || stuck_bit >= 0 || !down.empty();
+    reset();
+}
+
+void FaultEngine::reset() {
+    position = 0;
+    errors = 0;
+    bursts = 0;
+    bit_errors = 0;
+    burst_from = 0;
+    burst_until = 0;
+    next_error = gap(BIT_ERRORS, errors, log_keep_bit);
+    next_burst = gap(BURST_STARTS, bursts, log_keep_burst);
+}
+
+uint64_t FaultEngine::draw(Stream stream, uint64_t index) const {
+    PhiloxCounter block = philox4x32({static_cast<uint32_t>(index),
+                                      static_cast<uint32_t>(index >> 32), link_id, stream}, key);
+    return (static_cast<uint64_t>(block[0]) << 32) | block[1];
+}
+
+uint64_t FaultEngine::gap(Stream stream, uint64_t index, double log_keep) const {
+    // Bits before the next event when each bit starts one with probability
+    // p: floor(log(u) / log(1 - p)) for u uniform in (0, 1]
+    if (log_keep == 0.0) return NEVER;
+    if (std::isinf(log_keep)) return 0;
+    double u = static_cast<double>((draw(stream, index) >> 11) + 1) * 0x1p-53;
+    double skip = std::floor(std::log(u) / log_keep);
+    return skip < 0x1p63 ? static_cast<uint64_t>(skip) : NEVER;
+}
+
+void FaultEngine::flip_burst(uint64_t* mask, uint64_t begin) const {
+    const uint64_t from = std::max(burst_from, begin) - begin;
+    const uint64_t until = std::min(burst_until, begin + PACKET_BITS) - begin;
+    for (uint64_t word = from >> 6; word <= (until - 1) >> 6; word++) {
+        const uint64_t low = word * 64;
+        uint64_t bits = ~0ull;
+        if (from > low) bits &= ~0ull << (from - low);
+        if (until < low + 64) bits &= (1ull << (until - low)) - 1;
+
+        // Random bits in between, keyed by the word's place in the stream
+        uint64_t pattern = draw(BURST_PATTERNS, (begin >> 6) + word);
+        const uint64_t first = burst_from - begin - low;
+        const uint64_t last = burst_until - 1 - begin - low;
+        if (burst_from >= begin + low && first < 64) pattern |= 1ull << first;
+        if (burst_until - 1 >= begin + low && last < 64) pattern |= 1ull << last;
+        mask[word] ^= bits & pattern;
+    }
+}
+
+bool FaultEngine::corrupt(uint8_t* payload, uint64_t begin) {
+    const uint64_t end = begin + PACKET_BITS;
+    uint64_t mask[MASK_WORDS] = {};
+
+    while (next_error < end) {
+        const uint64_t bit = next_error - begin;
+        mask[bit >> 6] ^= 1ull << (bit & 63);
+        errors++;
+        next_error = advance(next_error + 1, gap(BIT_ERRORS, errors, log_keep_bit));
+    }
+
+    // A burst carried over from the previous packet, then any starting here
+    if (burst_until > begin) flip_burst(mask, begin);
+    while (next_burst < end) {
+        burst_from = next_burst;
+        burst_until = advance(burst_from, burst_length);
+        bursts++;
+        next_burst = advance(burst_until, gap(BURST_STARTS, bursts, log_keep_burst));
+        flip_burst(mask, begin);
+    }
+
+    uint64_t flipped = 0;
+    for (size_t i = 0; i < MASK_WORDS; i++) {
+        flipped += __builtin_popcountll(mask[i]);
+    }
+    if (flipped) apply_mask(payload, mask);
+
+    if (stuck_bit >= 0) {
+        uint8_t& byte = payload[stuck_bit >> 3];
+        const uint8_t bit = static_cast<uint8_t>(1u << (stuck_bit & 7));
+        if (((byte & bit) != 0) != stuck_value) {
+            byte ^= bit;
+            flipped++;
+        }
+    }
+    bit_errors += flipped;
+    return flipped > 0;
+}
+
+} // namespace fabric
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "packet.hpp"
+
+namespace fabric {
+
+// Philox4x32-10 counter-based generator (Salmon et al., SC'11). Every
+// output block is a pure function of (key, counter), so a stream can be
+// read from any position without stepping through the ones before it.
+using PhiloxCounter = std::array<uint32_t, 4>;
+using PhiloxKey = std::array<uint32_t, 2>;
+
+PhiloxCounter philox4x32(PhiloxCounter counter, PhiloxKey key);
+
+// Bits each packet puts on the wire
+constexpr uint64_t PACKET_BITS = PACKET_SIZE * 8;
+
+// Link that goes down for [from, until), in raw sc_time values. Packets
+// (or, for flit links, packets whose head flit) sent across it while it
+// is down are dropped. router == -1 takes every link down.
+struct LinkDownWindow {
+    int router = -1;
+    int port = -1;  // -1 for every port of the router
+    uint64_t from = 0;
+    uint64_t until = 0;
+};
+
+struct FaultConfig {
+    uint64_t seed = 1;
+
+    // Independent bit flips, per bit on the wire
+    double bit_error_rate = 0.0;
+
+    // Error bursts: events per bit, each corrupting burst_length
+    // consecutive bits. The first and last bits of a burst are always
+    // flipped and the ones between at random. Bursts may run on into the
+    // next packet.
+    double burst_rate = 0.0;
+    uint32_t burst_length = 16;
+
+    // Payload bit forced to stuck_value on every packet; -1 for none
+    int stuck_bit = -1;
+    bool stuck_value = false;
+
+    std::vector<LinkDownWindow> link_down;
+};
+
+// Per-packet error probability -> equivalent bit error rate
+double packet_to_bit_error_rate(double packet_error_rate);
+
+// Fault state of one link. The link's traffic is treated as one
+// continuous bit stream, packet n occupying bits [n, n + 1) * PACKET_BITS,
+// and the positions of the next bit error and the next burst are drawn
+// ahead with geometric skips. A packet that no fault reaches costs two
+// compares, so a 1e-9 BER campaign does work per error, not per packet.
+// Draws are keyed by (seed, link) and indexed by event number, so a
+// link's faults depend only on the packets it has carried.
+class FaultEngine {
+public:
+    FaultEngine();
+
+    // Rewinds the streams; link_id keys them and router/port select the
+    // link-down windows that apply
+    void configure(const FaultConfig& config, uint32_t link_id, int router, int port);
+    void reset();
+
+    // Applies the next packet's faults to its payload. Returns whether any
+    // payload bit changed.
+    bool apply(uint8_t* payload) {
+        const uint64_t begin = position;
+        position += PACKET_BITS;
+        if (next_error >= position && next_burst >= position && burst_until <= begin &&
+            stuck_bit < 0) {
+            return false;
+        }
+        return corrupt(payload, begin);
+    }
+
+    bool is_down(uint64_t time) const {
+        for (const auto& window : down) {
+            if (time >= window.first && time < window.second) return true;
+        }
+        return false;
+    }
+
+    bool enabled() const { return active; }
+    uint64_t get_bit_errors() const { return bit_errors; }
+    uint64_t get_bursts() const { return bursts; }
+
+private:
+    friend class Checkpoint;
+
+    // Stream numbers within a link's counter space
+    enum Stream : uint32_t { BIT_ERRORS, BURST_STARTS, BURST_PATTERNS };
+
+    bool corrupt(uint8_t* payload, uint64_t begin);
+    void flip_burst(uint64_t* mask, uint64_t begin) const;
+    uint64_t draw(Stream stream, uint64_t index) const;
+    uint64_t gap(Stream stream, uint64_t index, double log_keep) const;
+
+    PhiloxKey key;
+    uint32_t link_id;
+    bool active;
+
+    double log_keep_bit;    // log(1 - bit_error_rate)
+    double log_keep_burst;  // log(1 - burst_rate)
+    uint32_t burst_length;
+    int stuck_bit;
+    bool stuck_value;
+    std::vector<std::pair<uint64_t, uint64_t>> down;
+
+    // Stream position, in bits, and upcoming events
+    uint64_t position;
+    uint64_t next_error;
+    uint64_t next_burst;
+    uint64_t burst_from;
+    uint64_t burst_until;
+    uint64_t errors;  // independent errors drawn so far
+    uint64_t bursts;
+    uint64_t bit_errors;
+};
+
+} // namespace fabric
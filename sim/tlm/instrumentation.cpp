@@ -0,0 +1,330 @@
+#include "instrumentation.hpp"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <limits>
+
+namespace fabric {
+
+namespace {
+// Summary statistics of a histogram as JSON members, in nanoseconds
+void write_summary(std::ostream& out, const LatencyHistogram& histogram, double tick_ns) {
+    out << "\"count\": " << histogram.count()
+        << ", \"min_ns\": " << histogram.min() * tick_ns
+        << ", \"mean_ns\": " << histogram.mean() * tick_ns
+        << ", \"p50_ns\": " << histogram.percentile(0.50) * tick_ns
+        << ", \"p90_ns\": " << histogram.percentile(0.90) * tick_ns
+        << ", \"p99_ns\": " << histogram.percentile(0.99) * tick_ns
+        << ", \"p999_ns\": " << histogram.percentile(0.999) * tick_ns
+        << ", \"max_ns\": " << histogram.max() * tick_ns;
+}
+
+// The same summary as CSV columns
+void write_summary_row(std::ostream& out, const LatencyHistogram& histogram, double tick_ns) {
+    out << histogram.count() << ","
+        << histogram.min() * tick_ns << ","
+        << histogram.mean() * tick_ns << ","
+        << histogram.percentile(0.50) * tick_ns << ","
+        << histogram.percentile(0.90) * tick_ns << ","
+        << histogram.percentile(0.99) * tick_ns << ","
+        << histogram.percentile(0.999) * tick_ns << ","
+        << histogram.max() * tick_ns;
+}
+
+const char* SUMMARY_COLUMNS = "count,min_ns,mean_ns,p50_ns,p90_ns,p99_ns,p999_ns,max_ns";
+
+bool open_output(std::ofstream& out, const std::string& path) {
+    out.open(path);
+    if (!out) {
+        std::cerr << "Cannot open " << path << " for writing" << std::endl;
+        return false;
+    }
+    return true;
+}
+} // namespace
+
+// LatencyHistogram implementation
+LatencyHistogram::LatencyHistogram()
+    : first_bucket(0)
+    , total(0)
+    , sum(0)
+    , min_value(std::numeric_limits<uint64_t>::max())
+    , max_value(0)
+{
+}
+
+int LatencyHistogram::bucket_of(uint64_t value) {
+    if (value < SUB_BUCKETS) return static_cast<int>(value);
+    int exponent = 63 - __builtin_clzll(value);
+    int shift = exponent - SUB_BUCKET_BITS;
+    return (shift + 1) * SUB_BUCKETS + static_cast<int>(value >> shift) - SUB_BUCKETS;
+}
+
+uint64_t LatencyHistogram::bucket_lowest(int bucket) {
+    if (bucket < SUB_BUCKETS) return static_cast<uint64_t>(bucket);
+    int shift = bucket / SUB_BUCKETS - 1;
+    uint64_t sub = static_cast<uint64_t>(bucket % SUB_BUCKETS + SUB_BUCKETS);
+    return sub << shift;
+}
+
+uint64_t LatencyHistogram::bucket_highest(int bucket) {
+    if (bucket < SUB_BUCKETS) return static_cast<uint64_t>(bucket);
+    int shift = bucket / SUB_BUCKETS - 1;
+    return bucket_lowest(bucket) + ((1ull << shift) - 1);
+}
+
+void LatencyHistogram::grow(int bucket) {
+    if (counts.empty()) {
+        first_bucket = bucket;
+        counts.assign(1, 0);
+        return;
+    }
+    if (bucket < first_bucket) {
+        counts.insert(counts.begin(), static_cast<size_t>(first_bucket - bucket), 0);
+        first_bucket = bucket;
+    } else if (bucket >= first_bucket + static_cast<int>(counts.size())) {
+        counts.resize(static_cast<size_t>(bucket - first_bucket + 1), 0);
+    }
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other) {
+    if (other.counts.empty()) return;
+    grow(other.first_bucket);
+    grow(other.first_bucket + static_cast<int>(other.counts.size()) - 1);
+    for (size_t i = 0; i < other.counts.size(); i++) {
+        counts[other.first_bucket - first_bucket + i] += other.counts[i];
+    }
+    total += other.total;
+    sum += other.sum;
+    min_value = std::min(min_value, other.min_value);
+    max_value = std::max(max_value, other.max_value);
+}
+
+void LatencyHistogram::reset() {
+    counts.clear();
+    first_bucket = 0;
+    total = 0;
+    sum = 0;
+    min_value = std::numeric_limits<uint64_t>::max();
+    max_value = 0;
+}
+
+uint64_t LatencyHistogram::percentile(double q) const {
+    if (total == 0) return 0;
+    q = std::min(std::max(q, 0.0), 1.0);
+    uint64_t rank = static_cast<uint64_t>(q * total + 0.5);
+    if (rank == 0) rank = 1;
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts.size(); i++) {
+        seen += counts[i];
+        if (seen >= rank) {
+            return std::min(bucket_highest(first_bucket + static_cast<int>(i)), max_value);
+        }
+    }
+    return max_value;
+}
+
+// RouterStatistics implementation
+RouterStatistics::RouterStatistics(int radix, int num_routers)
+    : ports(radix)
+    , latency_by_source(num_routers)
+{
+}
+
+void RouterStatistics::reset() {
+    std::fill(ports.begin(), ports.end(), PortCounters());
+    for (auto& histogram : latency_by_source) {
+        histogram.reset();
+    }
+    latency_by_hops.clear();
+}
+
+// Instrumentation implementation
+Instrumentation::Instrumentation(int num_routers, int radix, uint64_t sample_interval,
+                                 double tick_ns)
+    : sample_interval(sample_interval)
+    , next_sample(sample_interval)
+    , tick_ns(tick_ns)
+{
+    routers.reserve(num_routers);
+    for (int i = 0; i < num_routers; i++) {
+        routers.push_back(std::make_unique<RouterStatistics>(radix, num_routers));
+    }
+}
+
+void Instrumentation::add_sample(const StatisticsSample& sample) {
+    samples.push_back(sample);
+    // Skip intervals that passed without a sample rather than bunching up
+    while (next_sample <= sample.time) next_sample += sample_interval;
+}
+
+void Instrumentation::reset() {
+    for (auto& router : routers) {
+        router->reset();
+    }
+    samples.clear();
+    next_sample = sample_interval;
+}
+
+LatencyHistogram Instrumentation::latency() const {
+    LatencyHistogram merged;
+    for (const auto& router : routers) {
+        for (const auto& histogram : router->latency_by_hops) {
+            merged.merge(histogram);
+        }
+    }
+    return merged;
+}
+
+LatencyHistogram Instrumentation::latency_by_hops(uint32_t hops) const {
+    LatencyHistogram merged;
+    for (const auto& router : routers) {
+        if (hops < router->latency_by_hops.size()) {
+            merged.merge(router->latency_by_hops[hops]);
+        }
+    }
+    return merged;
+}
+
+uint32_t Instrumentation::max_hops() const {
+    size_t hops = 0;
+    for (const auto& router : routers) {
+        hops = std::max(hops, router->latency_by_hops.size());
+    }
+    return hops ? static_cast<uint32_t>(hops - 1) : 0;
+}
+
+PortCounters Instrumentation::port_totals() const {
+    PortCounters totals;
+    for (const auto& router : routers) {
+        for (const PortCounters& port : router->ports) {
+            totals.packets_in += port.packets_in;
+            totals.packets_out += port.packets_out;
+            totals.flits_out += port.flits_out;
+            totals.stalls += port.stalls;
+        }
+    }
+    return totals;
+}
+
+bool Instrumentation::write_json(const std::string& path) const {
+    std::ofstream out;
+    if (!open_output(out, path)) return false;
+
+    out << "{\n  \"latency\": {";
+    write_summary(out, latency(), tick_ns);
+    out << "},\n";
+
+    out << "  \"hops\": [";
+    const char* separator = "\n";
+    for (uint32_t hops = 0; hops <= max_hops(); hops++) {
+        LatencyHistogram histogram = latency_by_hops(hops);
+        if (histogram.count() == 0) continue;
+        out << separator << "    {\"hops\": " << hops << ", ";
+        write_summary(out, histogram, tick_ns);
+        out << "}";
+        separator = ",\n";
+    }
+    out << "\n  ],\n";
+
+    out << "  \"pairs\": [";
+    separator = "\n";
+    for (int dst = 0; dst < num_routers(); dst++) {
+        const RouterStatistics& stats = router(dst);
+        for (size_t src = 0; src < stats.latency_by_source.size(); src++) {
+            const auto& histogram = stats.latency_by_source[src];
+            if (!histogram || histogram->count() == 0) continue;
+            out << separator << "    {\"src\": " << src << ", \"dst\": " << dst << ", ";
+            write_summary(out, *histogram, tick_ns);
+            out << "}";
+            separator = ",\n";
+        }
+    }
+    out << "\n  ],\n";
+
+    out << "  \"ports\": [";
+    separator = "\n";
+    for (int r = 0; r < num_routers(); r++) {
+        const RouterStatistics& stats = router(r);
+        for (size_t p = 0; p < stats.ports.size(); p++) {
+            const PortCounters& port = stats.ports[p];
+            if (port.packets_in == 0 && port.packets_out == 0 && port.stalls == 0) continue;
+            out << separator << "    {\"router\": " << r << ", \"port\": " << p
+                << ", \"packets_in\": " << port.packets_in
+                << ", \"packets_out\": " << port.packets_out
+                << ", \"flits_out\": " << port.flits_out
+                << ", \"stalls\": " << port.stalls << "}";
+            separator = ",\n";
+        }
+    }
+    out << "\n  ],\n";
+
+    out << "  \"samples\": [";
+    separator = "\n";
+    for (size_t i = 0; i < samples.size(); i++) {
+        const StatisticsSample& sample = samples[i];
+        uint64_t previous_time = i ? samples[i - 1].time : 0;
+        uint64_t previous_ejected = i ? samples[i - 1].ejected : 0;
+        double elapsed_ns = (sample.time - previous_time) * tick_ns;
+        double throughput = elapsed_ns > 0 ? (sample.ejected - previous_ejected) / elapsed_ns : 0.0;
+        out << separator << "    {\"time_ns\": " << sample.time * tick_ns
+            << ", \"injected\": " << sample.injected
+            << ", \"ejected\": " << sample.ejected
+            << ", \"in_flight\": " << sample.in_flight
+            << ", \"packets_per_ns\": " << throughput << "}";
+        separator = ",\n";
+    }
+    out << "\n  ]\n}\n";
+
+    return static_cast<bool>(out);
+}
+
+bool Instrumentation::write_csv(const std::string& prefix) const {
+    std::ofstream pairs, hops, ports, series;
+    if (!open_output(pairs, prefix + "_pairs.csv") || !open_output(hops, prefix + "_hops.csv") ||
+        !open_output(ports, prefix + "_ports.csv") || !open_output(series, prefix + "_samples.csv")) {
+        return false;
+    }
+
+    pairs << "src,dst," << SUMMARY_COLUMNS << "\n";
+    for (int dst = 0; dst < num_routers(); dst++) {
+        const RouterStatistics& stats = router(dst);
+        for (size_t src = 0; src < stats.latency_by_source.size(); src++) {
+            const auto& histogram = stats.latency_by_source[src];
+            if (!histogram || histogram->count() == 0) continue;
+            pairs << src << "," << dst << ",";
+            write_summary_row(pairs, *histogram, tick_ns);
+            pairs << "\n";
+        }
+    }
+
+    hops << "hops," << SUMMARY_COLUMNS << "\n";
+    for (uint32_t h = 0; h <= max_hops(); h++) {
+        LatencyHistogram histogram = latency_by_hops(h);
+        if (histogram.count() == 0) continue;
+        hops << h << ",";
+        write_summary_row(hops, histogram, tick_ns);
+        hops << "\n";
+    }
+
+    ports << "router,port,packets_in,packets_out,flits_out,stalls\n";
+    for (int r = 0; r < num_routers(); r++) {
+        const RouterStatistics& stats = router(r);
+        for (size_t p = 0; p < stats.ports.size(); p++) {
+            const PortCounters& port = stats.ports[p];
+            ports << r << "," << p << "," << port.packets_in << "," << port.packets_out << ","
+                  << port.flits_out << "," << port.stalls << "\n";
+        }
+    }
+
+    series << "time_ns,injected,ejected,in_flight\n";
+    for (const StatisticsSample& sample : samples) {
+        series << sample.time * tick_ns << "," << sample.injected << "," << sample.ejected
+               << "," << sample.in_flight << "\n";
+    }
+
+    return pairs && hops && ports && series;
+}
+
+} // namespace fabric
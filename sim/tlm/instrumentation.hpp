@@ -0,0 +1,151 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ring_buffer.hpp"
+
+namespace fabric {
+
+// Log-linear histogram in the style of HdrHistogram. Values below
+// SUB_BUCKETS are counted exactly; above that every power of two is split
+// into SUB_BUCKETS linear buckets, so a reported value is within 1/16 of
+// the recorded one. Recording is a couple of shifts and an increment.
+class LatencyHistogram {
+public:
+    static constexpr int SUB_BUCKET_BITS = 4;
+    static constexpr int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+
+    LatencyHistogram();
+
+    void record(uint64_t value) {
+        int bucket = bucket_of(value);
+        if (bucket < first_bucket || bucket >= first_bucket + static_cast<int>(counts.size())) {
+            grow(bucket);
+        }
+        counts[bucket - first_bucket]++;
+        total++;
+        sum += value;
+        if (value < min_value) min_value = value;
+        if (value > max_value) max_value = value;
+    }
+
+    void merge(const LatencyHistogram& other);
+    void reset();
+
+    uint64_t count() const { return total; }
+    uint64_t min() const { return total ? min_value : 0; }
+    uint64_t max() const { return max_value; }
+    double mean() const { return total ? static_cast<double>(sum) / total : 0.0; }
+
+    // Highest value equivalent to the q-quantile, q in [0, 1]
+    uint64_t percentile(double q) const;
+
+    // Stored buckets: get_counts()[i] counts bucket get_first_bucket() + i
+    int get_first_bucket() const { return first_bucket; }
+    const std::vector<uint64_t>& get_counts() const { return counts; }
+
+    static int bucket_of(uint64_t value);
+    static uint64_t bucket_lowest(int bucket);
+    static uint64_t bucket_highest(int bucket);
+
+private:
+    friend class Checkpoint;
+
+    void grow(int bucket);
+
+    // Only the buckets between the lowest and highest used are stored, so
+    // a histogram of similar latencies stays a few cache lines long
+    std::vector<uint64_t> counts;
+    int first_bucket;
+    uint64_t total;
+    uint64_t sum;
+    uint64_t min_value;
+    uint64_t max_value;
+};
+
+// Traffic through one router port. Each port has its own cache line.
+struct alignas(CACHE_LINE_SIZE) PortCounters {
+    uint64_t packets_in = 0;   // arrived on the port, from a link or injected
+    uint64_t packets_out = 0;  // left on the port, to a link or ejected
+    uint64_t flits_out = 0;
+    uint64_t stalls = 0;       // edges a packet waited at the port
+};
+
+// Counters and latency histograms of one router. Only the thread stepping
+// the router writes them, so with the parallel engine each block is
+// effectively thread-local and needs no atomics; results are merged when
+// they are read.
+class RouterStatistics {
+public:
+    RouterStatistics(int radix, int num_routers);
+
+    // Record a packet leaving the fabric here; latency in raw sc_time
+    void record_ejection(uint64_t src, uint32_t hops, uint64_t latency) {
+        std::unique_ptr<LatencyHistogram>& pair = latency_by_source[src];
+        if (!pair) pair = std::make_unique<LatencyHistogram>();
+        pair->record(latency);
+        if (hops >= latency_by_hops.size()) latency_by_hops.resize(hops + 1);
+        latency_by_hops[hops].record(latency);
+    }
+
+    void reset();
+
+    std::vector<PortCounters> ports;
+
+    // Packets ejected here, by source; allocated on first use
+    std::vector<std::unique_ptr<LatencyHistogram>> latency_by_source;
+    std::vector<LatencyHistogram> latency_by_hops;
+};
+
+// Fabric-wide occupancy and throughput at one point in time
+struct StatisticsSample {
+    uint64_t time;       // raw sc_time
+    uint64_t injected;   // packets injected so far
+    uint64_t ejected;    // packets ejected so far
+    uint64_t in_flight;  // packets held by the pool
+};
+
+// Collects per-router statistics and a sampled time series for a fabric,
+// and exports them. Times are raw sc_time values; exports convert them to
+// nanoseconds with tick_ns.
+class Instrumentation {
+public:
+    Instrumentation(int num_routers, int radix, uint64_t sample_interval, double tick_ns);
+
+    RouterStatistics& router(int id) { return *routers[id]; }
+    const RouterStatistics& router(int id) const { return *routers[id]; }
+    int num_routers() const { return static_cast<int>(routers.size()); }
+
+    // Time series; sample_interval == 0 disables sampling
+    uint64_t get_sample_interval() const { return sample_interval; }
+    bool sample_due(uint64_t time) const { return sample_interval && time >= next_sample; }
+    void add_sample(const StatisticsSample& sample);
+    const std::vector<StatisticsSample>& get_samples() const { return samples; }
+
+    void reset();
+
+    // Merged views
+    LatencyHistogram latency() const;
+    LatencyHistogram latency_by_hops(uint32_t hops) const;
+    uint32_t max_hops() const;
+    PortCounters port_totals() const;
+
+    bool write_json(const std::string& path) const;
+
+    // Writes <prefix>_pairs.csv, _hops.csv, _ports.csv and _samples.csv
+    bool write_csv(const std::string& prefix) const;
+
+private:
+    friend class Checkpoint;
+
+    std::vector<std::unique_ptr<RouterStatistics>> routers;
+    std::vector<StatisticsSample> samples;
+    uint64_t sample_interval;
+    uint64_t next_sample;
+    double tick_ns;
+};
+
+} // namespace fabric
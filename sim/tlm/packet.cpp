@@ -0,0 +1,91 @@
+#include "packet.hpp"
+
+namespace fabric {
+
+PacketPool::PacketPool(uint32_t initial_packets, uint32_t max_packets)
+    : max_packets(max_packets)
+    , allocations(0)
+    , releases(0)
+    , failed_allocations(0)
+    , peak_in_use(0)
+{
+    // Preallocate enough slabs to cover the initial size
+    while (slabs.size() * SLAB_PACKETS < initial_packets) {
+        if (!grow()) break;
+    }
+}
+
+bool PacketPool::grow() {
+    uint64_t capacity = slabs.size() * SLAB_PACKETS;
+    if (max_packets != 0 && capacity + SLAB_PACKETS > max_packets) {
+        return false;
+    }
+    // Handles are 32 bits and INVALID_PACKET is reserved
+    if (capacity + SLAB_PACKETS > INVALID_PACKET) {
+        return false;
+    }
+
+    slabs.push_back(std::make_unique<Packet[]>(SLAB_PACKETS));
+
+    // Push in reverse so low handles are handed out first
+    PacketHandle base = static_cast<PacketHandle>(capacity);
+    free_list.reserve(capacity + SLAB_PACKETS);
+    for (uint32_t i = SLAB_PACKETS; i > 0; i--) {
+        free_list.push_back(base + i - 1);
+    }
+    return true;
+}
+
+PacketHandle PacketPool::allocate(uint64_t src, uint64_t dst, bool control) {
+    if (free_list.empty() && !grow()) {
+        failed_allocations++;
+        return INVALID_PACKET;
+    }
+
+    PacketHandle handle = free_list.back();
+    free_list.pop_back();
+
+    Packet& packet = get(handle);
+    packet.src_id = src;
+    packet.dst_id = dst;
+    packet.timestamp = 0;
+    packet.arrival_time = 0;
+    packet.intermediate_id = dst;
+    packet.hop_count = 0;
+    packet.is_control = control;
+
+    allocations++;
+    uint64_t in_use = allocations - releases;
+    if (in_use > peak_in_use) peak_in_use = in_use;
+
+    return handle;
+}
+
+void PacketPool::release(PacketHandle handle) {
+    free_list.push_back(handle);
+    releases++;
+}
+
+void PacketPool::reset() {
+    // Return every packet to the pool; counters are kept across resets
+    free_list.clear();
+    uint64_t capacity = slabs.size() * SLAB_PACKETS;
+    for (uint64_t i = capacity; i > 0; i--) {
+        free_list.push_back(static_cast<PacketHandle>(i - 1));
+    }
+    releases = allocations;
+}
+
+PacketPoolStats PacketPool::get_statistics() const {
+    PacketPoolStats stats;
+    stats.capacity = slabs.size() * SLAB_PACKETS;
+    stats.in_use = allocations - releases;
+    stats.peak_in_use = peak_in_use;
+    stats.allocations = allocations;
+    stats.releases = releases;
+    stats.failed_allocations = failed_allocations;
+    stats.slabs = slabs.size();
+    return stats;
+}
+
+} // namespace fabric
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace fabric {
+
+// Constants
+constexpr int PACKET_SIZE = 64;  // bytes
+
+// Packet structure
+struct Packet {
+    uint64_t src_id;
+    uint64_t dst_id;
+    uint64_t timestamp;
+    uint64_t arrival_time;     // raw sc_time value of the last enqueue
+    uint64_t intermediate_id;  // Valiant waypoint; equals dst_id once reached
+    uint32_t hop_count;
+    std::array<uint8_t, PACKET_SIZE> payload;
+    uint32_t crc;              // CRC32C of the payload, stamped at injection
+    bool is_control;
+
+    Packet()
+        : src_id(0), dst_id(0), timestamp(0), arrival_time(0), intermediate_id(0), hop_count(0)
+        , payload{}, crc(0), is_control(false) {}
+
+    Packet(uint64_t src, uint64_t dst, bool control = false)
+        : src_id(src), dst_id(dst), timestamp(0), arrival_time(0), intermediate_id(dst)
+        , hop_count(0)
+        , payload{}, crc(0), is_control(control) {}
+};
+
+// Packets live in a PacketPool and move through the fabric as handles
+using PacketHandle = uint32_t;
+constexpr PacketHandle INVALID_PACKET = 0xFFFFFFFF;
+
+// Pool occupancy and allocation counters
+struct PacketPoolStats {
+    uint64_t capacity;
+    uint64_t in_use;
+    uint64_t peak_in_use;
+    uint64_t allocations;
+    uint64_t releases;
+    uint64_t failed_allocations;
+    uint64_t slabs;
+};
+
+// Slab allocator for packets. Storage grows one slab at a time and is never
+// returned to the heap, so handles stay valid for the life of the pool.
+class PacketPool {
+public:
+    static constexpr uint32_t SLAB_SHIFT = 10;
+    static constexpr uint32_t SLAB_PACKETS = 1u << SLAB_SHIFT;
+
+    // max_packets == 0 lets the pool grow without limit
+    explicit PacketPool(uint32_t initial_packets = SLAB_PACKETS, uint32_t max_packets = 0);
+
+    PacketPool(const PacketPool&) = delete;
+    PacketPool& operator=(const PacketPool&) = delete;
+
+    // Pool methods
+    PacketHandle allocate(uint64_t src, uint64_t dst, bool control = false);
+    void release(PacketHandle handle);
+    void reset();
+
+    Packet& get(PacketHandle handle) {
+        return slabs[handle >> SLAB_SHIFT][handle & (SLAB_PACKETS - 1)];
+    }
+    const Packet& get(PacketHandle handle) const {
+        return slabs[handle >> SLAB_SHIFT][handle & (SLAB_PACKETS - 1)];
+    }
+
+    PacketPoolStats get_statistics() const;
+
+private:
+    bool grow();
+
+    std::vector<std::unique_ptr<Packet[]>> slabs;
+    std::vector<PacketHandle> free_list;
+    uint32_t max_packets;
+
+    uint64_t allocations;
+    uint64_t releases;
+    uint64_t failed_allocations;
+    uint64_t peak_in_use;
+};
+
+} // namespace fabric
@@ -0,0 +1,240 @@
+#include "parallel_engine.hpp"
+#include <algorithm>
+#include <limits>
+
+namespace fabric {
+
+void ParallelEngine::Barrier::wait() {
+    bool next_sense = !sense.load(std::memory_order_relaxed);
+    if (waiting.fetch_add(1, std::memory_order_acq_rel) == count - 1) {
+        waiting.store(0, std::memory_order_relaxed);
+        sense.store(next_sense, std::memory_order_release);
+        return;
+    }
+    int spins = 0;
+    while (sense.load(std::memory_order_acquire) != next_sense) {
+        if (++spins > 1024) std::this_thread::yield();
+    }
+}
+
+ParallelEngine::ParallelEngine(Fabric& fabric, int num_threads,
+                               const sc_core::sc_time& clock_period,
+                               SyncMode mode, int window_cycles)
+    : fabric(fabric)
+    , mode(mode)
+    , requested_window(window_cycles)
+    , window_cycles(1)
+    , timing_generation(0)
+    , period(clock_period.value())
+    , time(sc_core::sc_time_stamp().value())
+    , cycle(0)
+    , barrier(std::max(1, std::min(num_threads, std::max(fabric.num_routers, 1))))
+    , pending_windows(0)
+    , shutdown(false)
+{
+    // Contiguous blocks of router ids keep neighbors in low-dimensional
+    // topologies mostly in the same region
+    const int n = fabric.num_routers;
+    const int num_regions = std::max(1, std::min(num_threads, std::max(n, 1)));
+    regions.resize(num_regions);
+    router_region.resize(n);
+    for (int r = 0; r < n; r++) {
+        int region = static_cast<int>(static_cast<int64_t>(r) * num_regions / n);
+        router_region[r] = region;
+        regions[region].routers.push_back(fabric.routers[r].get());
+        fabric.routers[r]->detach();
+    }
+    
+    // One mailbox per ordered pair of regions joined by at least one link,
+    // sized by update_window()
+    crossings.assign(static_cast<size_t>(num_regions) * num_regions, 0);
+    for (int r = 0; r < n; r++) {
+        for (auto& link : fabric.routers[r]->links) {
+            if (!link->peer) continue;
+            int peer_region = router_region[link->peer->router->router_id];
+            if (peer_region != router_region[r]) {
+                crossings[router_region[r] * num_regions + peer_region]++;
+            }
+        }
+    }
+    mailboxes.resize(crossings.size());
+    for (int a = 0; a < num_regions; a++) {
+        for (int b = 0; b < num_regions; b++) {
+            if (crossings[a * num_regions + b] == 0) continue;
+            mailboxes[a * num_regions + b] = std::make_unique<Mailbox>();
+            regions[b].inbound.push_back(mailboxes[a * num_regions + b].get());
+        }
+    }
+    for (int r = 0; r < n; r++) {
+        for (auto& link : fabric.routers[r]->links) {
+            if (!link->peer) continue;
+            int peer_region = router_region[link->peer->router->router_id];
+            if (peer_region != router_region[r]) {
+                link->mailbox = mailboxes[router_region[r] * num_regions + peer_region].get();
+            }
+        }
+    }
+    update_window();
+    
+    // The calling thread injects between runs and sees the engine's clock
+    set_thread_time_source(&time);
+    
+    for (int i = 1; i < num_regions; i++) {
+        threads.emplace_back(&ParallelEngine::worker, this, i);
+    }
+}
+
+int ParallelEngine::lookahead_cycles() const {
+    // Nothing sent at edge t can be used before the first edge after
+    // t + latency, so the shortest link latency bounds the window
+    bool found = false;
+    uint64_t min_latency = 0;
+    for (auto& router : fabric.routers) {
+        for (auto& link : router->links) {
+            if (!link->peer) continue;
+            uint64_t latency = link->latency.value();
+            if (!found || latency < min_latency) {
+                min_latency = latency;
+                found = true;
+            }
+        }
+    }
+    if (period == 0) return 1;
+    return static_cast<int>(std::min<uint64_t>(min_latency / period + 1,
+                                               std::numeric_limits<int>::max()));
+}
+
+void ParallelEngine::update_window() {
+    timing_generation = link_timing_generation();
+    window_cycles = lookahead_cycles();
+    if (mode == SyncMode::RELAXED && requested_window > window_cycles) {
+        window_cycles = requested_window;
+    }
+    
+    // Each link sends at most one packet and returns at most one credit per
+    // edge, and a mailbox holds at most two windows of traffic. Mailboxes
+    // are empty between runs, so they can be replaced.
+    for (size_t i = 0; i < mailboxes.size(); i++) {
+        if (mailboxes[i]) *mailboxes[i] = Mailbox(4 * crossings[i] * window_cycles + 1);
+    }
+}
+
+ParallelEngine::~ParallelEngine() {
+    shutdown = true;
+    barrier.wait();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    
+    for (auto& router : fabric.routers) {
+        for (auto& link : router->links) {
+            link->mailbox = nullptr;
+        }
+        router->attach();
+    }
+    set_thread_time_source(nullptr);
+}
+
+void ParallelEngine::run(uint64_t cycles) {
+    if (cycles == 0) return;
+    if (timing_generation != link_timing_generation()) update_window();
+    pending_windows = cycles;
+    barrier.wait();
+    run_windows(0, cycles);
+    time += cycles * period;
+    cycle += cycles;
+}
+
+void ParallelEngine::worker(int index) {
+    while (true) {
+        barrier.wait();
+        if (shutdown) return;
+        run_windows(index, pending_windows);
+    }
+}
+
+void ParallelEngine::run_windows(int index, uint64_t cycles) {
+    Region& region = regions[index];
+    const uint64_t base = time;
+    set_thread_time_source(&region.time);
+    
+    uint64_t done = 0;
+    int window = 0;
+    while (done < cycles) {
+        // Everything sent in earlier windows is applied now. Messages carry
+        // their arrival time, so a packet or credit that is not due yet
+        // stays unusable until its edge.
+        drain(region, window & 1);
+        if (index == 0 && window > 0) {
+            flush_releases((window - 1) & 1);
+        }
+        for (Router* router : region.routers) {
+            router->release_sink = &region.releases[window & 1];
+        }
+        
+        uint64_t count = std::min<uint64_t>(window_cycles, cycles - done);
+        for (uint64_t k = 1; k <= count; k++) {
+            region.time = base + (done + k) * period;
+            for (Router* router : region.routers) {
+                if (!router->is_idle()) router->process_queues();
+            }
+        }
+        done += count;
+        window++;
+        barrier.wait();
+        
+        // Every thread sees the same due time; thread 0 samples while the
+        // others hold still
+        const Instrumentation* instrumentation = fabric.instrumentation.get();
+        if (instrumentation && instrumentation->sample_due(base + done * period)) {
+            barrier.wait();
+            if (index == 0) fabric.record_sample(base + done * period);
+            barrier.wait();
+        }
+    }
+    
+    // Leave nothing in flight so the fabric is consistent between runs
+    drain(region, window & 1);
+    barrier.wait();
+    if (index == 0) {
+        flush_releases(0);
+        flush_releases(1);
+        set_thread_time_source(&time);
+    }
+    for (Router* router : region.routers) {
+        router->release_sink = nullptr;
+    }
+}
+
+void ParallelEngine::drain(Region& region, int parity) {
+    for (Mailbox* mailbox : region.inbound) {
+        while (!mailbox->empty()) {
+            const LinkMessage& message = mailbox->front();
+            Link* target = message.target;
+            if (message.handle == INVALID_PACKET) {
+                target->add_credit(message.time, message.vc);
+            } else if (target->router->protocol == LinkProtocol::APPROXIMATELY_TIMED) {
+                Flit flit{message.handle, message.flit, message.time, nullptr};
+                if (!target->deliver_flit(flit, message.vc)) {
+                    target->router->dropped_count++;
+                    if (flit.is_tail()) region.releases[parity].push_back(message.handle);
+                }
+            } else if (!target->deliver(message.handle, message.time)) {
+                target->router->dropped_count++;
+                region.releases[parity].push_back(message.handle);
+            }
+            mailbox->pop();
+        }
+    }
+}
+
+void ParallelEngine::flush_releases(int parity) {
+    for (Region& region : regions) {
+        for (PacketHandle handle : region.releases[parity]) {
+            fabric.packet_pool.release(handle);
+        }
+        region.releases[parity].clear();
+    }
+}
+
+} // namespace fabric
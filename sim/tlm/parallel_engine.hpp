@@ -0,0 +1,96 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "fabric_tlm.hpp"
+
+namespace fabric {
+
+// Steps a fabric's routers on worker threads instead of the SystemC
+// kernel. Routers are split into contiguous regions, one per thread, and
+// every region advances through the same window of clock edges before the
+// threads meet at a barrier. Packets and credits that cross regions go
+// through per-region-pair SPSC mailboxes and are applied at the start of
+// the next window.
+//
+// In CONSERVATIVE mode the window equals the lookahead (the earliest edge
+// at which anything sent can be used by the receiver, set by the shortest
+// link latency), so results are identical to the sequential kernel.
+// RELAXED mode uses a longer window and delivers cross-region traffic
+// late, trading accuracy for fewer barriers. A run that starts after link
+// timing changed recomputes the window first.
+//
+// The engine owns the fabric's routers while it exists; sc_start() must not
+// be called until it is destroyed.
+class ParallelEngine {
+public:
+    enum class SyncMode { CONSERVATIVE, RELAXED };
+    
+    ParallelEngine(Fabric& fabric, int num_threads, const sc_core::sc_time& clock_period,
+                   SyncMode mode = SyncMode::CONSERVATIVE, int window_cycles = 0);
+    ~ParallelEngine();
+    
+    ParallelEngine(const ParallelEngine&) = delete;
+    ParallelEngine& operator=(const ParallelEngine&) = delete;
+    
+    // Advance every router by the given number of clock edges
+    void run(uint64_t cycles);
+    
+    uint64_t get_cycle() const { return cycle; }
+    uint64_t get_time() const { return time; }
+    int get_num_regions() const { return static_cast<int>(regions.size()); }
+    int get_window_cycles() const { return window_cycles; }
+    int region_of(int router) const { return router_region[router]; }
+    
+    // Edges between a send and its first use at the receiver
+    int lookahead_cycles() const;
+    
+private:
+    struct alignas(CACHE_LINE_SIZE) Region {
+        std::vector<Router*> routers;
+        std::vector<Mailbox*> inbound;
+        std::vector<PacketHandle> releases[2];
+        uint64_t time = 0;
+    };
+    
+    // Sense-reversing barrier; spins briefly, then yields
+    class Barrier {
+    public:
+        explicit Barrier(int count) : count(count), waiting(0), sense(false) {}
+        void wait();
+    private:
+        const int count;
+        std::atomic<int> waiting;
+        std::atomic<bool> sense;
+    };
+    
+    void update_window();
+    void worker(int index);
+    void run_windows(int index, uint64_t windows);
+    void drain(Region& region, int parity);
+    void flush_releases(int parity);
+    
+    Fabric& fabric;
+    SyncMode mode;
+    int requested_window;  // RELAXED only
+    int window_cycles;
+    uint64_t timing_generation;  // link timing the window was computed for
+    uint64_t period;
+    uint64_t time;
+    uint64_t cycle;
+    
+    std::vector<Region> regions;
+    std::vector<int> router_region;
+    std::vector<std::unique_ptr<Mailbox>> mailboxes;  // [src * regions + dst]
+    std::vector<uint32_t> crossings;                  // links behind each mailbox
+    
+    std::vector<std::thread> threads;
+    Barrier barrier;
+    uint64_t pending_windows;
+    bool shutdown;
+};
+
+} // namespace fabric
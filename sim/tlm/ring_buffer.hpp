@@ -0,0 +1,127 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+namespace fabric {
+
+constexpr int CACHE_LINE_SIZE = 64;  // bytes
+
+// Fixed-capacity single-producer/single-consumer ring buffer. The producer
+// only writes tail and the consumer only writes head, each on its own cache
+// line, so one thread may push while another pops without locking.
+// Moving a ring buffer is not thread-safe and is meant for elaboration only.
+template <typename T>
+class RingBuffer {
+public:
+    explicit RingBuffer(uint32_t depth = 1)
+        : head(0), tail(0)
+    {
+        allocate(depth);
+    }
+
+    RingBuffer(RingBuffer&& other) noexcept
+        : head(other.head.load(std::memory_order_relaxed))
+        , tail(other.tail.load(std::memory_order_relaxed))
+        , depth(other.depth)
+        , mask(other.mask)
+        , buffer(std::move(other.buffer))
+    {
+    }
+
+    RingBuffer& operator=(RingBuffer&& other) noexcept {
+        head.store(other.head.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        tail.store(other.tail.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        depth = other.depth;
+        mask = other.mask;
+        buffer = std::move(other.buffer);
+        return *this;
+    }
+
+    RingBuffer(const RingBuffer&) = delete;
+    RingBuffer& operator=(const RingBuffer&) = delete;
+
+    // Producer side
+    bool push(const T& item) {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) >= depth) {
+            return false;
+        }
+        buffer[t & mask] = item;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side
+    bool pop(T& item) {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        item = buffer[h & mask];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side; the buffer must not be empty
+    const T& front() const {
+        return buffer[head.load(std::memory_order_relaxed) & mask];
+    }
+
+    void pop() {
+        head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // Item i places behind the front; not thread-safe, both sides must be
+    // idle
+    const T& peek(uint32_t i) const {
+        return buffer[(head.load(std::memory_order_relaxed) + i) & mask];
+    }
+
+    // Either side may query occupancy; the answer can be stale by the time
+    // it is used, but never reports more free space than the producer has
+    bool empty() const {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+
+    bool full() const {
+        return size() >= depth;
+    }
+
+    uint32_t size() const {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+
+    uint32_t capacity() const {
+        return depth;
+    }
+
+    uint32_t free_slots() const {
+        return depth - size();
+    }
+
+    // Not thread-safe; both sides must be idle
+    void clear() {
+        head.store(0, std::memory_order_relaxed);
+        tail.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    void allocate(uint32_t requested) {
+        depth = requested > 0 ? requested : 1;
+        // Storage is rounded up to a power of two so indexing is a mask
+        uint32_t slots = 1;
+        while (slots < depth) slots <<= 1;
+        mask = slots - 1;
+        buffer = std::make_unique<T[]>(slots);
+    }
+
+    alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> head;
+    alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> tail;
+    alignas(CACHE_LINE_SIZE) uint32_t depth;
+    uint32_t mask;
+    std::unique_ptr<T[]> buffer;
+};
+
+} // namespace fabric
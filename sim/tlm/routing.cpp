@@ -0,0 +1,121 @@
+#include "routing.hpp"
+#include <cstddef>
+
+namespace fabric {
+
+namespace {
+
+constexpr uint16_t UNREACHABLE = 0xFFFF;
+
+// Lowest dimension in which two routers' coordinates differ
+int first_differing_dimension(const std::vector<int>& dims, int a, int b) {
+    for (size_t k = 0; k < dims.size(); k++) {
+        if (a % dims[k] != b % dims[k]) return static_cast<int>(k);
+        a /= dims[k];
+        b /= dims[k];
+    }
+    return static_cast<int>(dims.size());
+}
+
+} // namespace
+
+const char* routing_algorithm_name(RoutingAlgorithm algorithm) {
+    switch (algorithm) {
+        case RoutingAlgorithm::DIMENSION_ORDER: return "dimension_order";
+        case RoutingAlgorithm::MINIMAL: return "minimal";
+        case RoutingAlgorithm::VALIANT: return "valiant";
+        case RoutingAlgorithm::ADAPTIVE: return "adaptive";
+    }
+    return "unknown";
+}
+
+RoutingEngine::RoutingEngine(const NetworkGraph& graph, RoutingAlgorithm algorithm)
+    : algorithm(algorithm)
+{
+    build_tables(graph);
+}
+
+int RoutingEngine::distance(int src, int dst) const {
+    uint16_t d = distances[static_cast<size_t>(src) * tables.size() + dst];
+    return d == UNREACHABLE ? -1 : d;
+}
+
+void RoutingEngine::build_tables(const NetworkGraph& graph) {
+    const int n = graph.num_routers;
+    const int radix = graph.radix;
+    
+    // Coordinates are only meaningful if they cover every router exactly
+    long coord_space = graph.dims.empty() ? 0 : 1;
+    for (int d : graph.dims) coord_space *= d;
+    const bool has_coords = coord_space == n;
+    
+    // Links are bidirectional, so a BFS from each destination gives every
+    // router's distance to it
+    distances.assign(static_cast<size_t>(n) * n, UNREACHABLE);
+    std::vector<int> frontier;
+    frontier.reserve(n);
+    for (int dst = 0; dst < n; dst++) {
+        frontier.clear();
+        frontier.push_back(dst);
+        distances[static_cast<size_t>(dst) * n + dst] = 0;
+        for (size_t head = 0; head < frontier.size(); head++) {
+            int r = frontier[head];
+            uint16_t next = distances[static_cast<size_t>(r) * n + dst] + 1;
+            for (int p = 0; p < radix; p++) {
+                int m = graph.neighbor(r, p);
+                if (m < 0) continue;
+                uint16_t& dm = distances[static_cast<size_t>(m) * n + dst];
+                if (dm == UNREACHABLE) {
+                    dm = next;
+                    frontier.push_back(m);
+                }
+            }
+        }
+    }
+    
+    tables.resize(n);
+    for (int r = 0; r < n; r++) {
+        RoutingTable& table = tables[r];
+        table.router_id = r;
+        table.algorithm = algorithm;
+        table.dor_ports.assign(n, NO_ROUTE);
+        table.minimal_offsets.assign(n + 1, 0);
+        table.minimal_ports.clear();
+        
+        for (int dst = 0; dst < n; dst++) {
+            table.minimal_offsets[dst] = static_cast<uint32_t>(table.minimal_ports.size());
+            
+            if (dst == r) {
+                for (int p : graph.terminal_ports[r]) {
+                    table.minimal_ports.push_back(static_cast<uint8_t>(p));
+                }
+                if (!graph.terminal_ports[r].empty()) {
+                    table.dor_ports[dst] = static_cast<uint8_t>(graph.terminal_ports[r][0]);
+                }
+                continue;
+            }
+            
+            uint16_t here = distances[static_cast<size_t>(r) * n + dst];
+            if (here == UNREACHABLE) continue;
+            
+            int best_dim = 0x7FFFFFFF;
+            for (int p = 0; p < radix; p++) {
+                int m = graph.neighbor(r, p);
+                if (m < 0 || distances[static_cast<size_t>(m) * n + dst] != here - 1) continue;
+                table.minimal_ports.push_back(static_cast<uint8_t>(p));
+                
+                // Without coordinates every minimal port ranks equally and
+                // the lowest-numbered one is used
+                int dim = has_coords ? first_differing_dimension(graph.dims, r, m) : 0;
+                if (dim < best_dim) {
+                    best_dim = dim;
+                    table.dor_ports[dst] = static_cast<uint8_t>(p);
+                }
+            }
+        }
+        table.minimal_offsets[n] = static_cast<uint32_t>(table.minimal_ports.size());
+        table.minimal_ports.shrink_to_fit();
+    }
+}
+
+} // namespace fabric
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace fabric {
+
+// Table entry for destinations that cannot be reached
+constexpr uint8_t NO_ROUTE = 0xFF;
+
+// Routing algorithms
+enum class RoutingAlgorithm {
+    DIMENSION_ORDER,  // deterministic, lowest differing dimension first
+    MINIMAL,          // oblivious minimal, flows hashed across minimal ports
+    VALIANT,          // minimal to a random intermediate router, then to dst
+    ADAPTIVE          // minimal port with the emptiest output queue
+};
+
+const char* routing_algorithm_name(RoutingAlgorithm algorithm);
+
+// Router-level connectivity the forwarding tables are computed from
+struct NetworkGraph {
+    int num_routers = 0;
+    int radix = 0;
+    
+    // Router ids are mixed-radix coordinates over dims when the product of
+    // dims equals num_routers; empty for topologies without coordinates
+    std::vector<int> dims;
+    
+    // [router * radix + port] -> neighbor router, -1 if not a network port
+    std::vector<int32_t> neighbors;
+    
+    // [router * radix + port] -> port on the neighbor that links back
+    std::vector<int32_t> neighbor_ports;
+    
+    // Ports that inject into and eject from each router
+    std::vector<std::vector<int>> terminal_ports;
+    
+    int neighbor(int router, int port) const {
+        return neighbors[router * radix + port];
+    }
+    int neighbor_port(int router, int port) const {
+        return neighbor_ports[router * radix + port];
+    }
+};
+
+// Per-router forwarding state: flat arrays indexed by destination router
+struct RoutingTable {
+    int router_id = -1;
+    RoutingAlgorithm algorithm = RoutingAlgorithm::DIMENSION_ORDER;
+    
+    // [dst] -> dimension-order port; the first terminal port when dst is
+    // this router
+    std::vector<uint8_t> dor_ports;
+    
+    // Minimal ports for dst are minimal_ports[minimal_offsets[dst] ..
+    // minimal_offsets[dst + 1])
+    std::vector<uint32_t> minimal_offsets;
+    std::vector<uint8_t> minimal_ports;
+    
+    int dimension_order_port(uint64_t dst) const {
+        return dor_ports[dst];
+    }
+    const uint8_t* minimal_begin(uint64_t dst) const {
+        return minimal_ports.data() + minimal_offsets[dst];
+    }
+    uint32_t minimal_count(uint64_t dst) const {
+        return minimal_offsets[dst + 1] - minimal_offsets[dst];
+    }
+};
+
+// Builds the forwarding tables of every router in a fabric
+class RoutingEngine {
+public:
+    RoutingEngine(const NetworkGraph& graph, RoutingAlgorithm algorithm);
+    
+    RoutingAlgorithm get_algorithm() const { return algorithm; }
+    const RoutingTable& table(int router) const { return tables[router]; }
+    int num_routers() const { return static_cast<int>(tables.size()); }
+    
+    // Hop count between two routers, -1 if unreachable
+    int distance(int src, int dst) const;
+    
+private:
+    void build_tables(const NetworkGraph& graph);
+    
+    RoutingAlgorithm algorithm;
+    std::vector<RoutingTable> tables;
+    std::vector<uint16_t> distances;  // [src * num_routers + dst]
+};
+
+// Stateless 64-bit mixer used to spread flows and pick Valiant intermediates
+inline uint64_t route_hash(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+} // namespace fabric
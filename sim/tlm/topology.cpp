@@ -0,0 +1,262 @@
+#include "topology.hpp"
+#include <algorithm>
+
+namespace fabric {
+
+namespace {
+
+int product(const std::vector<int>& dims) {
+    long total = 1;
+    for (int d : dims) {
+        if (d <= 0) return 0;
+        total *= d;
+        if (total > 0x7FFFFFFF) return 0;
+    }
+    return static_cast<int>(total);
+}
+
+int ipow(int base, int exp) {
+    long result = 1;
+    for (int i = 0; i < exp; i++) {
+        result *= base;
+        if (result > 0x7FFFFFFF) return 0;
+    }
+    return static_cast<int>(result);
+}
+
+// Dragonfly group count: balanced (a*h + 1) unless given explicitly
+int dragonfly_groups(const std::vector<int>& dims) {
+    return dims.size() > 2 ? dims[2] : dims[0] * dims[1] + 1;
+}
+
+// Records a bidirectional link between two router ports
+void link_ports(NetworkGraph& graph, int a, int port_a, int b, int port_b) {
+    graph.neighbors[a * graph.radix + port_a] = b;
+    graph.neighbor_ports[a * graph.radix + port_a] = port_b;
+    graph.neighbors[b * graph.radix + port_b] = a;
+    graph.neighbor_ports[b * graph.radix + port_b] = port_a;
+}
+
+// Mesh and torus: ports c + 2k and c + 2k + 1 lead down and up dimension k
+void build_grid(NetworkGraph& graph, const TopologyConfig& config, bool wrap) {
+    const std::vector<int>& dims = config.dimensions;
+    const int c = config.concentration;
+    int stride = 1;
+    for (size_t k = 0; k < dims.size(); k++) {
+        const int size = dims[k];
+        const int down = c + 2 * static_cast<int>(k);
+        const int up = down + 1;
+        for (int r = 0; r < graph.num_routers; r++) {
+            int coord = (r / stride) % size;
+            if (coord + 1 < size) {
+                link_ports(graph, r, up, r + stride, down);
+            } else if (wrap && size > 1) {
+                link_ports(graph, r, up, r - coord * stride, down);
+            }
+        }
+        stride *= size;
+    }
+}
+
+// Flattened butterfly: every router links to all routers that differ from
+// it in exactly one coordinate
+void build_flattened_butterfly(NetworkGraph& graph, const TopologyConfig& config) {
+    const std::vector<int>& dims = config.dimensions;
+    int stride = 1;
+    int base = config.concentration;
+    for (size_t k = 0; k < dims.size(); k++) {
+        const int size = dims[k];
+        for (int r = 0; r < graph.num_routers; r++) {
+            int coord = (r / stride) % size;
+            for (int v = coord + 1; v < size; v++) {
+                int other = r + (v - coord) * stride;
+                // Port order skips the router's own coordinate
+                link_ports(graph, r, base + v - 1, other, base + coord);
+            }
+        }
+        base += size - 1;
+        stride *= size;
+    }
+}
+
+// k-ary n-tree: level l switch w links up to every switch at level l + 1
+// that matches w in all digits but digit l
+void build_fat_tree(NetworkGraph& graph, const TopologyConfig& config) {
+    const int k = config.dimensions[0];
+    const int levels = config.dimensions[1];
+    const int per_level = ipow(k, levels - 1);
+    const int up_base = std::max(config.concentration, k);
+    int digit_stride = 1;
+    for (int l = 0; l + 1 < levels; l++) {
+        for (int w = 0; w < per_level; w++) {
+            int digit = (w / digit_stride) % k;
+            for (int j = 0; j < k; j++) {
+                int parent = w + (j - digit) * digit_stride;
+                link_ports(graph, l * per_level + w, up_base + j,
+                           (l + 1) * per_level + parent, digit);
+            }
+        }
+        digit_stride *= k;
+    }
+}
+
+// Dragonfly: groups of a fully connected routers, h global ports each.
+// Global channel t of a group leads to the group (t mod (g - 1)) + 1 ahead.
+void build_dragonfly(NetworkGraph& graph, const TopologyConfig& config) {
+    const int a = config.dimensions[0];
+    const int h = config.dimensions[1];
+    const int g = dragonfly_groups(config.dimensions);
+    const int c = config.concentration;
+    const int global_base = c + a - 1;
+    
+    for (int group = 0; group < g; group++) {
+        for (int i = 0; i < a; i++) {
+            for (int j = i + 1; j < a; j++) {
+                link_ports(graph, group * a + i, c + j - 1, group * a + j, c + i);
+            }
+        }
+    }
+    if (g < 2) return;
+    
+    const int channels = a * h;
+    for (int group = 0; group < g; group++) {
+        for (int t = 0; t < channels; t++) {
+            int round = t / (g - 1);
+            int offset = t % (g - 1) + 1;
+            int peer_group = (group + offset) % g;
+            int peer_t = round * (g - 1) + (g - offset) - 1;
+            // Channels without a partner in the last partial round stay idle
+            if (peer_t >= channels) continue;
+            link_ports(graph, group * a + t / h, global_base + t % h,
+                       peer_group * a + peer_t / h, global_base + peer_t % h);
+        }
+    }
+}
+
+} // namespace
+
+const char* topology_name(TopologyType type) {
+    switch (type) {
+        case TopologyType::FULLY_CONNECTED: return "fully_connected";
+        case TopologyType::MESH: return "mesh";
+        case TopologyType::TORUS: return "torus";
+        case TopologyType::FLATTENED_BUTTERFLY: return "flattened_butterfly";
+        case TopologyType::FAT_TREE: return "fat_tree";
+        case TopologyType::DRAGONFLY: return "dragonfly";
+    }
+    return "unknown";
+}
+
+int topology_num_routers(const TopologyConfig& config) {
+    const std::vector<int>& dims = config.dimensions;
+    switch (config.type) {
+        case TopologyType::FULLY_CONNECTED:
+        case TopologyType::MESH:
+        case TopologyType::TORUS:
+        case TopologyType::FLATTENED_BUTTERFLY:
+            return dims.empty() ? 0 : product(dims);
+        case TopologyType::FAT_TREE:
+            if (dims.size() != 2 || dims[0] < 1 || dims[1] < 1) return 0;
+            return dims[1] * ipow(dims[0], dims[1] - 1);
+        case TopologyType::DRAGONFLY:
+            if (dims.size() < 2 || dims.size() > 3 || dims[0] < 1 || dims[1] < 0) return 0;
+            if (dragonfly_groups(dims) < 1) return 0;
+            return dims[0] * dragonfly_groups(dims);
+    }
+    return 0;
+}
+
+bool build_topology(const TopologyConfig& config, NetworkGraph& graph, std::string& error) {
+    const int n = topology_num_routers(config);
+    if (n <= 0) {
+        error = std::string("Invalid dimensions for ") + topology_name(config.type) + " topology";
+        return false;
+    }
+    if (config.concentration < 0) {
+        error = "Concentration must not be negative";
+        return false;
+    }
+    
+    // Each group has a * h global channels, one per other group at most;
+    // groups beyond that would be left without a path to some others
+    if (config.type == TopologyType::DRAGONFLY &&
+        dragonfly_groups(config.dimensions) > config.dimensions[0] * config.dimensions[1] + 1) {
+        error = "Dragonfly topology supports at most " +
+                std::to_string(config.dimensions[0] * config.dimensions[1] + 1) + " groups, got " +
+                std::to_string(dragonfly_groups(config.dimensions));
+        return false;
+    }
+    
+    const std::vector<int>& dims = config.dimensions;
+    const int c = config.concentration;
+    int network_ports = 0;
+    std::vector<int> coordinate_dims;
+    switch (config.type) {
+        case TopologyType::FULLY_CONNECTED:
+            network_ports = n - 1;
+            coordinate_dims = {n};
+            break;
+        case TopologyType::MESH:
+        case TopologyType::TORUS:
+            network_ports = 2 * static_cast<int>(dims.size());
+            coordinate_dims = dims;
+            break;
+        case TopologyType::FLATTENED_BUTTERFLY:
+            for (int d : dims) network_ports += d - 1;
+            coordinate_dims = dims;
+            break;
+        case TopologyType::FAT_TREE:
+            network_ports = std::max(c, dims[0]) + dims[0] - c;
+            break;
+        case TopologyType::DRAGONFLY:
+            network_ports = dims[0] - 1 + dims[1];
+            break;
+    }
+    
+    const int needed = c + network_ports;
+    if (config.radix != 0 && config.radix < needed) {
+        error = std::string(topology_name(config.type)) + " topology needs radix " +
+                std::to_string(needed) + ", got " + std::to_string(config.radix);
+        return false;
+    }
+    
+    graph.num_routers = n;
+    graph.radix = config.radix != 0 ? config.radix : needed;
+    graph.dims = coordinate_dims;
+    graph.neighbors.assign(static_cast<size_t>(n) * graph.radix, -1);
+    graph.neighbor_ports.assign(static_cast<size_t>(n) * graph.radix, -1);
+    graph.terminal_ports.assign(n, {});
+    
+    // Fat trees only attach terminals to leaf switches
+    int edge_routers = n;
+    if (config.type == TopologyType::FAT_TREE) {
+        edge_routers = ipow(dims[0], dims[1] - 1);
+    }
+    for (int r = 0; r < edge_routers; r++) {
+        for (int p = 0; p < c; p++) {
+            graph.terminal_ports[r].push_back(p);
+        }
+    }
+    
+    switch (config.type) {
+        case TopologyType::FULLY_CONNECTED:
+        case TopologyType::FLATTENED_BUTTERFLY:
+            build_flattened_butterfly(graph, config);
+            break;
+        case TopologyType::MESH:
+            build_grid(graph, config, false);
+            break;
+        case TopologyType::TORUS:
+            build_grid(graph, config, true);
+            break;
+        case TopologyType::FAT_TREE:
+            build_fat_tree(graph, config);
+            break;
+        case TopologyType::DRAGONFLY:
+            build_dragonfly(graph, config);
+            break;
+    }
+    return true;
+}
+
+} // namespace fabric
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "routing.hpp"
+
+namespace fabric {
+
+// Supported fabric topologies
+enum class TopologyType {
+    FULLY_CONNECTED,      // dimensions = {routers}
+    MESH,                 // dimensions = routers per dimension
+    TORUS,                // dimensions = routers per dimension, wrapped
+    FLATTENED_BUTTERFLY,  // dimensions = routers per dimension, all-to-all per dimension
+    FAT_TREE,             // dimensions = {k, levels}: k-ary n-tree
+    DRAGONFLY             // dimensions = {routers per group, global ports per router[, groups]}
+};
+
+const char* topology_name(TopologyType type);
+
+// Compact description of a fabric
+struct TopologyConfig {
+    TopologyType type = TopologyType::FULLY_CONNECTED;
+    std::vector<int> dimensions;
+    int concentration = 1;  // terminal ports per edge router
+    int radix = 0;          // 0 uses the smallest radix the topology needs
+};
+
+// Number of routers the description expands to, 0 if it is invalid
+int topology_num_routers(const TopologyConfig& config);
+
+// Fills in the neighbor and port maps for a topology. Edge routers take
+// ports [0, concentration) as terminal ports; fat trees have terminals on
+// leaf switches only. Network ports follow the terminal ports. Work
+// and memory are linear in the number of ports. Returns false and leaves
+// a message in error if the description is invalid.
+bool build_topology(const TopologyConfig& config, NetworkGraph& graph, std::string& error);
+
+} // namespace fabric
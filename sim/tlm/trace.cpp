@@ -0,0 +1,295 @@
+#include "trace.hpp"
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fabric {
+
+namespace {
+constexpr char MAGIC[8] = {'F', 'A', 'B', 'T', 'R', 'A', 'C', 'E'};
+constexpr uint32_t VERSION = 1;
+constexpr uint32_t HAS_PAYLOADS = 1;
+constexpr uint32_t BUFFER_BYTES = TraceBuffer::CHUNK_BYTES + TraceBuffer::MAX_RECORD_BYTES;
+
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint32_t num_routers;
+    uint32_t radix;
+    double tick_ns;
+};
+
+struct ChunkHeader {
+    uint32_t router;
+    uint32_t records;
+    uint32_t bytes;
+    uint32_t padding;
+};
+
+bool get_varint(const uint8_t*& p, const uint8_t* end, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64 && p < end; shift += 7) {
+        uint8_t byte = *p++;
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+} // namespace
+
+const char* trace_event_name(TraceEvent event) {
+    switch (event) {
+        case TraceEvent::INJECT: return "inject";
+        case TraceEvent::FORWARD: return "forward";
+        case TraceEvent::EJECT: return "eject";
+        case TraceEvent::DROP: return "drop";
+    }
+    return "unknown";
+}
+
+void TraceBuffer::inject(uint64_t time, PacketHandle handle, int port, uint64_t dst,
+                         const uint8_t* payload) {
+    put_header(TraceEvent::INJECT, port, time, handle);
+    put_varint(dst);
+    if (payloads) {
+        std::memcpy(cursor, payload, PACKET_SIZE);
+        cursor += PACKET_SIZE;
+    }
+    commit();
+}
+
+void TraceBuffer::flush() {
+    writer->submit(*this);
+}
+
+TraceWriter::~TraceWriter() {
+    close();
+}
+
+bool TraceWriter::open(const std::string& path, int num_routers, int radix, double tick_ns,
+                       bool payloads) {
+    close();
+    out.open(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        std::cerr << "Cannot open " << path << " for writing" << std::endl;
+        return false;
+    }
+
+    FileHeader header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.flags = payloads ? HAS_PAYLOADS : 0;
+    header.num_routers = static_cast<uint32_t>(num_routers);
+    header.radix = static_cast<uint32_t>(radix);
+    header.tick_ns = tick_ns;
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    buffers.clear();
+    for (int r = 0; r < num_routers; r++) {
+        auto buffer = std::make_unique<TraceBuffer>();
+        buffer->writer = this;
+        buffer->router = static_cast<uint32_t>(r);
+        buffer->payloads = payloads;
+        buffer->data = std::make_unique<uint8_t[]>(BUFFER_BYTES);
+        buffer->cursor = buffer->data.get();
+        buffers.push_back(std::move(buffer));
+    }
+    closing = false;
+    failed = false;
+    records = 0;
+    bytes = sizeof(header);
+    flusher = std::thread(&TraceWriter::flush_loop, this);
+    return true;
+}
+
+bool TraceWriter::close() {
+    if (!flusher.joinable()) return !failed;
+    for (auto& buffer : buffers) {
+        submit(*buffer);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closing = true;
+    }
+    ready.notify_one();
+    flusher.join();
+    buffers.clear();
+    spare.clear();
+    out.close();
+    if (failed) std::cerr << "Failed writing trace" << std::endl;
+    return !failed;
+}
+
+void TraceWriter::submit(TraceBuffer& buffer) {
+    if (buffer.records == 0) return;
+    Chunk chunk{buffer.router, buffer.records,
+                static_cast<uint32_t>(buffer.cursor - buffer.data.get()), std::move(buffer.data)};
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        records += chunk.records;
+        bytes += sizeof(ChunkHeader) + chunk.bytes;
+        queue.push_back(std::move(chunk));
+        if (!spare.empty()) {
+            buffer.data = std::move(spare.back());
+            spare.pop_back();
+        }
+    }
+    ready.notify_one();
+
+    if (!buffer.data) buffer.data = std::make_unique<uint8_t[]>(BUFFER_BYTES);
+    buffer.cursor = buffer.data.get();
+    buffer.last_time = 0;
+    buffer.records = 0;
+}
+
+void TraceWriter::flush_loop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        ready.wait(lock, [this]() { return closing || !queue.empty(); });
+        if (queue.empty()) return;
+        Chunk chunk = std::move(queue.front());
+        queue.pop_front();
+        lock.unlock();
+
+        ChunkHeader header{chunk.router, chunk.records, chunk.bytes, 0};
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(chunk.data.get()), chunk.bytes);
+
+        lock.lock();
+        if (!out) failed = true;
+        spare.push_back(std::move(chunk.data));
+    }
+}
+
+TraceReader::~TraceReader() {
+    close();
+}
+
+bool TraceReader::open(const std::string& path) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Cannot open trace " << path << std::endl;
+        return false;
+    }
+    struct stat info;
+    if (::fstat(fd, &info) == 0 && info.st_size > 0) {
+        void* mapped = ::mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped != MAP_FAILED) {
+            data = static_cast<const uint8_t*>(mapped);
+            size = info.st_size;
+            ::madvise(mapped, size, MADV_SEQUENTIAL);
+        }
+    }
+    ::close(fd);
+
+    FileHeader header;
+    if (!data || size < sizeof(header)) {
+        std::cerr << "Cannot read trace " << path << std::endl;
+        close();
+        return false;
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION) {
+        std::cerr << path << " is not a version " << VERSION << " fabric trace" << std::endl;
+        close();
+        return false;
+    }
+    routers = static_cast<int>(header.num_routers);
+    radix = static_cast<int>(header.radix);
+    tick_ns = header.tick_ns;
+    payloads = header.flags & HAS_PAYLOADS;
+
+    // Index the chunks; records are only decoded by cursors
+    router_chunks.assign(routers, {});
+    uint64_t offset = sizeof(header);
+    while (size - offset >= sizeof(ChunkHeader)) {
+        ChunkHeader chunk;
+        std::memcpy(&chunk, data + offset, sizeof(chunk));
+        offset += sizeof(chunk);
+        if (chunk.router >= header.num_routers || chunk.bytes > size - offset) break;
+        const uint32_t index = static_cast<uint32_t>(chunks.size());
+        chunks.push_back({offset, chunk.router, chunk.bytes});
+        all_chunks.push_back(index);
+        router_chunks[chunk.router].push_back(index);
+        offset += chunk.bytes;
+    }
+    if (offset != size) {
+        std::cerr << "Trace " << path << " is truncated; reading the first " << chunks.size()
+                  << " chunks" << std::endl;
+    }
+    return true;
+}
+
+void TraceReader::close() {
+    if (data) ::munmap(const_cast<uint8_t*>(data), size);
+    data = nullptr;
+    size = 0;
+    chunks.clear();
+    all_chunks.clear();
+    router_chunks.clear();
+}
+
+TraceReader::Cursor TraceReader::cursor(int router) const {
+    Cursor cursor;
+    cursor.reader = this;
+    cursor.chunks = router < 0 ? &all_chunks : &router_chunks[router];
+    return cursor;
+}
+
+bool TraceReader::Cursor::next(TraceRecord& record) {
+    while (cursor == end) {
+        if (error || !chunks || next_chunk == chunks->size()) return false;
+        const ChunkInfo& chunk = reader->chunks[(*chunks)[next_chunk++]];
+        cursor = reader->data + chunk.offset;
+        end = cursor + chunk.bytes;
+        router = chunk.router;
+        last_time = 0;
+    }
+
+    const uint8_t tag = *cursor++;
+    uint64_t delta, handle;
+    if (!get_varint(cursor, end, delta) || !get_varint(cursor, end, handle)) {
+        error = true;
+        return false;
+    }
+    last_time += (delta >> 1) ^ (0 - (delta & 1));
+    record.time = last_time;
+    record.handle = static_cast<PacketHandle>(handle);
+    record.router = router;
+    record.port = tag >> 2;
+    record.event = static_cast<TraceEvent>(tag & 3);
+    record.dst = 0;
+    record.hops = 0;
+    record.payload = nullptr;
+
+    uint64_t value = 0;
+    switch (record.event) {
+        case TraceEvent::INJECT:
+            if (!get_varint(cursor, end, record.dst)) error = true;
+            if (reader->payloads) {
+                if (end - cursor < PACKET_SIZE) {
+                    error = true;
+                    break;
+                }
+                record.payload = cursor;
+                cursor += PACKET_SIZE;
+            }
+            break;
+        case TraceEvent::EJECT:
+            if (!get_varint(cursor, end, value)) error = true;
+            record.hops = static_cast<uint32_t>(value);
+            break;
+        default:
+            break;
+    }
+    if (error) cursor = end;
+    return !error;
+}
+
+} // namespace fabric
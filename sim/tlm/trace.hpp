@@ -0,0 +1,214 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "packet.hpp"
+
+namespace fabric {
+
+class TraceWriter;
+
+// What happened to a packet. FORWARD and DROP are per hop: the packet left
+// the router on port, or was lost there to a down link.
+enum class TraceEvent : uint8_t {
+    INJECT,
+    FORWARD,
+    EJECT,
+    DROP
+};
+
+const char* trace_event_name(TraceEvent event);
+
+// One decoded trace record. Handles are recycled by the pool, so a handle
+// names one packet from its INJECT to its EJECT or DROP.
+struct TraceRecord {
+    uint64_t time;  // raw sc_time
+    PacketHandle handle;
+    uint32_t router;
+    uint8_t port;
+    TraceEvent event;
+    uint64_t dst;            // INJECT
+    uint32_t hops;           // EJECT
+    const uint8_t* payload;  // INJECT in traces with payloads, else null
+};
+
+// Trace records of one router. Only the thread stepping the router writes
+// them, so, like RouterStatistics, each buffer is effectively thread-local
+// and recording is a few byte stores. Records are a tag byte (event in the
+// low two bits, port above), the zigzag varint time delta from the
+// previous record and the varint handle, followed by the destination and
+// optional payload for INJECT and the hop count for EJECT. Full buffers
+// are handed to the writer's flush thread as chunks, and every chunk
+// starts its deltas from zero so it decodes on its own.
+class TraceBuffer {
+public:
+    static constexpr uint32_t CHUNK_BYTES = 64 * 1024;
+    static constexpr uint32_t MAX_RECORD_BYTES = 128;
+
+    void inject(uint64_t time, PacketHandle handle, int port, uint64_t dst, const uint8_t* payload);
+
+    void forward(uint64_t time, PacketHandle handle, int port) {
+        put_header(TraceEvent::FORWARD, port, time, handle);
+        commit();
+    }
+
+    void eject(uint64_t time, PacketHandle handle, int port, uint32_t hops) {
+        put_header(TraceEvent::EJECT, port, time, handle);
+        put_varint(hops);
+        commit();
+    }
+
+    void drop(uint64_t time, PacketHandle handle, int port) {
+        put_header(TraceEvent::DROP, port, time, handle);
+        commit();
+    }
+
+private:
+    friend class TraceWriter;
+
+    void put_varint(uint64_t value) {
+        while (value >= 0x80) {
+            *cursor++ = static_cast<uint8_t>(value) | 0x80;
+            value >>= 7;
+        }
+        *cursor++ = static_cast<uint8_t>(value);
+    }
+
+    void put_header(TraceEvent event, int port, uint64_t time, PacketHandle handle) {
+        const int64_t delta = static_cast<int64_t>(time - last_time);
+        last_time = time;
+        *cursor++ = static_cast<uint8_t>(static_cast<uint32_t>(event) | (port << 2));
+        put_varint((static_cast<uint64_t>(delta) << 1) ^ static_cast<uint64_t>(delta >> 63));
+        put_varint(handle);
+    }
+
+    void commit() {
+        records++;
+        if (cursor >= data.get() + CHUNK_BYTES) flush();
+    }
+
+    void flush();
+
+    TraceWriter* writer = nullptr;
+    uint32_t router = 0;
+    bool payloads = false;
+    std::unique_ptr<uint8_t[]> data;
+    uint8_t* cursor = nullptr;
+    uint64_t last_time = 0;
+    uint32_t records = 0;
+};
+
+// Writes a trace file: a header, then chunks of router records in the
+// order their buffers filled. Buffers are written out by a background
+// thread, so a run only stops for a full buffer long enough to swap it
+// for an empty one.
+class TraceWriter {
+public:
+    TraceWriter() = default;
+    ~TraceWriter();
+
+    TraceWriter(const TraceWriter&) = delete;
+    TraceWriter& operator=(const TraceWriter&) = delete;
+
+    bool open(const std::string& path, int num_routers, int radix, double tick_ns, bool payloads);
+
+    // Flushes every buffer and waits for the file to be written. Call
+    // between runs, never during one. Returns false if any write failed.
+    bool close();
+
+    TraceBuffer& buffer(int router) { return *buffers[router]; }
+    uint64_t get_records() const { return records; }
+    uint64_t get_bytes() const { return bytes; }
+
+private:
+    friend class TraceBuffer;
+
+    struct Chunk {
+        uint32_t router;
+        uint32_t records;
+        uint32_t bytes;
+        std::unique_ptr<uint8_t[]> data;
+    };
+
+    void submit(TraceBuffer& buffer);
+    void flush_loop();
+
+    std::vector<std::unique_ptr<TraceBuffer>> buffers;
+    std::ofstream out;
+    std::thread flusher;
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::deque<Chunk> queue;
+    std::vector<std::unique_ptr<uint8_t[]>> spare;
+    bool closing = false;
+    bool failed = false;
+    uint64_t records = 0;
+    uint64_t bytes = 0;
+};
+
+// Read-only view of a trace file through mmap
+class TraceReader {
+public:
+    TraceReader() = default;
+    ~TraceReader();
+
+    TraceReader(const TraceReader&) = delete;
+    TraceReader& operator=(const TraceReader&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+
+    int num_routers() const { return routers; }
+    int get_radix() const { return radix; }
+    double get_tick_ns() const { return tick_ns; }
+    bool has_payloads() const { return payloads; }
+
+    // Records of one router in time order, or with router < 0 of every
+    // router, chunk by chunk in file order
+    class Cursor {
+    public:
+        bool next(TraceRecord& record);
+        bool failed() const { return error; }
+
+    private:
+        friend class TraceReader;
+
+        const TraceReader* reader = nullptr;
+        const std::vector<uint32_t>* chunks = nullptr;
+        size_t next_chunk = 0;
+        uint32_t router = 0;
+        const uint8_t* cursor = nullptr;
+        const uint8_t* end = nullptr;
+        uint64_t last_time = 0;
+        bool error = false;
+    };
+
+    Cursor cursor(int router = -1) const;
+
+private:
+    struct ChunkInfo {
+        uint64_t offset;  // of the records
+        uint32_t router;
+        uint32_t bytes;
+    };
+
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    int routers = 0;
+    int radix = 0;
+    double tick_ns = 0.0;
+    bool payloads = false;
+    std::vector<ChunkInfo> chunks;
+    std::vector<uint32_t> all_chunks;
+    std::vector<std::vector<uint32_t>> router_chunks;
+};
+
+} // namespace fabric
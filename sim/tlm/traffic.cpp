@@ -0,0 +1,359 @@
+#include "traffic.hpp"
+#include <algorithm>
+#include <functional>
+#include <iostream>
+
+namespace fabric {
+
+namespace {
+// Draws per endpoint per cycle: injection, burst transition, destination
+// and an auxiliary draw for payload offsets
+constexpr uint64_t DRAWS_PER_CYCLE = 4;
+constexpr uint32_t PAYLOAD_BLOCK = 4096;
+constexpr size_t MAX_DIMS = 8;
+
+// Threshold a uniform 64-bit draw falls below with the given probability
+uint64_t probability_threshold(double p) {
+    if (p <= 0.0) return 0;
+    if (p >= 1.0) return UINT64_MAX;
+    return static_cast<uint64_t>(p * 18446744073709551616.0);
+}
+
+// Uniform integer in [0, n) from a 64-bit draw
+inline uint64_t scale(uint64_t draw, uint64_t n) {
+    return static_cast<uint64_t>((static_cast<unsigned __int128>(draw) * n) >> 64);
+}
+} // namespace
+
+const char* traffic_pattern_name(TrafficPattern pattern) {
+    switch (pattern) {
+        case TrafficPattern::UNIFORM_RANDOM: return "uniform";
+        case TrafficPattern::TRANSPOSE: return "transpose";
+        case TrafficPattern::BIT_COMPLEMENT: return "bit-complement";
+        case TrafficPattern::HOTSPOT: return "hotspot";
+        case TrafficPattern::TORNADO: return "tornado";
+        case TrafficPattern::NEAREST_NEIGHBOR: return "nearest-neighbor";
+    }
+    return "unknown";
+}
+
+TrafficGenerator::TrafficGenerator(Fabric& fabric, const TrafficConfig& traffic)
+    : fabric(fabric)
+    , config(traffic)
+    , wrap(false)
+    , index_bits(0)
+    , sleep(0)
+    , hotspot_threshold(probability_threshold(traffic.hotspot_fraction))
+    , cycle(0)
+    , generated(0)
+    , rejected(0)
+{
+    for (int r = 0; r < fabric.num_routers; r++) {
+        if (!fabric.graph.terminal_ports[r].empty()) endpoints.push_back(r);
+    }
+    if (endpoints.empty()) {
+        std::cerr << "Fabric has no endpoints to generate traffic for" << std::endl;
+    }
+    while (index_bits < 63 && (2ull << index_bits) <= endpoints.size()) index_bits++;
+
+    // Coordinates only mean something when every router is an endpoint
+    const NetworkGraph& graph = fabric.graph;
+    if (!graph.dims.empty() && graph.dims.size() <= MAX_DIMS &&
+        endpoints.size() == static_cast<size_t>(fabric.num_routers)) {
+        dims = graph.dims;
+        wrap = fabric.topology.type == TopologyType::TORUS;
+    } else {
+        dims = {static_cast<int>(endpoints.size())};
+        wrap = true;
+    }
+
+    auto invalid = [&](uint64_t router) {
+        return router >= static_cast<uint64_t>(fabric.num_routers);
+    };
+    config.hotspots.erase(std::remove_if(config.hotspots.begin(), config.hotspots.end(), invalid),
+                          config.hotspots.end());
+    if (config.pattern == TrafficPattern::HOTSPOT && config.hotspots.empty()) {
+        std::cerr << "No valid hotspot routers; hotspot traffic is uniform" << std::endl;
+    }
+
+    const size_t n = endpoints.size();
+    keys.resize(n);
+    for (size_t i = 0; i < n; i++) {
+        keys[i] = route_hash(config.seed ^ route_hash(endpoints[i]));
+    }
+    thresholds.resize(n);
+    wake.resize(n);
+    on.assign(n, config.bursty ? 0 : 1);
+    fire.assign(n, 0);
+    if (config.bursty) {
+        sleep = probability_threshold(1.0 / std::max(config.burst_length, 1.0));
+    }
+    for (size_t i = 0; i < n; i++) {
+        set_injection_rate(endpoints[i], config.injection_rate);
+    }
+
+    payload_block.resize(PAYLOAD_BLOCK + PACKET_SIZE);
+    for (size_t i = 0; i < payload_block.size(); i++) {
+        payload_block[i] = static_cast<uint8_t>(route_hash(config.seed + i));
+    }
+}
+
+void TrafficGenerator::set_injection_rate(uint64_t router, double rate) {
+    auto it = std::lower_bound(endpoints.begin(), endpoints.end(), router);
+    if (it == endpoints.end() || *it != router) {
+        std::cerr << "Router " << router << " is not a traffic endpoint" << std::endl;
+        return;
+    }
+    const size_t i = it - endpoints.begin();
+    if (!config.bursty) {
+        thresholds[i] = probability_threshold(rate);
+        return;
+    }
+
+    // Pick the off -> on probability that makes the on fraction
+    // rate / burst_rate
+    double fraction = config.burst_rate > 0.0 ? std::min(rate / config.burst_rate, 1.0) : 0.0;
+    double leave = 1.0 / std::max(config.burst_length, 1.0);
+    double enter = fraction >= 1.0 ? 1.0 : leave * fraction / (1.0 - fraction);
+    thresholds[i] = probability_threshold(config.burst_rate);
+    wake[i] = probability_threshold(enter);
+}
+
+uint64_t TrafficGenerator::coordinate_transform(uint32_t src, uint64_t draw) const {
+    const size_t d = dims.size();
+    int coords[MAX_DIMS];
+    uint64_t rest = src;
+    for (size_t i = 0; i < d; i++) {
+        coords[i] = static_cast<int>(rest % dims[i]);
+        rest /= dims[i];
+    }
+
+    int moved[MAX_DIMS];
+    switch (config.pattern) {
+        case TrafficPattern::TRANSPOSE:
+            for (size_t i = 0; i < d; i++) {
+                moved[i] = coords[d - 1 - i] % dims[i];
+            }
+            break;
+        case TrafficPattern::TORNADO:
+            for (size_t i = 0; i < d; i++) {
+                moved[i] = (coords[i] + (dims[i] + 1) / 2 - 1) % dims[i];
+            }
+            break;
+        default: {
+            // NEAREST_NEIGHBOR: one step, reflected at mesh edges
+            std::copy(coords, coords + d, moved);
+            uint64_t choice = scale(draw, 2 * d);
+            size_t dim = choice / 2;
+            int step = (choice & 1) ? 1 : -1;
+            int k = dims[dim];
+            if (k > 1) {
+                int next = moved[dim] + step;
+                if (wrap) {
+                    next = (next + k) % k;
+                } else if (next < 0 || next >= k) {
+                    next = moved[dim] - step;
+                }
+                moved[dim] = next;
+            }
+            break;
+        }
+    }
+
+    uint64_t dst = 0;
+    for (size_t i = d; i-- > 0;) {
+        dst = dst * dims[i] + moved[i];
+    }
+    return dst;
+}
+
+uint64_t TrafficGenerator::destination(uint32_t src, uint64_t draw) const {
+    const uint64_t n = endpoints.size();
+    uint64_t dst = src;
+    switch (config.pattern) {
+        case TrafficPattern::HOTSPOT:
+            // Remix so the destination is independent of the hotspot decision
+            if (draw < hotspot_threshold && !config.hotspots.empty()) {
+                return config.hotspots[scale(route_hash(draw), config.hotspots.size())];
+            }
+            draw = route_hash(draw);
+            // fall through
+        case TrafficPattern::UNIFORM_RANDOM:
+            if (n > 1) {
+                dst = scale(draw, n - 1);
+                if (dst >= src) dst++;
+            }
+            break;
+        case TrafficPattern::BIT_COMPLEMENT:
+            dst = n - 1 - src;
+            break;
+        case TrafficPattern::TRANSPOSE:
+            if (dims.size() == 1) {
+                // Rotate the index bits by half their width
+                uint32_t half = index_bits / 2;
+                uint64_t mask = (1ull << index_bits) - 1;
+                if (half && src <= mask) {
+                    dst = ((src << half) | (src >> (index_bits - half))) & mask;
+                }
+                break;
+            }
+            dst = coordinate_transform(src, draw);
+            break;
+        case TrafficPattern::TORNADO:
+        case TrafficPattern::NEAREST_NEIGHBOR:
+            dst = coordinate_transform(src, draw);
+            break;
+    }
+    return endpoints[dst % n];
+}
+
+size_t TrafficGenerator::generate(std::vector<PacketDescriptor>& packets) {
+    const size_t n = endpoints.size();
+    const uint64_t base = cycle * DRAWS_PER_CYCLE;
+    cycle++;
+
+    // Injection decisions for every endpoint, without branches
+    const uint64_t* key = keys.data();
+    const uint64_t* threshold = thresholds.data();
+    uint8_t* active = on.data();
+    uint8_t* fires = fire.data();
+    if (config.bursty) {
+        const uint64_t* enter = wake.data();
+        for (size_t i = 0; i < n; i++) {
+            uint64_t transition = route_hash(key[i] + base + 1);
+            uint8_t stay = transition >= sleep;
+            uint8_t start = transition < enter[i];
+            active[i] = active[i] ? stay : start;
+        }
+    }
+    size_t firing = 0;
+    for (size_t i = 0; i < n; i++) {
+        uint8_t f = active[i] & (route_hash(key[i] + base) < threshold[i]);
+        fires[i] = f;
+        firing += f;
+    }
+
+    // Destinations only for the endpoints that fire
+    const size_t first = packets.size();
+    packets.resize(first + firing);
+    PacketDescriptor* out = packets.data() + first;
+    const uint32_t length = std::min<uint32_t>(config.payload_bytes, PACKET_SIZE);
+    for (size_t i = 0; i < n; i++) {
+        if (!fires[i]) continue;
+        uint64_t draw = route_hash(key[i] + base + 2);
+        uint64_t aux = route_hash(key[i] + base + 3);
+        out->src = endpoints[i];
+        out->dst = destination(static_cast<uint32_t>(i), draw);
+        out->payload = &payload_block[aux & (PAYLOAD_BLOCK - 1)];
+        out->length = length;
+        out++;
+    }
+    generated += firing;
+    return firing;
+}
+
+size_t TrafficGenerator::step() {
+    batch.clear();
+    generate(batch);
+    status.resize(batch.size());
+    size_t injected = fabric.inject_packets(batch.data(), batch.size(), status.data());
+    rejected += batch.size() - injected;
+    return injected;
+}
+
+void TrafficGenerator::run(ParallelEngine& engine, uint64_t cycles) {
+    for (uint64_t i = 0; i < cycles; i++) {
+        step();
+        engine.run(1);
+    }
+}
+
+void TrafficGenerator::reset() {
+    std::fill(on.begin(), on.end(), config.bursty ? 0 : 1);
+    cycle = 0;
+    generated = 0;
+    rejected = 0;
+}
+
+TraceReplay::TraceReplay(Fabric& fabric)
+    : fabric(fabric)
+    , first_time(0)
+    , start(0)
+    , started(false)
+    , replayed(0)
+    , rejected(0)
+{
+}
+
+bool TraceReplay::open(const std::string& path) {
+    heap.clear();
+    started = false;
+    replayed = 0;
+    rejected = 0;
+    if (!reader.open(path)) return false;
+    if (reader.num_routers() != fabric.num_routers) {
+        std::cerr << "Trace " << path << " has " << reader.num_routers() << " routers, fabric has "
+                  << fabric.num_routers << std::endl;
+        reader.close();
+        return false;
+    }
+
+    // Each router's injections are in time order, so the next one overall
+    // is the earliest of the routers' next ones
+    cursors.clear();
+    pending.resize(fabric.num_routers);
+    for (int r = 0; r < fabric.num_routers; r++) {
+        cursors.push_back(reader.cursor(r));
+        advance(static_cast<uint32_t>(r));
+    }
+    first_time = heap.empty() ? 0 : heap.front().time;
+    return true;
+}
+
+bool TraceReplay::advance(uint32_t router) {
+    TraceRecord& record = pending[router];
+    while (cursors[router].next(record)) {
+        if (record.event != TraceEvent::INJECT) continue;
+        heap.push_back({record.time, router});
+        std::push_heap(heap.begin(), heap.end(), std::greater<Next>());
+        return true;
+    }
+    if (cursors[router].failed()) {
+        std::cerr << "Trace records of router " << router << " are corrupt" << std::endl;
+    }
+    return false;
+}
+
+size_t TraceReplay::step() {
+    const uint64_t now = current_time();
+    if (!started) {
+        start = now;
+        started = true;
+    }
+
+    batch.clear();
+    const uint32_t length = reader.has_payloads() ? PACKET_SIZE : 0;
+    while (!heap.empty() && heap.front().time - first_time <= now - start) {
+        const uint32_t router = heap.front().router;
+        std::pop_heap(heap.begin(), heap.end(), std::greater<Next>());
+        heap.pop_back();
+        const TraceRecord& record = pending[router];
+        batch.push_back({record.router, record.dst, record.payload, length});
+        advance(router);
+    }
+
+    status.resize(batch.size());
+    size_t injected = fabric.inject_packets(batch.data(), batch.size(), status.data());
+    replayed += injected;
+    rejected += batch.size() - injected;
+    return injected;
+}
+
+void TraceReplay::run(ParallelEngine& engine, uint64_t cycles) {
+    for (uint64_t i = 0; i < cycles; i++) {
+        step();
+        engine.run(1);
+    }
+}
+
+} // namespace fabric
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "parallel_engine.hpp"
+#include "trace.hpp"
+
+namespace fabric {
+
+// Synthetic destination patterns. Patterns that need coordinates use the
+// topology's dimensions when it has them and treat the endpoints as a ring
+// otherwise.
+enum class TrafficPattern {
+    UNIFORM_RANDOM,    // any other endpoint, uniformly
+    TRANSPOSE,         // coordinates reversed; index bits rotated without coordinates
+    BIT_COMPLEMENT,    // every index bit inverted
+    HOTSPOT,           // a fraction of traffic to the hotspots, the rest uniform
+    TORNADO,           // halfway minus one around every dimension
+    NEAREST_NEIGHBOR   // one step along a random dimension
+};
+
+const char* traffic_pattern_name(TrafficPattern pattern);
+
+struct TrafficConfig {
+    TrafficPattern pattern = TrafficPattern::UNIFORM_RANDOM;
+    double injection_rate = 0.1;  // packets per endpoint per cycle, at most 1
+    uint64_t seed = 1;
+    uint32_t payload_bytes = PACKET_SIZE;
+
+    // HOTSPOT
+    std::vector<uint64_t> hotspots = {0};
+    double hotspot_fraction = 0.2;
+
+    // Bursty on/off Markov source: while on, an endpoint injects with
+    // burst_rate per cycle; bursts last burst_length cycles on average and
+    // the off periods are sized so the long-run rate is injection_rate
+    bool bursty = false;
+    double burst_rate = 1.0;
+    double burst_length = 8.0;
+};
+
+// Generates synthetic traffic for a fabric and injects it through the
+// batch API. Every endpoint (a router with terminal ports) draws from its
+// own counter-based random stream, so a run is reproducible from the seed
+// regardless of how many endpoints there are or how the fabric is
+// stepped. Per-endpoint state is kept as arrays and each cycle is
+// generated in branch-free passes over them.
+class TrafficGenerator {
+public:
+    TrafficGenerator(Fabric& fabric, const TrafficConfig& traffic);
+
+    // Overrides the configured rate for one endpoint router
+    void set_injection_rate(uint64_t router, double rate);
+
+    // Appends one cycle of traffic to packets and returns how many were
+    // added. Payloads point into a block owned by the generator.
+    size_t generate(std::vector<PacketDescriptor>& packets);
+
+    // Generates one cycle and injects it at the current time
+    size_t step();
+
+    // Alternates step() with one engine cycle
+    void run(ParallelEngine& engine, uint64_t cycles);
+
+    void reset();
+
+    uint64_t get_cycle() const { return cycle; }
+    uint64_t get_generated() const { return generated; }
+    uint64_t get_rejected() const { return rejected; }
+
+    // Destination of a packet from endpoint index src given a random draw
+    uint64_t destination(uint32_t src, uint64_t draw) const;
+
+private:
+    uint64_t coordinate_transform(uint32_t src, uint64_t draw) const;
+
+    Fabric& fabric;
+    TrafficConfig config;
+
+    // Endpoint index -> router id, and the coordinate space patterns use
+    std::vector<uint64_t> endpoints;
+    std::vector<int> dims;
+    bool wrap;
+    uint32_t index_bits;  // floor(log2(endpoints))
+
+    // Per-endpoint state
+    std::vector<uint64_t> keys;        // random stream seeds
+    std::vector<uint64_t> thresholds;  // inject while on and draw < threshold
+    std::vector<uint64_t> wake;        // bursty off -> on transition
+    std::vector<uint8_t> on;
+    std::vector<uint8_t> fire;
+
+    uint64_t sleep;  // bursty on -> off transition
+    uint64_t hotspot_threshold;
+
+    std::vector<uint8_t> payload_block;
+    std::vector<PacketDescriptor> batch;
+    std::vector<InjectStatus> status;
+
+    uint64_t cycle;
+    uint64_t generated;
+    uint64_t rejected;
+};
+
+// Feeds the injections of a trace back into a fabric with their original
+// timing: a packet injected t after the trace's first injection is
+// injected t after the replay's first step(). Injections at the same time
+// go in router order, which is the order TrafficGenerator injects them
+// in, so replaying a trace into a fabric with the same configuration
+// repeats the original run. Injections that were rejected were not
+// traced and are not replayed.
+class TraceReplay {
+public:
+    explicit TraceReplay(Fabric& fabric);
+
+    bool open(const std::string& path);
+
+    // Injects every packet due by the current time
+    size_t step();
+
+    // Alternates step() with one engine cycle
+    void run(ParallelEngine& engine, uint64_t cycles);
+
+    bool done() const { return heap.empty(); }
+    uint64_t get_replayed() const { return replayed; }
+    uint64_t get_rejected() const { return rejected; }
+
+private:
+    struct Next {
+        uint64_t time;
+        uint32_t router;
+        bool operator>(const Next& other) const {
+            return time != other.time ? time > other.time : router > other.router;
+        }
+    };
+
+    bool advance(uint32_t router);
+
+    Fabric& fabric;
+    TraceReader reader;
+    std::vector<TraceReader::Cursor> cursors;
+    std::vector<TraceRecord> pending;  // next injection of each router
+    std::vector<Next> heap;            // min-heap on (time, router)
+    std::vector<PacketDescriptor> batch;
+    std::vector<InjectStatus> status;
+
+    uint64_t first_time;
+    uint64_t start;
+    bool started;
+    uint64_t replayed;
+    uint64_t rejected;
+};
+
+} // namespace fabric